@@ -0,0 +1,41 @@
+#pragma once
+
+#include "state.h"
+#include <ArduinoJson.h>
+
+// ============================================================================
+// BATTERY ADC
+// PIN_VBAT_ADC is converted continuously by the ADC1 digital controller and
+// DMA at VBAT_ADC_SAMPLE_HZ (IDF 4.4 adc_digi driver). A small reader task
+// on the comms core decimates each DMA frame to one integer block
+// (sum / min / max); the control tick turns finished blocks into calibrated
+// millivolts, runs the IIR filter and publishes bike.batteryVoltage / Min /
+// Max / Ripple. If the DMA driver fails to start, an analogRead() every
+// VBAT_ADC_POLL_MS feeds the same blocks and ripple captures are unavailable.
+// ============================================================================
+
+// Start conversion and wait for the first block (valid reading at boot)
+void batteryAdcInit();
+
+// Consume finished blocks and publish the filtered values (every tick)
+void batteryAdcUpdate();
+
+// Per-block consumers (crank monitor, …): calibrated battery mV of every
+// finished block, called from batteryAdcUpdate() on the control task
+typedef void (*VbatBlockFn)(TimeUs now, int32_t meanMv, int32_t minMv, int32_t maxMv);
+void batteryAdcOnBlock(VbatBlockFn fn);
+
+// Ripple capture: copy the next RIPPLE_FFT_SIZE raw samples out of the DMA
+// frames (false on the polled fallback – far too slow for rectifier ripple)
+bool batteryAdcCaptureArm();
+bool batteryAdcCaptureAvailable();
+
+// Finished capture as calibrated battery mV; false while still filling
+bool batteryAdcCaptureTake(float* mv);
+
+// Stop / restart conversion around a light sleep (control task)
+void batteryAdcSleepPrepare();
+void batteryAdcSleepRelease();
+
+// Diagnostics for the web metrics endpoint
+void batteryAdcBuildMetricsJson(JsonDocument& doc);
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "state.h"
+#include <ArduinoJson.h>
+
+// ============================================================================
+// BATTERY HEALTH
+// Every start is a load test: with the starter stalled at inrush, the sag
+// from rest to the dip gives the loop internal resistance
+//   R = BATT_STARTER_STALL_MOHM × (rest − dip) / dip
+// The estimate is the median of the last BATT_MEDIAN cranks; the first
+// BATT_BASELINE_CRANKS of a battery set its baseline, and state of health
+// falls linearly to 0 % at BATT_EOL_FACTOR × baseline. Each crank is one
+// 8-byte NVS key in a BATT_HISTORY rotation, so a start costs one entry
+// write and no key is rewritten more than every BATT_HISTORY starts.
+// ============================================================================
+
+// Load history from NVS, register the comms job
+void batteryHealthInit();
+
+// New battery fitted: relearn the baseline from the next cranks (any task)
+void batteryHealthReset();
+
+// Estimate, baseline, history and the last crank profile (/api/battery)
+void batteryHealthBuildJson(JsonDocument& doc);
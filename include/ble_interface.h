@@ -4,8 +4,8 @@
 #include <ArduinoJson.h>
 
 // ─── Core BLE (GATT server for diagnostics) ───
+// Registers the state-notify and keyless scan / grace jobs (comms task)
 void bleInit();
-void bleUpdate();
 bool bleHasNewSettings();
 Settings bleGetNewSettings();
 
@@ -20,6 +20,18 @@ bool bleKeylessIgnitionAllowed();
 // Notify keyless that the engine has stopped (start grace timer)
 void bleKeylessEngineOff();
 
+// Scan window open (keyless or pairing), for energy accounting
+bool bleKeylessScanning();
+
+// Keyless has something in progress (phone seen, granted, grace, pairing)
+bool bleKeylessBusy();
+
+// ─── Parked low-duty radio (comms task) ───
+// Park mode: advertising at PARK_ADV_INTERVAL_MS, off outside windows, and
+// no periodic keyless scans. A window advertises and runs one scan burst.
+void bleParkMode(bool enable);
+void bleParkWindow(bool open);
+
 // ─── Keyless Configuration ───
 void bleKeylessConfigure(bool enabled, int rssiThreshold, int graceSeconds);
 
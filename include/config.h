@@ -27,8 +27,11 @@ enum LogLevel : uint8_t {
 
 #define LOG_E(fmt, ...) do { if (LOG_LEVEL >= LOG_ERROR) Serial.printf("[E] " fmt "\n", ##__VA_ARGS__); } while(0)
 #define LOG_W(fmt, ...) do { if (LOG_LEVEL >= LOG_WARN)  Serial.printf("[W] " fmt "\n", ##__VA_ARGS__); } while(0)
-#define LOG_I(fmt, ...) do { if (LOG_LEVEL >= LOG_INFO)  Serial.printf("[I] " fmt "\n", ##__VA_ARGS__); } while(0)
-#define LOG_D(fmt, ...) do { if (LOG_LEVEL >= LOG_DEBUG) Serial.printf("[D] " fmt "\n", ##__VA_ARGS__); } while(0)
+// Info / debug lines are dropped while the calling task is over its tick
+// budget (scheduler.cpp); warnings and errors always print
+bool logShed();
+#define LOG_I(fmt, ...) do { if (LOG_LEVEL >= LOG_INFO  && !logShed()) Serial.printf("[I] " fmt "\n", ##__VA_ARGS__); } while(0)
+#define LOG_D(fmt, ...) do { if (LOG_LEVEL >= LOG_DEBUG && !logShed()) Serial.printf("[D] " fmt "\n", ##__VA_ARGS__); } while(0)
 
 // ============================================================================
 // PIN DEFINITIONS – INPUTS (active LOW unless noted)
@@ -73,6 +76,35 @@ enum LogLevel : uint8_t {
 // Vibration/shock sensor for alarm (shares AUX2 input when alarm enabled)
 #define PIN_VIBRATION    PIN_AUX2
 
+// ============================================================================
+// INPUT PIN TABLE (bit order of the packed input word)
+// ============================================================================
+enum InputId : uint8_t {
+  IN_LOCK = 0, IN_TURNL, IN_TURNR, IN_LIGHT, IN_START, IN_HORN,
+  IN_BRAKE, IN_KILL, IN_STAND, IN_AUX1, IN_AUX2, IN_SPEED,
+  INPUT_COUNT
+};
+
+static const int INPUT_PINS[INPUT_COUNT] = {
+  PIN_LOCK, PIN_TURNL, PIN_TURNR, PIN_LIGHT, PIN_START, PIN_HORN,
+  PIN_BRAKE, PIN_KILL, PIN_STAND, PIN_AUX1, PIN_AUX2, PIN_SPEED
+};
+
+// Default debounce / glitch-filter time per input (ms, InputId order).
+// A level must be stable this long to be accepted; 0 = unfiltered.
+#define DEBOUNCE_DEFAULTS_MS { \
+  DEBOUNCE_DELAY_MS,  /* lock  */  DEBOUNCE_DELAY_MS,  /* turnL */ \
+  DEBOUNCE_DELAY_MS,  /* turnR */  DEBOUNCE_DELAY_MS,  /* light */ \
+  30,                 /* start */  30,                 /* horn  */ \
+  10,                 /* brake */  20,                 /* kill  */ \
+  200,                /* stand */  DEBOUNCE_DELAY_MS,  /* aux1  */ \
+  100,                /* aux2 / vibration */           5 /* speed */ \
+}
+
+#define INPUT_BIT(id)           ((uint16_t)(1u << (id)))
+#define INPUT_ALL_MASK          ((uint16_t)((1u << INPUT_COUNT) - 1))
+#define INPUT_ACTIVE_HIGH_MASK  INPUT_BIT(IN_LOCK)   // All others switch to GND
+
 // ============================================================================
 // OUTPUT PIN TABLE (for iteration)
 // ============================================================================
@@ -93,10 +125,13 @@ static const int CALIBRATION_PIN_COUNT = sizeof(CALIBRATION_PINS) / sizeof(CALIB
 // ============================================================================
 // TIMING CONSTANTS (ms)
 // ============================================================================
+#define CONTROL_MAX_SLEEP_MS       1000     // Longest control-loop sleep (< watchdog)
 #define DEBOUNCE_DELAY_MS            50
+#define DEBOUNCE_MAX_MS             255     // Per-input profile upper limit
+#define DEBOUNCE_COUNTER_SAMPLES      8     // 3-bit vertical counter
 #define FLASHER_PERIOD_MS           667     // 1.5 Hz = ~667ms
 #define STARTER_MAX_DURATION_MS    5000     // Max starter run time
-#define STARTER_ENGAGE_DELAY_MS    1500     // Delay before marking engine running
+#define STARTER_ENGAGE_DELAY_MS    1500     // Engine running after this when no crank signature
 #define LIGHT_SHORT_PRESS_MS        500
 #define LIGHT_LONG_PRESS_MS        2000
 #define DOUBLE_CLICK_WINDOW_MS      400
@@ -107,9 +142,12 @@ static const int CALIBRATION_PIN_COUNT = sizeof(CALIBRATION_PINS) / sizeof(CALIB
 #define STATUS_LED_PERIOD_MS       1000
 #define BRAKE_FLASH_PERIOD_MS       200     // 5Hz flash
 #define BRAKE_FADE_PERIOD_MS        333     // 3Hz fade cycle
+#define BRAKE_FADE_STEP_MS            9     // LUT step (37 × 9 ms = 333 ms)
 #define BRAKE_8X_DURATION_MS       1600     // 8 flashes
 #define BRAKE_2X_DURATION_MS        800     // 2 flashes
 #define BRAKE_CONTINUOUS_DELAY_MS  3000     // 3s before flash
+#define BRAKE_PATTERN_MIN_DUTY       80     // Custom brake pattern: "lit" (= fade floor)
+#define BRAKE_PATTERN_MAX_DARK_MS   500     // Custom brake pattern: longest dark stretch
 
 // Turn signal auto-off
 #define TURN_DISTANCE_TIMEOUT_MS  10000
@@ -119,6 +157,13 @@ static const int CALIBRATION_PIN_COUNT = sizeof(CALIBRATION_PINS) / sizeof(CALIB
 #define TURN_DISTANCE_MIN_PULSES     10
 #define TURN_DISTANCE_MAX_PULSES   1000
 
+// Speed sensor (edge interrupt capture, µs timestamps)
+#define SPEED_MIN_PERIOD_US         100     // Glitch filter: edges < 100µs apart ignored
+#define SPEED_STOP_TIMEOUT_US   2000000     // No pulse for 2s → standing still
+#define SPEED_MM_PER_PULSE         1000     // Wheel travel per pulse (tdist ≈ metres)
+#define SPEED_FILTER_INTERVAL_MS     20     // Smoothing update period
+#define SPEED_FILTER_SHIFT            3     // IIR weight 1/8 per update
+
 // mo.wave sequential turn signal animation
 #define MOWAVE_STEP_MS              120     // Duration per segment (3 steps × 120ms = 360ms on)
 #define MOWAVE_STEPS                  3     // Number of sequential segments
@@ -127,6 +172,7 @@ static const int CALIBRATION_PIN_COUNT = sizeof(CALIBRATION_PINS) / sizeof(CALIB
 // Alarm system
 #define ALARM_ARM_DELAY_MS        30000     // 30s after ignition off to arm
 #define ALARM_DURATION_MS         30000     // 30s alarm sounding duration
+#define ALARM_FLASH_PERIOD_MS       200     // Horn + turn signals on/off while sounding
 #define ALARM_VIBRATION_DEBOUNCE_MS 100     // Debounce vibration sensor
 #define ALARM_TRIGGER_THRESHOLD       3     // Hits within window to trigger
 #define ALARM_TRIGGER_WINDOW_MS    2000     // Window for counting vibration hits
@@ -134,22 +180,145 @@ static const int CALIBRATION_PIN_COUNT = sizeof(CALIBRATION_PINS) / sizeof(CALIB
 // Watchdog
 #define WATCHDOG_TIMEOUT_S            3
 
+// Tasks: control (inputs, safety, outputs) and communications on separate cores
+#define CONTROL_PERIOD_US          1000     // Fixed-rate control tick (1 kHz) while active
+#define CONTROL_TASK_CORE             1
+#define CONTROL_TASK_PRIORITY        20     // Above WiFi/BLE host, below esp_timer (22)
+#define CONTROL_TASK_STACK         6144
+#define COMMS_TASK_CORE               0
+#define COMMS_TASK_PRIORITY           2     // BLE, web, NVS writes
+#define COMMS_TASK_STACK           8192
+#define COMMS_PERIOD_MS              10
+#define SCHED_MAX_JOBS               16     // Timer-wheel jobs across both tasks
+#define CONTROL_BUDGET_US           500     // Past this, sheddable control work is skipped
+#define COMMS_BUDGET_US            5000     // Past this, broadcasts / NVS wait a round
+#define SETTINGS_FLUSH_MS           100     // Deferred settings save check
+
 // Battery voltage thresholds
-#define VBAT_DIVIDER_RATIO        5.7f     // 47k + 10k voltage divider
+#define VBAT_DIVIDER_NUM            57     // 47k + 10k voltage divider: ×5.7
+#define VBAT_DIVIDER_DEN            10
 #define VBAT_WARNING_LOW         11.0f     // Low voltage warning
 #define VBAT_CRITICAL_LOW        10.0f     // Critical – shutdown non-essential
 #define VBAT_WARNING_HIGH        15.0f     // Overvoltage warning
 #define VBAT_CRITICAL_HIGH       15.5f     // Critical overvoltage
-#define VBAT_SAMPLE_INTERVAL_MS   1000     // Read every 1s
-#define VBAT_FILTER_SAMPLES          8     // Moving average window
+#define VBAT_ADC_SAMPLE_HZ       20000     // Continuous (DMA) conversion rate
+#define VBAT_ADC_FRAME_SAMPLES     256     // Samples per DMA frame = one block
+#define VBAT_ADC_TASK_PRIORITY       5     // DMA frame reader (comms core), above comms
+#define VBAT_ADC_TASK_STACK       2048
+#define VBAT_ADC_POLL_MS             4     // Fallback without DMA: analogRead() period
+#define VBAT_ADC_POLL_BLOCK          4     // Fallback samples per block (16 ms, ~one frame)
+#define VBAT_ADC_FULL_SCALE_MV    3100     // Uncalibrated fallback, 11 dB atten.
+#define VBAT_IIR_SHIFT               3     // Filter weight 1/8 per block (~100ms)
+#define VBAT_STATS_WINDOW_MS      1000     // Min / max window
 
-// PWM configuration
-#define PWM_FREQ_HZ              5000
-#define PWM_RESOLUTION_BITS         8      // 0-255
-#define PWM_CHANNEL_BRAKE           0
-#define PWM_CHANNEL_POSITION        1
-#define PWM_CHANNEL_TURNL           2      // mo.wave left turn
-#define PWM_CHANNEL_TURNR           3      // mo.wave right turn
+// Charging system ripple analysis (engine running, DMA capture only)
+#define RIPPLE_FFT_SIZE           1024     // Samples per capture (51ms at 20kHz)
+#define RIPPLE_ANALYSIS_MS         100     // Capture + FFT cadence, ignition on (comms task)
+#define RIPPLE_MIN_HZ               50     // Lines below are load steps, not ripple
+#define RIPPLE_MIN_MV              100     // Below this p-p the rectifier is not judged
+#define RIPPLE_HIGH_MV             250     // 2-pulse ripple p-p → open phase
+#define RIPPLE_DIODE_THD          0.6f     // Harmonics 2-6 / fundamental → missing pulse
+#define RIPPLE_OVERCHARGE_V      14.8f     // Mean while running, regulator not limiting
+#define RIPPLE_CONFIRM              20     // Consecutive verdicts to set / clear a fault (~2s)
+
+// Crank monitor (starter engaged, battery ADC blocks)
+#define CRANK_DIP_MIN_MV          1000     // Inrush sag that marks a real crank
+#define CRANK_SETTLE_MS            150     // Inrush over, cranking plateau starts
+#define CRANK_MIN_MS               300     // No cut before (plateau established)
+#define CRANK_RECOVER_PCT           60     // Back this far from plateau to rest → caught
+#define CRANK_CATCH_BLOCKS           3     // Consecutive recovered blocks (~40ms)
+#define CRANK_PROFILE_BLOCKS        32     // Block means kept per crank (~410ms)
+
+// Battery health (internal resistance from the crank inrush sag)
+#define BATT_STARTER_STALL_MOHM     80     // Starter at stall incl. wiring (~150A at 12V)
+#define BATT_HISTORY                16     // Crank records in NVS, one key each (rotating)
+#define BATT_MEDIAN                  5     // Estimate = median of the last N cranks
+#define BATT_BASELINE_CRANKS         5     // New battery: baseline from its first N cranks
+#define BATT_EOL_FACTOR           2.0f     // Resistance at end of life vs baseline
+#define BATT_SOH_WARN_PCT           30     // Warn before the battery strands the rider
+#define BATT_SOH_UNKNOWN          0xFF     // No baseline yet
+
+// Lamp monitor (no current sense: the battery voltage step when a lamp switches)
+#define LAMP_SETTLE_MS              40     // Filament inrush / LED driver start over
+#define LAMP_AVG_BLOCKS              2     // Blocks averaged after the edge (~25ms)
+#define LAMP_TIMEOUT_MS            200     // No blocks by then → measurement dropped
+#define LAMP_RLOOP_DEFAULT_MOHM     25     // Battery + wiring until a crank estimate exists
+#define LAMP_MIN_MA                500     // Expected step below this is not judged
+#define LAMP_OPEN_PCT               30     // Step below this % of baseline → open circuit
+#define LAMP_OK_PCT                 60     // Step back above this % → lamp OK again
+#define LAMP_CONFIRM                 3     // Consecutive verdicts to set / clear a fault
+
+// Engine speed from the ripple line (no tach input): stator Hz = RPM / 60 × pole pairs
+#define RPM_POLE_PAIRS_DEFAULT       6
+#define RPM_POLE_PAIRS_MAX          12
+#define RPM_LINE_SNR              10.0f     // Ripple line vs mean bin magnitude
+#define RPM_TRACK_TOLERANCE       0.2f     // Consecutive estimates must agree within 20%
+#define RPM_RUNNING_MIN            600     // Starter off + above this → engine running
+#define RPM_UNKNOWN             0xFFFF     // No ripple captures (ADC fallback): not measured
+
+// Load shedding: tier 1 goes first, tier 3 last, 0 = never shed.
+// A tier sheds after SHED_TIERn_HOLD_MS below SHED_TIERn_MV; shed tiers come
+// back one at a time, most important first, each once the battery has held
+// SHED_HYST_MV above that tier's threshold for SHED_RESTORE_MS.
+#define SHED_TIERS                   3
+#define SHED_TIER1_MV            11800     // Comfort loads (heated grips / vests)
+#define SHED_TIER1_HOLD_MS       10000
+#define SHED_TIER2_MV            11000     // = VBAT_WARNING_LOW
+#define SHED_TIER2_HOLD_MS        5000
+#define SHED_TIER3_MV            10000     // = VBAT_CRITICAL_LOW
+#define SHED_TIER3_HOLD_MS        2000
+#define SHED_HYST_MV               600
+#define SHED_RESTORE_MS          10000
+// Per OUTPUT_PINS entry; brake, turn, starter and ignition are always 0
+#define SHED_TIER_DEFAULTS { \
+  0, 0, 0, 0,        /* turnL turnR light hibeam */ \
+  0, 3, 0, 0,        /* brake horn  start1 start2 */ \
+  0, 1, 1            /* ign   aux1  aux2 */ \
+}
+
+// Energy accounting (comms task): current = duty × nominal watts / 12 V
+#define ENERGY_SAMPLE_MS           100     // Output / radio sampling period
+#define ENERGY_NOMINAL_MV        12000
+#define ENERGY_BASE_MA              15     // Controller itself, at the battery
+#define ENERGY_WIFI_AP_MA           45     // AP radio on (12V side of the regulator)
+#define ENERGY_BLE_SCAN_MA          30     // Keyless scan window
+#define ENERGY_SOC_SETTLE_MS     60000     // Rest voltage read this long after ignition off
+#define ENERGY_SOC_FULL_MV       12700     // Lead-acid / AGM open-circuit voltage at 100 %
+#define ENERGY_SOC_EMPTY_MV      11900     // … and at 0 %
+#define BATTERY_AH_DEFAULT           8
+#define PARK_FLOOR_PCT_DEFAULT      60     // Keep enough charge to crank
+#define ENERGY_SLEEP_MA              2     // Controller in light sleep, at the battery
+// Nominal watts per OUTPUT_PINS entry (0 = not counted)
+#define OUTPUT_WATTS_DEFAULTS { \
+  21, 21, 55, 60,    /* turnL turnR light hibeam */ \
+  21, 40, 750, 750,  /* brake horn  start1 start2 */ \
+  60, 0, 0           /* ign   aux1  aux2 */ \
+}
+
+// Parked power mode: settings.parkSleepMin after ignition off the WiFi AP
+// goes down, BLE only runs in short windows and the control task light-sleeps
+#define PARK_SLEEP_MIN_DEFAULT       5     // Minutes, 0 = stay fully awake
+#define PARK_CYCLE_MS            10000     // One radio window per cycle
+#define PARK_WINDOW_MS            1500     // Advertising + one keyless scan burst
+#define PARK_ADV_INTERVAL_MS       500     // Advertising interval inside windows
+#define PARK_SLEEP_MIN_MS           20     // Shorter waits stay in the RTOS wait
+#define POWER_JOB_MS               100     // Mode / window decisions (comms task)
+
+// Dimmed outputs: gamma-corrected level, duty scaled by (nominal / battery)²
+// so filament power (brightness) stays at the 12.0 V value while charging
+#define DIM_NOMINAL_MV          12000     // Duty as configured at this voltage
+#define DIM_HYST_MV               100     // Recompute the factor past this change
+#define DIM_POSITION_MIN           66     // Perceived level, positionLight 1 (~5% duty)
+#define DIM_POSITION_MAX          186     // Perceived level, positionLight 9 (~50% duty)
+#define DIM_TAIL_LEVEL            148     // Dimmed tail light (~30% duty)
+#define DIM_PARKING_LEVEL         136     // Parking position light (~25% duty)
+#define AUX_POWER_MIN_PCT          10     // Constant-power AUX range (0 = plain switching)
+
+// PWM configuration (LEDC channels are allocated on demand per output)
+#define PWM_FREQ_HZ              5000      // Default per-output frequency
+#define PWM_RESOLUTION_BITS         8      // Default resolution (0-255)
+#define PWM_RESOLUTION_MAX_BITS    14      // LEDC limit on the ESP32-S3
+#define PWM_CHANNEL_COUNT           8      // LEDC channels (pairs share a timer)
 
 // BLE
 #define BLE_DEVICE_NAME        "Moto32"
@@ -159,6 +328,7 @@ static const int CALIBRATION_PIN_COUNT = sizeof(CALIBRATION_PINS) / sizeof(CALIB
 #define BLE_CHAR_SETTINGS_UUID "4d6f7432-0001-0003-0000-000000000000"
 #define BLE_CHAR_ERRORS_UUID   "4d6f7432-0001-0004-0000-000000000000"
 #define BLE_CHAR_COMMAND_UUID  "4d6f7432-0001-0005-0000-000000000000"
+#define BLE_CHAR_PATTERN_UUID  "4d6f7432-0001-0006-0000-000000000000"
 
 // ============================================================================
 // ENUMERATIONS
@@ -187,7 +357,8 @@ enum BrakeLightMode : uint8_t {
   BRAKE_FLASH_8X    = 3,  // 8x flash then continuous
   BRAKE_FLASH_2X    = 4,  // 2x flash then 1s continuous
   BRAKE_3S_FLASH    = 5,  // 3s continuous then flash
-  BRAKE_EMERGENCY   = 6   // Emergency braking mode
+  BRAKE_EMERGENCY   = 6,  // Emergency braking mode
+  BRAKE_CUSTOM      = 7   // Uploaded pattern (continuous until one exists)
 };
 
 enum CalibrationState : uint8_t {
@@ -202,5 +373,10 @@ enum ErrorCode : uint8_t {
   ERR_HIGH_VOLTAGE    = 0x02,
   ERR_STARTER_TIMEOUT = 0x04,
   ERR_WATCHDOG_RESET  = 0x08,
-  ERR_STAND_KILL      = 0x10
+  ERR_STAND_KILL      = 0x10,
+  ERR_RECT_DIODE      = 0x20,   // Ripple analysis: failed rectifier diode
+  ERR_OPEN_PHASE      = 0x40,   // Ripple analysis: stator phase open
+  ERR_OVERCHARGE      = 0x80    // Ripple analysis: regulator not limiting
 };
+
+#define ERR_CHARGING_MASK  (ERR_RECT_DIODE | ERR_OPEN_PHASE | ERR_OVERCHARGE)
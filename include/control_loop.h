@@ -0,0 +1,37 @@
+#pragma once
+
+#include "state.h"
+#include <ArduinoJson.h>
+
+// ============================================================================
+// CONTROL TASK
+// Inputs, safety and outputs run in a dedicated task pinned to
+// CONTROL_TASK_CORE. While the bike is active it ticks at a fixed
+// CONTROL_PERIOD_US; when parked it sleeps on a task notification until an
+// input edge, a command or the earliest registered deadline – or, once the
+// parked power mode allows it, light-sleeps the chip until then.
+// BLE, web and NVS persistence run in a low-priority task on COMMS_TASK_CORE.
+// ============================================================================
+
+// Start both tasks (call once, at the end of setup())
+void controlTasksStart(void (*controlTick)(), void (*commsTick)());
+
+// Select fixed-rate ticking (true) or event-driven sleep (false) for the
+// following ticks. Call from the control tick.
+void controlSetFixedRate(bool fixedRate);
+
+// Wake the control task from a GPIO interrupt (input edge)
+void controlWakeFromISR();
+
+// Wake the control task from another task (BLE/web command pending)
+void controlWake();
+
+// Request a wake-up no later than the given timeNow() timestamp while
+// event-driven. Updaters call this for their next timeout edge.
+void controlWakeAt(TimeUs deadline);
+
+// Mark the end of the output updaters (input-to-output latency probe)
+void controlOutputsWritten();
+
+// Tick, jitter and wake-up statistics for the web metrics endpoint
+void controlBuildMetricsJson(JsonDocument& doc);
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "state.h"
+#include <ArduinoJson.h>
+
+// ============================================================================
+// CRANK MONITOR
+// Follows the battery ADC blocks while the starter turns: the inrush sag
+// (at least CRANK_DIP_MIN_MV below rest) marks a real crank, the following
+// blocks average into the cranking plateau, and a recovery of
+// CRANK_RECOVER_PCT back towards rest over CRANK_CATCH_BLOCKS blocks means
+// the engine caught and the starter is freewheeling. Without the sag, or
+// on the polled ADC fallback (blocks too coarse for the inrush), the
+// starter keeps its button / engage-delay behaviour.
+// ============================================================================
+
+struct CrankStats {
+  int32_t  restMv     = 0;     // Before the starter engaged
+  int32_t  dipMv      = 0;     // Lowest block (inrush)
+  int32_t  plateauMv  = 0;     // Mean while cranking
+  uint32_t durationMs = 0;     // Starter on time
+  uint32_t catchMs    = 0;     // Starter on → recovery, 0 = did not catch
+  bool     signature  = false; // Inrush sag seen
+  uint8_t  blocks     = 0;     // Valid entries in profileMv
+  uint16_t profileMv[CRANK_PROFILE_BLOCKS] = {};  // Block means from starter on
+};
+
+// Hook the battery ADC blocks
+void crankMonitorInit();
+
+// True once per crank when the engine caught (control task)
+bool crankMonitorCaught();
+
+// The running crank is followed by its voltage signature, so the catch
+// alone may declare the engine running (control task)
+bool crankMonitorTracking();
+
+// Last finished (or running) crank (control task)
+const CrankStats& crankMonitorLast();
+
+// Copy of a crank finished since the last call (any task)
+bool crankMonitorTakeFinished(CrankStats& out);
+
+void crankMonitorBuildMetricsJson(JsonDocument& doc);
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "state.h"
+
+// ============================================================================
+// DIMMING / VOLTAGE COMPENSATION
+// Dimmed outputs are set as perceived levels (0-255), mapped to linear duty
+// through a gamma 2.2 integer LUT. Lamp and heater power go with duty × V²,
+// so the duty is scaled by (DIM_NOMINAL_MV / battery)² from the filtered
+// voltage: brightness and delivered power stay at their 12.0 V values from
+// a rested battery up to full charging voltage. Below nominal the configured
+// duty is the ceiling, so a weak battery is never drained harder.
+// ============================================================================
+
+// Refresh the compensation factor from bike.batteryVoltage (control task)
+void dimmingUpdate();
+
+// Perceived level 0-255 → compensated duty
+uint8_t dimBrightness(uint8_t level);
+
+// Percent of the load's nominal power → compensated duty (constant power)
+uint8_t dimPower(uint8_t pct);
+
+// Current factor, 4096 = 1.0
+uint16_t dimmingFactorQ12();
+
+// Constant-power AUX setting: 0 (switched) or AUX_POWER_MIN_PCT-100
+inline uint8_t auxPowerClamp(int pct) {
+  return pct <= 0 ? 0 : (uint8_t)constrain(pct, AUX_POWER_MIN_PCT, 100);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "state.h"
+#include <ArduinoJson.h>
+
+// ============================================================================
+// ENERGY ACCOUNTING
+// Every ENERGY_SAMPLE_MS the comms job integrates each output's resolved
+// duty against its nominal wattage (settings.outputWatts), plus the
+// controller (awake / light sleep), WiFi AP and keyless scan radio time,
+// into two accounts: parked (since ignition off) and ride (since ignition
+// on). The state of charge at parking comes from the rest voltage
+// ENERGY_SOC_SETTLE_MS after ignition off; once that minus the parked draw
+// falls below settings.parkFloorPct of settings.batteryAh, bike.parkCutoff
+// drops the parking light and alarm until the next ride.
+// ============================================================================
+
+// Register the sampling job (comms task)
+void energyInit();
+
+// Parked charge so far (mAh), for the state broadcast
+float energyParkedMah();
+
+// Both accounts per output / radio, SoC and projection (/api/energy)
+void energyBuildJson(JsonDocument& doc);
@@ -2,19 +2,36 @@
 
 #include "state.h"
 
-// Debounced digital input read
+// Configure all input pins (pull-up / pull-down per polarity)
+void inputsInit();
+
+// Rebuild the per-input debounce tick table from settings.debounceMs
+// (call after settings are loaded or changed)
+void inputsApplyDebounceProfile();
+
+// Read the GPIO input registers once and clock the vertical-counter
+// debounce for all inputs. Result lands in bike.inputWord.
+// Call once per loop, before anything reads inputs.
+void inputsSample();
+
+// Debounced state of one input from the packed word (no hardware access)
+inline bool inputBit(InputId id) {
+  return (bike.inputWord & INPUT_BIT(id)) != 0;
+}
+
+// Debounced digital input read (looks up the pin in the packed word)
 bool inputActive(int pin);
 
 // Raw read (no debounce) – for initial checks only
 bool inputRawActive(int pin);
 
-// Update a ButtonEvent from its pin
-void updateButtonEvent(int pin, ButtonEvent& event,
+// Update a ButtonEvent from its bit in the packed input word
+void updateButtonEvent(InputId id, ButtonEvent& event,
                        unsigned long longPressMs = 0,
                        unsigned long doubleClickMs = DOUBLE_CLICK_WINDOW_MS);
 
-// Refresh all button events in one call
+// Sample inputs and refresh all button events in one call
 void refreshInputEvents();
 
-// Speed sensor pulse counting (call every loop)
+// Speed sensor: publish ISR pulse total + period-based speed (call every loop)
 void handleSpeedSensor();
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "state.h"
+#include <ArduinoJson.h>
+
+// ============================================================================
+// LAMP MONITOR
+// There is no current sensing, but a lamp switching on or off steps the
+// battery voltage by I × R (battery + wiring). Each single on/off edge of a
+// CALIBRATION_PINS output is bracketed by battery ADC blocks: the block
+// before the edge against the mean of LAMP_AVG_BLOCKS blocks after
+// LAMP_SETTLE_MS gives the step, and the crank resistance estimate turns it
+// into a current. The calibration sequence learns each lamp's baseline;
+// a step below LAMP_OPEN_PCT of it LAMP_CONFIRM times in a row flags the
+// lamp open. Edges overlapping another output change, and all edges while
+// the engine runs (the regulator absorbs the step), are not judged.
+// ============================================================================
+
+// Load baselines from NVS, hook the battery ADC blocks, register the comms job
+void lampMonitorInit();
+
+// Calibration sequence start / end: steps in between become the baselines
+void lampMonitorLearn(bool on);
+
+// Detect output edges after outputsArbitrate() (control task)
+void lampMonitorUpdate(TimeUs now);
+
+// Open-circuit mask, bit per CALIBRATION_PINS entry (control task)
+uint8_t lampMonitorFaults();
+
+void lampMonitorBuildMetricsJson(JsonDocument& doc);
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "state.h"
+
+// ============================================================================
+// LIGHT PATTERNS
+// A pattern is a list of {ms, duty, repeat} segments evaluated by elapsed
+// time – no per-pattern code. Grouping rules:
+//   repeat = 0    segment continues the current group
+//   repeat = N    group (since the previous group end) ends here, played N×
+//   repeat = 0xFF group repeats forever
+//   ms     = 0    hold this duty forever (ends the pattern)
+// A pattern without a hold or endless group loops from the start.
+// ============================================================================
+
+struct PatternSeg {
+  uint16_t ms;
+  uint8_t  duty;      // 0 = off, 255 = full
+  uint8_t  repeat;
+};
+
+struct LightPattern {
+  const PatternSeg* seg;
+  uint8_t           count;
+};
+
+#define PATTERN_FOREVER    0xFF
+#define PATTERN_NEVER      0xFFFFFFFFu    // msToNext when the duty never changes
+#define PATTERN_MAX_SEGS   16             // Custom (uploaded) patterns
+
+// Built-in patterns
+extern const LightPattern PATTERN_BRAKE_FADE;    // 3Hz cosine 80-255
+extern const LightPattern PATTERN_BRAKE_FLASH;   // 200ms on/off, endless
+extern const LightPattern PATTERN_BRAKE_8X;      // 4 on/off pairs, then solid
+extern const LightPattern PATTERN_BRAKE_2X;      // 2 on/off pairs, then solid
+extern const LightPattern PATTERN_BRAKE_3S;      // 3s solid, then flash
+extern const LightPattern PATTERN_FLASHER;       // Turn / hazard 1.5Hz
+extern const LightPattern PATTERN_MOWAVE;        // 33/66/100% sweep + off
+extern const LightPattern PATTERN_ALARM;         // 200ms on/off
+
+// Duty at elapsedMs since the pattern started; msToNext = time until the
+// next segment boundary (PATTERN_NEVER once holding)
+uint8_t patternEval(const LightPattern& p, uint32_t elapsedMs, uint32_t* msToNext);
+
+// patternEval() under the upload lock, for players: a re-upload may reuse
+// the buffer of a custom pattern that is still playing (nests inside other
+// spinlocks)
+uint8_t patternEvalLocked(const LightPattern& p, uint32_t elapsedMs, uint32_t* msToNext);
+
+// Uploadable slots (WebSocket / BLE), persisted in NVS
+enum PatternSlot : uint8_t {
+  PATTERN_SLOT_BRAKE = 0,   // Used when brakeLightMode == BRAKE_CUSTOM
+  PATTERN_SLOT_HAZARD,      // Replaces PATTERN_FLASHER for hazard lights
+  PATTERN_SLOT_ALARM,       // Replaces PATTERN_ALARM
+  PATTERN_SLOT_COUNT
+};
+
+// Validate and publish a custom pattern (count 0 clears the slot).
+// Safe to call from the WS / BLE tasks while a player is running.
+// The brake slot must light at once (BRAKE_PATTERN_MIN_DUTY), never stay
+// dark longer than BRAKE_PATTERN_MAX_DARK_MS and never hold dark.
+bool patternSetCustom(PatternSlot slot, const PatternSeg* seg, uint8_t count);
+
+// Published custom pattern, or nullptr if the slot is empty
+const LightPattern* patternCustom(PatternSlot slot);
+
+// Consistent copy of a custom pattern (out: PATTERN_MAX_SEGS), 0 = empty
+uint8_t patternCopyCustom(PatternSlot slot, PatternSeg* out);
+
+// Custom pattern if uploaded, else the given built-in
+inline const LightPattern& patternOr(PatternSlot slot, const LightPattern& builtin) {
+  const LightPattern* p = patternCustom(slot);
+  return p ? *p : builtin;
+}
+
+const char* patternSlotName(PatternSlot slot);
+bool patternSlotFromName(const char* name, PatternSlot& slot);
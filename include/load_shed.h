@@ -0,0 +1,22 @@
+#pragma once
+
+#include "state.h"
+#include <ArduinoJson.h>
+
+// ============================================================================
+// LOAD SHEDDING
+// Outputs carry a priority tier (settings.shedTier, 0 = never shed). Each
+// tier has a voltage threshold and a time-at-voltage hold, so a starter dip
+// or a horn blast does not shed anything; a shed tier also takes every
+// less important tier with it. Restore is progressive: most important tier
+// first, each after a sustained recovery above threshold + SHED_HYST_MV.
+// Shed outputs are held off on the safety layer; transitions log once.
+// ============================================================================
+
+// Evaluate tiers and claim shed outputs (control task, after the ADC update)
+void loadShedUpdate(TimeUs now);
+
+// Tier clamped for an output (safety-relevant outputs are never shed)
+uint8_t loadShedTierClamp(int outputIdx, int tier);
+
+void loadShedBuildMetricsJson(JsonDocument& doc);
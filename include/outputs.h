@@ -1,6 +1,7 @@
 #pragma once
 
 #include "state.h"
+#include "light_patterns.h"
 
 // ============================================================================
 // OUTPUT CONTROL
@@ -10,15 +11,69 @@
 // MUST be called as first thing in setup() before anything else!
 void outputsInitEarly();
 
-// Set up PWM channels (call after outputsInitEarly)
+// Set up the LEDC channel pool (call after outputsInitEarly)
 void outputsInitPWM();
 
-// Basic on/off
-void outputOn(int pin);
-void outputOff(int pin);
+// Per-output PWM frequency / resolution. Takes effect the next time the
+// output is PWM-driven. Returns false for outputs that never use LEDC
+// (ignition and starters stay on the GPIO word for the kill fast path).
+bool outputSetPwmConfig(int pin, uint32_t freqHz, uint8_t resolutionBits);
 
-// PWM output (0-255)
-void outputPWM(int pin, uint8_t duty);
+// ============================================================================
+// OUTPUT ARBITRATION
+// Subsystems submit requests per output and layer during a tick; the
+// highest-priority layer with a request wins. Outputs nobody claims are off.
+// ============================================================================
+
+enum OutputLayer : uint8_t {
+  LAYER_SAFETY  = 0,   // Kill switch, critical voltage
+  LAYER_SERVICE = 1,   // Calibration sequence
+  LAYER_ALARM   = 2,
+  LAYER_HAZARD  = 3,
+  LAYER_USER    = 4,   // Normal riding functions
+  LAYER_PARKING = 5,
+  LAYER_COUNT,
+  LAYER_NONE    = 0xFF
+};
+
+#define DUTY_OFF   0
+#define DUTY_ON  255
+
+// Claim an output for this tick (duty 0 = off, 255 = on, else PWM)
+void outputRequest(OutputLayer layer, int pin, uint8_t duty);
+inline void outputRequestOn(OutputLayer layer, int pin)  { outputRequest(layer, pin, DUTY_ON); }
+inline void outputRequestOff(OutputLayer layer, int pin) { outputRequest(layer, pin, DUTY_OFF); }
+
+// Claim an output with a light pattern. An esp_timer plays it from the
+// moment the claim starts winning, so timing does not depend on the loop.
+// Renew the claim every tick; it restarts once another claim has won.
+void outputRequestPattern(OutputLayer layer, int pin, const LightPattern& pattern);
+
+// Resolve every output exactly once, drive it and commit to hardware.
+// Clears all requests for the next tick. Call once per loop after updaters.
+void outputsArbitrate();
+
+// Result of the last arbitration
+uint8_t     outputDuty(int pin);
+OutputLayer outputWinner(int pin);
+const char* outputLayerName(OutputLayer layer);
+
+// Current target level of an output (true if on or PWM-driven)
+bool outputState(int pin);
 
 // Force all outputs off (emergency / fail-safe)
 void outputsAllOff();
+
+// Safety fast path – ISR-safe direct GPIO register writes
+void outputsFastBrakeOn();   // Brake light full on (drops PWM routing)
+void outputsFastKill();      // Ignition + both starter outputs off
+
+// Control task, once the latched brake / kill edge has reached the input
+// word: drop the fast-path level hold so arbitration owns the pins again
+void outputsFastRelease(bool brake, bool kill);
+
+// Light sleep (parked power mode, control task): clock the LEDC timers in
+// use from RC_FAST so PWM outputs keep running. Returns the number of timers
+// moved, or -1 if the sleep must not happen (a pattern is playing).
+int  outputsSleepPrepare();
+void outputsSleepRelease();
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "state.h"
+#include <ArduinoJson.h>
+
+// ============================================================================
+// PARKED POWER MODE
+// ACTIVE while the ignition is on. PARKED after ignition off: event-driven
+// control loop, radios as usual. settings.parkSleepMin later, with nothing
+// holding the bike awake (alarm sounding, BLE / dashboard client, keyless
+// activity, setup, pending save), SLEEP: the WiFi AP goes down, BLE only
+// advertises and scans in a PARK_WINDOW_MS window every PARK_CYCLE_MS, and
+// the control task light-sleeps instead of blocking between deadlines.
+// PIN_LOCK, PIN_VIBRATION or the next deadline / window wake it; RAM (alarm
+// arming) is kept and PWM outputs run on from RC_FAST.
+// ============================================================================
+
+enum PowerMode : uint8_t {
+  POWER_ACTIVE = 0,
+  POWER_PARKED,
+  POWER_SLEEP
+};
+
+// Register the mode / window job (comms task), keep output pads in sleep
+void powerModeInit();
+
+// Light-sleep until the deadline or the next radio window, if the mode
+// allows it (control task, from the event wait). False = did not sleep.
+bool powerSleepUntil(TimeUs deadline);
+
+PowerMode powerMode();
+
+// Total light-sleep time (energy accounting)
+uint64_t powerSleptUs();
+
+// Mode, sleep and wake-up statistics for the web metrics endpoint
+void powerBuildMetricsJson(JsonDocument& doc);
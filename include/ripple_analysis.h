@@ -0,0 +1,46 @@
+#pragma once
+
+#include "state.h"
+#include <ArduinoJson.h>
+
+// ============================================================================
+// RIPPLE ANALYSIS
+// With ignition on, a RIPPLE_FFT_SIZE capture of the battery rail is
+// windowed and transformed on the comms task (esp-dsp when the core ships
+// it, portable radix-2 otherwise). A healthy 3-phase bridge leaves one
+// clean line at 6× the stator frequency; a failed diode drops one pulse per
+// electrical turn (strong harmonics of the lower repeat rate), an open phase
+// leaves 2-pulse ripple with deep gaps, and an overcharging regulator shows
+// in the mean. Verdicts must repeat RIPPLE_CONFIRM times to set or clear and
+// are only judged with the engine running and the starter off.
+// The same line gives engine RPM via settings.polePairs.
+// ============================================================================
+
+struct RippleResult {
+  float meanV         = 0;
+  float p2pMv         = 0;
+  float fundamentalHz = 0;     // Lowest strong line, 0 = not judged
+  float thd           = 0;     // Harmonics 2-6 relative to the fundamental
+  float rpm           = 0;     // Unfiltered estimate from this capture
+  uint8_t verdict     = 0;     // ERR_CHARGING_MASK bits of the last capture
+};
+
+// Build the window / twiddles and register the comms job
+void rippleAnalysisInit();
+
+// False when the ADC cannot capture (polled fallback): no charging verdicts
+// and no RPM – reported as unavailable, not as healthy
+bool rippleAnalysisAvailable();
+
+// Confirmed ERR_CHARGING_MASK bits (read by the control tick)
+uint8_t rippleAnalysisFaults();
+
+// Tracked engine RPM, 0 = no ripple line, RPM_UNKNOWN = no captures
+// (read by the control tick)
+uint16_t rippleAnalysisRpm();
+
+// Last analysed capture (comms task)
+const RippleResult& rippleAnalysisResult();
+
+// Diagnostics for the web metrics endpoint
+void rippleAnalysisBuildMetricsJson(JsonDocument& doc);
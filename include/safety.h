@@ -5,12 +5,12 @@
 // Initialize hardware watchdog timer
 void safetyInitWatchdog();
 
+// Subscribe the calling task (control and comms tasks each call this once)
+void safetyWatchCurrentTask();
+
 // Feed watchdog – call every loop iteration
 void safetyFeedWatchdog();
 
-// Read battery voltage via ADC (filtered)
-void safetyUpdateVoltage();
-
 // Get last filtered voltage reading
 float safetyGetVoltage();
 
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "state.h"
+#include <ArduinoJson.h>
+
+// ============================================================================
+// COOPERATIVE SCHEDULER
+// Periodic jobs and one-shot deadlines on a hierarchical timer wheel
+// (3 levels × 64 slots: 1 ms, 64 ms, 4.096 s → 262 s horizon). Each task
+// owns one wheel and calls schedRun() once per iteration; timeNow() is read
+// there once and handed to every job as the cached tick.
+// Jobs are registered at init; arm / cancel only from the owning task.
+//
+// Each task has a per-iteration time budget counted from schedRun(). Once it
+// is spent, sheddable jobs are skipped (periodic: until the next period,
+// one-shot: deferred 1 ms) and info/debug logging is dropped; essential jobs
+// always run. Shed counts are reported per job.
+// ============================================================================
+
+enum SchedTask : uint8_t {
+  SCHED_CONTROL = 0,    // Control task (core 1)
+  SCHED_COMMS,          // Comms task (core 0)
+  SCHED_TASK_COUNT
+};
+
+typedef int8_t SchedJob;
+#define SCHED_NONE  -1
+
+typedef void (*SchedFn)(TimeUs now);
+
+enum SchedClass : uint8_t {
+  SCHED_ESSENTIAL = 0,  // Always runs
+  SCHED_SHEDDABLE       // Skipped while the task is over budget
+};
+
+// Periodic job, first run one period from now
+SchedJob schedEvery(SchedTask task, const char* name, uint32_t periodMs, SchedFn fn,
+                    SchedClass cls = SCHED_ESSENTIAL);
+
+// One-shot job, registered idle – fire it with schedArm()
+SchedJob schedOneShot(SchedTask task, const char* name, SchedFn fn,
+                      SchedClass cls = SCHED_ESSENTIAL);
+
+// Per-iteration budget of a task (0 = unlimited)
+void schedSetBudget(SchedTask task, uint32_t budgetUs);
+
+// True once the task's current iteration has used up its budget
+bool schedOverBudget(SchedTask task);
+
+// (Re)arm a job delayMs after the task's cached tick; cancel stops it
+void schedArm(SchedJob job, uint32_t delayMs);
+void schedCancel(SchedJob job);
+bool schedArmed(SchedJob job);
+
+// Advance the task's wheel to timeNow(), run due jobs, return the cached tick
+TimeUs schedRun(SchedTask task);
+
+// Cached tick of the task's current iteration
+TimeUs schedNow(SchedTask task);
+
+// Earliest armed expiry of the task's jobs; false if none is armed
+bool schedNextDue(SchedTask task, TimeUs& due);
+
+// Per-job period, run time, overrun and shed statistics; per-task budget use
+void schedBuildMetricsJson(JsonDocument& doc);
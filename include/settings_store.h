@@ -2,5 +2,19 @@
 
 #include "state.h"
 
+#include "light_patterns.h"
+
 void loadSettings();
-void saveSettings();
+
+// Deferred saves from any task (control, web, BLE): flash writes stall the
+// cache, so requests are flushed by a sheddable comms job (held while over
+// budget)
+void requestSaveSettings();
+void settingsStoreInit();
+
+// Custom light patterns (one NVS blob per slot; loaded by loadSettings).
+// The slot's pattern as it is when the flush runs is written.
+void requestSaveCustomPattern(PatternSlot slot);
+
+// A deferred save has not reached flash yet (parked sleep waits for it)
+bool settingsSavePending();
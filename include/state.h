@@ -1,6 +1,7 @@
 #pragma once
 
 #include "config.h"
+#include "time_base.h"
 
 // ============================================================================
 // SETTINGS (persisted to NVS)
@@ -20,6 +21,15 @@ struct Settings {
   uint8_t         standKillMode   = 0;       // %3: 0=N/O, 1=N/C, 2=disabled
   uint8_t         parkingLightMode = 0;
   uint16_t        turnDistancePulsesTarget = 50;
+  uint8_t         debounceMs[INPUT_COUNT] = DEBOUNCE_DEFAULTS_MS;  // Per input, 0-255 ms (met within 1 ms)
+  uint8_t         polePairs       = RPM_POLE_PAIRS_DEFAULT;  // Alternator, for RPM
+  uint8_t         aux1Power       = 0;       // 0 = switched, else constant power %
+  uint8_t         aux2Power       = 0;
+  uint8_t         shedTier[OUTPUT_PIN_COUNT] = SHED_TIER_DEFAULTS;  // Load shedding priority
+  uint16_t        outputWatts[OUTPUT_PIN_COUNT] = OUTPUT_WATTS_DEFAULTS;  // Energy accounting
+  uint8_t         batteryAh       = BATTERY_AH_DEFAULT;
+  uint8_t         parkFloorPct    = PARK_FLOOR_PCT_DEFAULT;  // Parked cutoff, 0 = never
+  uint8_t         parkSleepMin    = PARK_SLEEP_MIN_DEFAULT;  // Parked light sleep, 0 = never
 };
 
 // ============================================================================
@@ -32,8 +42,8 @@ struct ButtonEvent {
   bool          released         = false;   // Falling edge this cycle
   bool          longPress        = false;   // One-shot on long press threshold
   bool          doubleClick      = false;   // Double-click detected
-  unsigned long pressStartTime   = 0;
-  unsigned long lastReleaseTime  = 0;
+  TimeUs        pressStartTime   = 0;
+  TimeUs        lastReleaseTime  = TIME_NONE;
   bool          longPressLatched = false;
 };
 
@@ -63,52 +73,59 @@ struct BikeState {
   bool brakePressed     = false;
   bool hornPressed      = false;
   bool standDown        = false;   // NEW: sidestand state
+  uint16_t      inputWord       = 0;   // Debounced inputs, bit n = InputId n
+  TimeUs        inputSampleTime = 0;   // Time of the last input snapshot
 
   // Turn signal timing
-  unsigned long leftTurnStartTime   = 0;
-  unsigned long rightTurnStartTime  = 0;
+  TimeUs        leftTurnStartTime   = 0;
+  TimeUs        rightTurnStartTime  = 0;
   unsigned long leftTurnStartPulses = 0;
   unsigned long rightTurnStartPulses = 0;
 
   // Brake timing
-  unsigned long brakePressTime  = 0;
-  unsigned long lastBrakeFlash  = 0;
-  bool          brakeFlashState = false;
+  TimeUs        brakePressTime  = 0;
 
   // Starter timing
-  unsigned long starterStartTime = 0;
+  TimeUs        starterStartTime = 0;
 
-  // Flasher
-  unsigned long lastFlasherToggle = 0;
-  bool          flasherState      = false;
-
-  // mo.wave sequential animation
-  uint8_t       waveStep          = 0;    // Current step (0 = both off, 1-2 = sequence, 3 = both on)
-  unsigned long waveStepStart     = 0;    // millis() when current step began
-  bool          wavePhaseOn       = true; // Current blink phase (on/off)
+  // Engine speed (alternator ripple), 0 = no estimate, RPM_UNKNOWN = not measurable
+  uint16_t      engineRpm       = 0;
 
   // Speed sensor
   unsigned long speedPulseCount = 0;
+  float         speedPulseHz    = 0.0f;  // Instantaneous, from last pulse period
+  float         speedKmh        = 0.0f;  // Smoothed road speed
 
   // Alarm
   bool          alarmArmed        = false;  // Alarm is armed
   bool          alarmTriggered    = false;  // Alarm currently sounding
-  unsigned long alarmTriggerTime  = 0;      // When alarm was triggered
-  unsigned long lastAlarmCheck    = 0;      // Debounce for vibration sensor
+  TimeUs        alarmTriggerTime  = TIME_NONE;  // When alarm was triggered
+  TimeUs        alarmArmStart     = TIME_NONE;  // Auto-arm delay start
+  TimeUs        lastAlarmCheck    = TIME_NONE;  // Debounce for vibration sensor
 
   // Setup mode
   bool          inSetupMode     = false;
-  unsigned long setupEnterTime  = 0;
+  TimeUs        setupEnterTime  = 0;
 
   // Calibration
   CalibrationState calibrationState     = CALIB_IDLE;
   int              calibrationStepIndex = 0;
-  unsigned long    calibrationStepStart = 0;
+  TimeUs           calibrationStepStart = 0;
   bool             calibrationStepOutputOn = false;
 
   // Battery
-  float   batteryVoltage    = 12.6f;
+  float   batteryVoltage    = 12.6f;   // Filtered (IIR)
+  float   batteryMin        = 12.6f;   // Lowest / highest sample, last window
+  float   batteryMax        = 12.6f;
+  float   batteryRipple     = 0.0f;    // Peak-to-peak within a DMA frame
+  float   batteryRint       = 0.0f;    // Internal resistance (mΩ) from cranking, 0 = none
+  uint8_t batterySoh        = BATT_SOH_UNKNOWN;  // State of health %
+  bool    batteryWorn       = false;   // SoH below BATT_SOH_WARN_PCT
   uint8_t errorFlags        = ERR_NONE;
+  uint8_t lampFaults        = 0;       // Open circuit, bit per CALIBRATION_PINS entry
+  uint16_t shedMask         = 0;       // Outputs held off by load shedding (OUTPUT_PINS bits)
+  uint8_t  shedLevel        = 0;       // Deepest tier shed, 0 = none
+  bool     parkCutoff       = false;   // Parked drain budget spent: parking light / alarm off
   bool    lowVoltageWarning = false;
 
   // AUX manual toggle (for AUX mode 2 = manual)
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+// ============================================================================
+// TIME BASE
+// One monotonic 64-bit microsecond clock for every state machine. It does
+// not wrap in the life of the bike, so timestamps are compared by plain
+// subtraction and "0 = not started" sentinels are replaced by TIME_NONE.
+// On target the source is esp_timer_get_time(); host builds inject theirs.
+// No Arduino dependencies – usable from host tests as-is.
+// ============================================================================
+
+typedef int64_t TimeUs;       // Absolute: µs since boot
+typedef int64_t DurationUs;   // Relative: µs
+
+#define TIME_NONE  INT64_MIN  // Timestamp not set
+
+constexpr DurationUs usFromMs(int64_t ms)  { return ms * 1000; }
+constexpr DurationUs usFromSec(int64_t s)  { return s * 1000000; }
+constexpr int64_t    msFromUs(DurationUs d) { return d / 1000; }
+
+inline bool timeIsSet(TimeUs t) { return t != TIME_NONE; }
+
+// True once d has passed since `since`; false while `since` is unset
+inline bool timeElapsed(TimeUs since, DurationUs d, TimeUs now) {
+  return since != TIME_NONE && now - since >= d;
+}
+
+// Current time from the active source
+TimeUs timeNow();
+
+// Replace the clock (host tests / simulation); nullptr restores esp_timer
+typedef TimeUs (*TimeSource)();
+void timeSetSource(TimeSource source);
@@ -2,11 +2,25 @@
 
 #include "state.h"
 
-// Initialize WiFi AP + AsyncWebServer + WebSocket
+// Initialize WiFi AP + AsyncWebServer + WebSocket; registers the
+// state (150 ms) and keyless (500 ms) broadcast jobs on the comms task
+// (both sheddable)
 void webInit();
 
-// Send state update to all connected WebSocket clients (call ~100ms)
-void webUpdate();
-
 // Broadcast a log message to clients
 void webLog(const char* text);
+
+// Settings changed from the dashboard; the control tick takes them over
+// and applies the debounce profile (nothing else may touch it)
+bool webHasNewSettings();
+Settings webGetNewSettings();
+
+// WiFi AP radio up (energy accounting)
+bool webApActive();
+
+// AP + mDNS up / down (parked power mode, comms task); no-op if unchanged
+void webApStart();
+void webApStop();
+
+// Open dashboard WebSocket connections
+size_t webClientCount();
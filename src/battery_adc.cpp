@@ -0,0 +1,325 @@
+#include "battery_adc.h"
+#include <driver/adc.h>
+#include <esp_adc_cal.h>
+
+// ============================================================================
+// BLOCKS (producer: reader task / fallback poll, consumer: batteryAdcUpdate)
+// ============================================================================
+
+struct AdcBlock {
+  uint32_t sum;
+  uint16_t count;
+  uint16_t min;
+  uint16_t max;
+};
+
+#define BLOCK_RING  8                      // Power of two
+
+static AdcBlock     ring[BLOCK_RING];
+static uint8_t      ringHead = 0, ringTail = 0;
+static uint32_t     blocksDropped = 0;
+static portMUX_TYPE adcMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void pushBlock(const AdcBlock& b) {
+  portENTER_CRITICAL(&adcMux);
+  if ((uint8_t)(ringHead - ringTail) < BLOCK_RING) {
+    ring[ringHead++ & (BLOCK_RING - 1)] = b;
+  } else {
+    blocksDropped++;
+  }
+  portEXIT_CRITICAL(&adcMux);
+}
+
+static bool popBlock(AdcBlock& b) {
+  portENTER_CRITICAL(&adcMux);
+  bool ok = ringTail != ringHead;
+  if (ok) b = ring[ringTail++ & (BLOCK_RING - 1)];
+  portEXIT_CRITICAL(&adcMux);
+  return ok;
+}
+
+// ============================================================================
+// CAPTURE (ripple analysis: raw samples copied from the DMA frames)
+// ============================================================================
+
+enum CaptureState : uint8_t { CAP_IDLE, CAP_FILLING, CAP_READY };
+
+static uint16_t              capBuf[RIPPLE_FFT_SIZE];
+static uint16_t              capCount = 0;
+static volatile CaptureState capState = CAP_IDLE;
+
+// ============================================================================
+// CALIBRATION
+// Raw → mV at the pin, piecewise linear over 17 knots sampled once from the
+// eFuse calibration scheme, so the tick path stays integer-only.
+// ============================================================================
+
+#define CALI_KNOTS  17                     // Every 256 raw counts
+
+static int32_t caliKnotMv[CALI_KNOTS];
+static bool    calibrated = false;
+
+static void caliBuildLinear() {
+  for (int k = 0; k < CALI_KNOTS; k++) {
+    caliKnotMv[k] = (int32_t)k * 256 * VBAT_ADC_FULL_SCALE_MV / 4095;
+  }
+}
+
+// rawQ8: raw counts × 256
+static int32_t caliToMv(uint32_t rawQ8) {
+  uint32_t idx  = rawQ8 >> 16;
+  uint32_t frac = rawQ8 & 0xFFFF;
+  if (idx >= CALI_KNOTS - 1) return caliKnotMv[CALI_KNOTS - 1];
+  int32_t a = caliKnotMv[idx], b = caliKnotMv[idx + 1];
+  return a + (int32_t)(((int64_t)(b - a) * frac) >> 16);
+}
+
+static int32_t pinToBatteryMv(int32_t mv) {
+  return mv * VBAT_DIVIDER_NUM / VBAT_DIVIDER_DEN;
+}
+
+// ============================================================================
+// DRIVER
+// ============================================================================
+
+#define FRAME_BYTES  (VBAT_ADC_FRAME_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES)
+
+static bool          dmaMode    = false;   // False: polled fallback
+static bool          dmaRunning = false;   // Stopped around light sleep
+static uint32_t      overruns   = 0;       // Driver ring full, frames lost
+static TaskHandle_t  readerTask = nullptr;
+static uint8_t       frameBuf[FRAME_BYTES];
+
+// Reader task: blocks in the driver until a DMA frame is complete and
+// decimates it to one block, copying raw samples into an armed capture.
+// The control tick only pops finished blocks.
+static void readerMain(void*) {
+  for (;;) {
+    uint32_t  len = 0;
+    esp_err_t err = adc_digi_read_bytes(frameBuf, FRAME_BYTES, &len, ADC_MAX_DELAY);
+    if (err == ESP_ERR_INVALID_STATE) overruns++;        // Data is still returned
+    else if (err != ESP_OK) continue;
+
+    AdcBlock b = { 0, 0, 0xFFFF, 0 };
+    for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= len; i += SOC_ADC_DIGI_RESULT_BYTES) {
+      const adc_digi_output_data_t* d = (const adc_digi_output_data_t*)&frameBuf[i];
+      uint16_t raw = d->type2.data & 0xFFF;
+      b.sum += raw;
+      b.count++;
+      if (raw < b.min) b.min = raw;
+      if (raw > b.max) b.max = raw;
+    }
+    if (!b.count) continue;
+    pushBlock(b);
+
+    if (capState == CAP_FILLING) {
+      portENTER_CRITICAL(&adcMux);
+      for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= len && capCount < RIPPLE_FFT_SIZE;
+           i += SOC_ADC_DIGI_RESULT_BYTES) {
+        capBuf[capCount++] = ((const adc_digi_output_data_t*)&frameBuf[i])->type2.data & 0xFFF;
+      }
+      if (capCount >= RIPPLE_FFT_SIZE) capState = CAP_READY;
+      portEXIT_CRITICAL(&adcMux);
+    }
+  }
+}
+
+static void caliBuildEfuse() {
+  esp_adc_cal_characteristics_t chars;
+  esp_adc_cal_value_t src = esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11,
+                                                     ADC_WIDTH_BIT_12, 1100, &chars);
+  for (int k = 0; k < CALI_KNOTS; k++) {
+    caliKnotMv[k] = esp_adc_cal_raw_to_voltage(min(k * 256, 4095), &chars);
+  }
+  calibrated = src != ESP_ADC_CAL_VAL_DEFAULT_VREF;
+}
+
+// ADC1 digital controller + DMA (IDF 4.4 driver). ADC2 is shared with WiFi
+// and cannot run continuously.
+static bool dmaStart() {
+  int ch = digitalPinToAnalogChannel(PIN_VBAT_ADC);
+  if (ch < 0 || ch >= SOC_ADC_MAX_CHANNEL_NUM) return false;
+
+  adc_digi_init_config_t init = {};
+  init.max_store_buf_size = 4 * FRAME_BYTES;
+  init.conv_num_each_intr = FRAME_BYTES;
+  init.adc1_chan_mask     = BIT(ch);
+  if (adc_digi_initialize(&init) != ESP_OK) return false;
+
+  adc_digi_pattern_config_t pattern = {};
+  pattern.atten     = ADC_ATTEN_DB_11;
+  pattern.channel   = ch;
+  pattern.unit      = 0;                   // ADC1 (unit index on IDF 4.4)
+  pattern.bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+
+  adc_digi_configuration_t cfg = {};
+  cfg.conv_limit_en  = false;
+  cfg.conv_limit_num = 250;
+  cfg.pattern_num    = 1;
+  cfg.adc_pattern    = &pattern;
+  cfg.sample_freq_hz = VBAT_ADC_SAMPLE_HZ;
+  cfg.conv_mode      = ADC_CONV_SINGLE_UNIT_1;
+  cfg.format         = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+  if (adc_digi_controller_configure(&cfg) != ESP_OK || adc_digi_start() != ESP_OK) {
+    adc_digi_deinitialize();
+    return false;
+  }
+  if (xTaskCreatePinnedToCore(readerMain, "vbat_adc", VBAT_ADC_TASK_STACK, nullptr,
+                              VBAT_ADC_TASK_PRIORITY, &readerTask, COMMS_TASK_CORE) != pdPASS) {
+    adc_digi_stop();
+    adc_digi_deinitialize();
+    return false;
+  }
+  dmaRunning = true;
+  return true;
+}
+
+// Fallback when the DMA driver is unavailable: one conversion every
+// VBAT_ADC_POLL_MS from the control tick, blocks of the same length
+static AdcBlock pollBlock = { 0, 0, 0xFFFF, 0 };
+static TimeUs   lastPoll  = 0;
+
+static void driverPoll() {
+  if (dmaMode) return;
+  TimeUs now = timeNow();
+  if (now - lastPoll < usFromMs(VBAT_ADC_POLL_MS)) return;
+  lastPoll = now;
+
+  uint16_t raw = analogRead(PIN_VBAT_ADC);
+  pollBlock.sum += raw;
+  pollBlock.count++;
+  if (raw < pollBlock.min) pollBlock.min = raw;
+  if (raw > pollBlock.max) pollBlock.max = raw;
+  if (pollBlock.count >= VBAT_ADC_POLL_BLOCK) {
+    pushBlock(pollBlock);
+    pollBlock = { 0, 0, 0xFFFF, 0 };
+  }
+}
+
+static void driverStart() {
+  caliBuildEfuse();
+  dmaMode = dmaStart();
+  if (dmaMode) return;
+  LOG_E("Battery ADC: DMA driver failed to start, polling every %u ms", VBAT_ADC_POLL_MS);
+  analogReadResolution(12);
+  analogSetPinAttenuation(PIN_VBAT_ADC, ADC_11db);
+}
+
+// ============================================================================
+// FILTER + PUBLISH (control task)
+// ============================================================================
+
+static int32_t  filtQ8     = -1;           // Battery mV × 256, -1 = no block yet
+static int32_t  rippleQ8   = 0;            // Peak-to-peak within a block, filtered
+static int32_t  winMinMv   = INT32_MAX, winMaxMv = 0;
+static TimeUs   winStart   = 0;
+static uint32_t blocks     = 0;
+
+#define BLOCK_HOOKS  4
+
+static VbatBlockFn hooks[BLOCK_HOOKS];
+static uint8_t     hookCount = 0;
+
+static void processBlock(const AdcBlock& b, TimeUs now) {
+  int32_t meanMv = pinToBatteryMv(caliToMv((b.sum << 8) / b.count));
+  int32_t minMv  = pinToBatteryMv(caliToMv((uint32_t)b.min << 8));
+  int32_t maxMv  = pinToBatteryMv(caliToMv((uint32_t)b.max << 8));
+
+  if (filtQ8 < 0) {
+    filtQ8   = meanMv << 8;
+    rippleQ8 = (maxMv - minMv) << 8;
+    bike.batteryMin = bike.batteryMax = meanMv / 1000.0f;
+  } else {
+    filtQ8   += ((meanMv << 8) - filtQ8) >> VBAT_IIR_SHIFT;
+    rippleQ8 += (((maxMv - minMv) << 8) - rippleQ8) >> VBAT_IIR_SHIFT;
+  }
+  if (minMv < winMinMv) winMinMv = minMv;
+  if (maxMv > winMaxMv) winMaxMv = maxMv;
+  blocks++;
+
+  for (uint8_t i = 0; i < hookCount; i++) hooks[i](now, meanMv, minMv, maxMv);
+}
+
+void batteryAdcInit() {
+  caliBuildLinear();
+  driverStart();
+
+  // First reading before the control loop relies on it
+  TimeUs deadline = timeNow() + usFromMs(50);
+  while (filtQ8 < 0 && timeNow() < deadline) {
+    driverPoll();
+    batteryAdcUpdate();
+    delay(1);
+  }
+  LOG_I("Battery ADC: %s, %s, %.2fV", dmaMode ? "DMA" : "polled",
+        calibrated ? "eFuse calibrated" : "uncalibrated", bike.batteryVoltage);
+}
+
+void batteryAdcUpdate() {
+  driverPoll();
+
+  TimeUs now = timeNow();
+  AdcBlock b;
+  while (popBlock(b)) processBlock(b, now);
+  if (filtQ8 < 0) return;
+
+  bike.batteryVoltage = filtQ8 / 256000.0f;
+  bike.batteryRipple  = rippleQ8 / 256000.0f;
+
+  // Min / max over the running window, published when the window closes
+  if (now - winStart >= usFromMs(VBAT_STATS_WINDOW_MS) && winMaxMv > 0) {
+    bike.batteryMin = winMinMv / 1000.0f;
+    bike.batteryMax = winMaxMv / 1000.0f;
+    winMinMv = INT32_MAX;
+    winMaxMv = 0;
+    winStart = now;
+  }
+}
+
+void batteryAdcOnBlock(VbatBlockFn fn) {
+  if (hookCount < BLOCK_HOOKS) hooks[hookCount++] = fn;
+}
+
+bool batteryAdcCaptureArm() {
+  if (!dmaMode) return false;
+  portENTER_CRITICAL(&adcMux);
+  if (capState == CAP_IDLE) {              // A capture still filling keeps going
+    capCount = 0;
+    capState = CAP_FILLING;
+  }
+  portEXIT_CRITICAL(&adcMux);
+  return true;
+}
+
+bool batteryAdcCaptureAvailable() {
+  return dmaMode;
+}
+
+void batteryAdcSleepPrepare() {
+  if (!dmaRunning) return;
+  adc_digi_stop();
+  dmaRunning = false;
+}
+
+void batteryAdcSleepRelease() {
+  if (dmaMode && !dmaRunning) dmaRunning = adc_digi_start() == ESP_OK;
+}
+
+bool batteryAdcCaptureTake(float* mv) {
+  if (capState != CAP_READY) return false;
+  for (int i = 0; i < RIPPLE_FFT_SIZE; i++) {
+    mv[i] = (float)pinToBatteryMv(caliToMv((uint32_t)capBuf[i] << 8));
+  }
+  capState = CAP_IDLE;
+  return true;
+}
+
+void batteryAdcBuildMetricsJson(JsonDocument& doc) {
+  JsonObject adc = doc["vbatAdc"].to<JsonObject>();
+  adc["mode"]       = dmaMode ? "dma" : "polled";
+  adc["calibrated"] = calibrated;
+  adc["sampleHz"]   = dmaMode ? VBAT_ADC_SAMPLE_HZ : 1000 / VBAT_ADC_POLL_MS;
+  adc["blocks"]     = blocks;
+  adc["dropped"]    = blocksDropped;
+  adc["overruns"]   = overruns;
+}
@@ -0,0 +1,175 @@
+#include "battery_health.h"
+#include "crank_monitor.h"
+#include "scheduler.h"
+#include <Preferences.h>
+#include <algorithm>
+
+static Preferences  healthPref;
+static const char*  NAMESPACE = "moto32bat";
+
+// ============================================================================
+// HISTORY (one NVS key per crank: [crank no:32][R mΩ×100:16][dip 10mV:16])
+// ============================================================================
+
+struct CrankRecord {
+  uint32_t crank;               // 0 = empty slot
+  uint16_t rCenti;              // mΩ × 100
+  uint16_t dip10mV;
+};
+
+static CrankRecord history[BATT_HISTORY];
+static uint8_t     head      = 0;         // Next slot to write
+static uint32_t    crankNo   = 0;         // Last recorded crank
+static uint32_t    baseStart = 0;         // Cranks up to here belong to older batteries
+static uint16_t    r0        = 0;         // Baseline mΩ × 100, 0 = learning
+static uint16_t    rNow      = 0;
+static CrankStats  lastCrank;
+static volatile bool resetRequested = false;
+
+static void slotKey(char* k, size_t len, uint8_t slot) {
+  snprintf(k, len, "c%u", slot);
+}
+
+static void saveSlot(uint8_t slot) {
+  const CrankRecord& r = history[slot];
+  char k[6];
+  slotKey(k, sizeof(k), slot);
+  healthPref.begin(NAMESPACE, false);
+  healthPref.putULong64(k, (uint64_t)r.crank << 32 | (uint32_t)r.rCenti << 16 | r.dip10mV);
+  healthPref.end();
+}
+
+static void saveBaseline() {
+  healthPref.begin(NAMESPACE, false);
+  healthPref.putUInt("base", baseStart);
+  healthPref.putUShort("r0", r0);
+  healthPref.end();
+}
+
+static void load() {
+  healthPref.begin(NAMESPACE, true);
+  baseStart = healthPref.getUInt("base", 0);
+  r0        = healthPref.getUShort("r0", 0);
+  for (uint8_t i = 0; i < BATT_HISTORY; i++) {
+    char k[6];
+    slotKey(k, sizeof(k), i);
+    uint64_t v = healthPref.getULong64(k, 0);
+    history[i] = { (uint32_t)(v >> 32), (uint16_t)(v >> 16), (uint16_t)v };
+    if (history[i].crank > crankNo) {
+      crankNo = history[i].crank;
+      head    = (i + 1) % BATT_HISTORY;
+    }
+  }
+  healthPref.end();
+}
+
+// Median R of the newest n records of the current battery, 0 if none
+static uint16_t recentMedian(uint8_t n) {
+  uint16_t r[BATT_HISTORY];
+  uint8_t  count = 0;
+  for (uint8_t i = 1; i <= BATT_HISTORY && count < n; i++) {
+    const CrankRecord& c = history[(head + BATT_HISTORY - i) % BATT_HISTORY];
+    if (c.crank == 0 || c.crank <= baseStart) break;
+    r[count++] = c.rCenti;
+  }
+  if (!count) return 0;
+  std::sort(r, r + count);
+  return r[count / 2];
+}
+
+// ============================================================================
+// ESTIMATE
+// ============================================================================
+
+static void publish() {
+  rNow = recentMedian(BATT_MEDIAN);
+  uint8_t soh = BATT_SOH_UNKNOWN;
+  if (r0 && rNow) {
+    float pct = 100.0f * (BATT_EOL_FACTOR * r0 - rNow) / ((BATT_EOL_FACTOR - 1.0f) * r0);
+    soh = (uint8_t)constrain(pct, 0.0f, 100.0f);
+  }
+  bool worn = soh != BATT_SOH_UNKNOWN && soh < BATT_SOH_WARN_PCT;
+  if (worn && !bike.batteryWorn) {
+    LOG_W("Battery worn: Rint %.1f mΩ (new %.1f mΩ), SoH %u%%", rNow / 100.0f, r0 / 100.0f, soh);
+  }
+  bike.batteryRint = rNow / 100.0f;
+  bike.batterySoh  = soh;
+  bike.batteryWorn = worn;
+}
+
+static void record(const CrankStats& c) {
+  uint32_t r = (uint32_t)BATT_STARTER_STALL_MOHM * 100 * (c.restMv - c.dipMv) / c.dipMv;
+  history[head] = { ++crankNo, (uint16_t)min(r, (uint32_t)UINT16_MAX), (uint16_t)(c.dipMv / 10) };
+  saveSlot(head);
+  head = (head + 1) % BATT_HISTORY;
+
+  if (!r0 && crankNo - baseStart >= BATT_BASELINE_CRANKS) {
+    r0 = recentMedian(BATT_BASELINE_CRANKS);
+    saveBaseline();
+    LOG_I("Battery baseline: %.1f mΩ", r0 / 100.0f);
+  }
+  publish();
+  LOG_I("Battery: crank %lu, Rint %.1f mΩ (median %.1f mΩ)", (unsigned long)crankNo,
+        r / 100.0f, rNow / 100.0f);
+}
+
+// Comms job: NVS writes stay off the control core
+static void healthJob(TimeUs) {
+  if (resetRequested) {
+    resetRequested = false;
+    baseStart = crankNo;
+    r0 = 0;
+    saveBaseline();
+    publish();
+    LOG_I("Battery health reset (new battery)");
+  }
+
+  CrankStats c;
+  if (!crankMonitorTakeFinished(c)) return;
+  lastCrank = c;
+  if (c.signature && c.dipMv > 0 && c.restMv > c.dipMv) record(c);
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+void batteryHealthInit() {
+  load();
+  publish();
+  schedEvery(SCHED_COMMS, "batt_soh", 200, healthJob, SCHED_SHEDDABLE);
+  LOG_I("Battery health: %lu cranks, Rint %.1f mΩ, baseline %.1f mΩ",
+        (unsigned long)(crankNo - baseStart), rNow / 100.0f, r0 / 100.0f);
+}
+
+void batteryHealthReset() {
+  resetRequested = true;
+}
+
+void batteryHealthBuildJson(JsonDocument& doc) {
+  doc["rintMohm"]     = rNow / 100.0f;
+  doc["baselineMohm"] = r0 / 100.0f;
+  if (bike.batterySoh != BATT_SOH_UNKNOWN) doc["soh"] = bike.batterySoh;
+  doc["warn"]   = bike.batteryWorn;
+  doc["cranks"] = crankNo - baseStart;
+
+  JsonArray hist = doc["history"].to<JsonArray>();
+  for (uint8_t i = 0; i < BATT_HISTORY; i++) {
+    const CrankRecord& c = history[(head + i) % BATT_HISTORY];
+    if (c.crank == 0) continue;
+    JsonObject h = hist.add<JsonObject>();
+    h["crank"] = c.crank;
+    h["rMohm"] = c.rCenti / 100.0f;
+    h["dipV"]  = c.dip10mV / 100.0f;
+    h["old"]   = c.crank <= baseStart;
+  }
+
+  JsonObject last = doc["lastCrank"].to<JsonObject>();
+  last["restMv"]     = lastCrank.restMv;
+  last["dipMv"]      = lastCrank.dipMv;
+  last["plateauMv"]  = lastCrank.plateauMv;
+  last["durationMs"] = lastCrank.durationMs;
+  last["catchMs"]    = lastCrank.catchMs;
+  JsonArray prof = last["profileMv"].to<JsonArray>();
+  for (uint8_t i = 0; i < lastCrank.blocks; i++) prof.add(lastCrank.profileMv[i]);
+}
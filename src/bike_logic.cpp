@@ -2,6 +2,11 @@
 #include "outputs.h"
 #include "inputs.h"
 #include "safety.h"
+#include "control_loop.h"
+#include "scheduler.h"
+#include "light_patterns.h"
+#include "crank_monitor.h"
+#include "dimming.h"
 
 // ============================================================================
 // INPUT HANDLERS
@@ -46,11 +51,8 @@ void handleTurnSignals() {
   if (turnLeftEvent.pressed && !rightState && !bike.hazardLightsOn) {
     bike.leftTurnOn  = !bike.leftTurnOn;
     bike.rightTurnOn = false;
-    bike.leftTurnStartTime   = millis();
+    bike.leftTurnStartTime   = schedNow(SCHED_CONTROL);
     bike.leftTurnStartPulses = bike.speedPulseCount;
-    // FIX #5: Reset flasher on mode change for clean phase
-    bike.flasherState       = false;
-    bike.lastFlasherToggle  = millis();
     LOG_D("Left turn toggled %s", bike.leftTurnOn ? "ON" : "OFF");
   }
 
@@ -58,42 +60,45 @@ void handleTurnSignals() {
   if (turnRightEvent.pressed && !leftState && !bike.hazardLightsOn) {
     bike.rightTurnOn = !bike.rightTurnOn;
     bike.leftTurnOn  = false;
-    bike.rightTurnStartTime   = millis();
+    bike.rightTurnStartTime   = schedNow(SCHED_CONTROL);
     bike.rightTurnStartPulses = bike.speedPulseCount;
-    bike.flasherState       = false;
-    bike.lastFlasherToggle  = millis();
     LOG_D("Right turn toggled %s", bike.rightTurnOn ? "ON" : "OFF");
   }
 
   // Auto-turn-off based on time / distance
   if (settings.turnSignalMode != TURN_OFF) {
-    unsigned long timeout = TURN_10S_TIMEOUT_MS;
+    DurationUs timeout = usFromMs(TURN_10S_TIMEOUT_MS);
     switch (settings.turnSignalMode) {
-      case TURN_DISTANCE: timeout = TURN_DISTANCE_TIMEOUT_MS; break;
-      case TURN_20S:      timeout = TURN_20S_TIMEOUT_MS;      break;
-      case TURN_30S:      timeout = TURN_30S_TIMEOUT_MS;      break;
+      case TURN_DISTANCE: timeout = usFromMs(TURN_DISTANCE_TIMEOUT_MS); break;
+      case TURN_20S:      timeout = usFromMs(TURN_20S_TIMEOUT_MS);      break;
+      case TURN_30S:      timeout = usFromMs(TURN_30S_TIMEOUT_MS);      break;
       default: break;
     }
+    TimeUs now = schedNow(SCHED_CONTROL);
 
     if (bike.leftTurnOn) {
-      unsigned long dur = millis() - bike.leftTurnStartTime;
+      DurationUs dur = now - bike.leftTurnStartTime;
       bool distReached = (settings.turnSignalMode == TURN_DISTANCE)
         && (bike.speedPulseCount - bike.leftTurnStartPulses
             >= settings.turnDistancePulsesTarget);
       if (dur >= timeout || distReached) {
         bike.leftTurnOn = false;
         LOG_D("Left turn auto-off");
+      } else {
+        controlWakeAt(bike.leftTurnStartTime + timeout);
       }
     }
 
     if (bike.rightTurnOn) {
-      unsigned long dur = millis() - bike.rightTurnStartTime;
+      DurationUs dur = now - bike.rightTurnStartTime;
       bool distReached = (settings.turnSignalMode == TURN_DISTANCE)
         && (bike.speedPulseCount - bike.rightTurnStartPulses
             >= settings.turnDistancePulsesTarget);
       if (dur >= timeout || distReached) {
         bike.rightTurnOn = false;
         LOG_D("Right turn auto-off");
+      } else {
+        controlWakeAt(bike.rightTurnStartTime + timeout);
       }
     }
   }
@@ -103,16 +108,16 @@ void handleTurnSignals() {
 
 void handleLight() {
   if (lightEvent.released) {
-    unsigned long dur = millis() - lightEvent.pressStartTime;
+    DurationUs dur = schedNow(SCHED_CONTROL) - lightEvent.pressStartTime;
 
-    if (dur < LIGHT_SHORT_PRESS_MS) {
+    if (dur < usFromMs(LIGHT_SHORT_PRESS_MS)) {
       if (bike.lowBeamOn) {
         bike.highBeamOn = !bike.highBeamOn;
       } else {
         bike.lowBeamOn = true;
       }
       LOG_D("Light toggle: low=%d high=%d", bike.lowBeamOn, bike.highBeamOn);
-    } else if (dur >= LIGHT_LONG_PRESS_MS) {
+    } else if (dur >= usFromMs(LIGHT_LONG_PRESS_MS)) {
       bike.lowBeamOn  = false;
       bike.highBeamOn = false;
       LOG_D("Lights OFF");
@@ -123,7 +128,12 @@ void handleLight() {
 // --------------------------------------------------------------------------
 // FIX #3: Starter logic completely reworked
 // The starter now runs while button is held, and engineRunning is only set
-// after the starter has been engaged for STARTER_ENGAGE_DELAY_MS.
+// after the starter has been engaged for STARTER_ENGAGE_DELAY_MS – or, with
+// the starter off, once the alternator ripple shows a running engine speed
+// (short start, bump start). Cranking ripple is the starter motor's own, so
+// the RPM estimate is not trusted while it turns.
+// The crank monitor cuts the starter as soon as the battery recovers from
+// the cranking sag (engine caught), even with the button still held.
 // --------------------------------------------------------------------------
 
 void handleStart() {
@@ -140,17 +150,29 @@ void handleStart() {
     // Single press: begin starter engagement
     if (bike.ignitionOn && !bike.killActive && !bike.engineRunning) {
       bike.starterEngaged  = true;
-      bike.starterStartTime = millis();
+      bike.starterStartTime = schedNow(SCHED_CONTROL);
       LOG_I("Starter ENGAGED");
     }
   }
 
   // While button is held, keep starter running
   if (startEvent.state && bike.starterEngaged) {
-    unsigned long elapsed = millis() - bike.starterStartTime;
+    DurationUs elapsed = schedNow(SCHED_CONTROL) - bike.starterStartTime;
+
+    if (crankMonitorCaught()) {
+      bike.starterEngaged = false;
+      if (!bike.engineRunning) {
+        bike.engineRunning = true;
+        bike.lowBeamOn = true;
+        LOG_I("Engine RUNNING");
+      }
+      return;
+    }
 
-    // After engage delay, consider engine running
-    if (elapsed >= STARTER_ENGAGE_DELAY_MS && !bike.engineRunning) {
+    // No crank signature to go by: after the engage delay, consider the
+    // engine running. Otherwise only the catch above may say so.
+    bool delayRule = !crankMonitorTracking();
+    if (delayRule && elapsed >= usFromMs(STARTER_ENGAGE_DELAY_MS) && !bike.engineRunning) {
       bike.engineRunning = true;
       bike.lowBeamOn = true;  // Low beam on after engine start (default)
       bike.killActive = false;
@@ -158,10 +180,13 @@ void handleStart() {
     }
 
     // Safety timeout: max starter duration
-    if (elapsed >= STARTER_MAX_DURATION_MS) {
+    if (elapsed >= usFromMs(STARTER_MAX_DURATION_MS)) {
       bike.starterEngaged = false;
       bike.errorFlags |= ERR_STARTER_TIMEOUT;
       LOG_W("Starter timeout – disengaged");
+    } else {
+      controlWakeAt(bike.starterStartTime + usFromMs(bike.engineRunning || !delayRule
+          ? STARTER_MAX_DURATION_MS : STARTER_ENGAGE_DELAY_MS));
     }
   }
 
@@ -172,6 +197,14 @@ void handleStart() {
       LOG_D("Starter released");
     }
   }
+
+  if (!bike.engineRunning && !bike.starterEngaged && bike.ignitionOn && !bike.killActive
+      && !(bike.errorFlags & ERR_STAND_KILL) && bike.engineRpm != RPM_UNKNOWN
+      && bike.engineRpm >= RPM_RUNNING_MIN) {
+    bike.engineRunning = true;
+    bike.lowBeamOn = true;
+    LOG_I("Engine RUNNING (%u rpm)", bike.engineRpm);
+  }
 }
 
 // --------------------------------------------------------------------------
@@ -183,11 +216,10 @@ void handleHorn() {
 // --------------------------------------------------------------------------
 
 void handleBrake() {
-  bool brakeState = inputActive(PIN_BRAKE);
+  bool brakeState = inputBit(IN_BRAKE);
 
   if (brakeState && !bike.brakePressed) {
-    bike.brakePressTime = millis();
-    bike.lastBrakeFlash = millis();
+    bike.brakePressTime  = schedNow(SCHED_CONTROL);
   }
 
   bike.brakePressed = brakeState;
@@ -199,102 +231,43 @@ void handleBrake() {
 
 void updateIgnition() {
   if (bike.ignitionOn && !bike.killActive) {
-    outputOn(PIN_IGN_OUT);
+    outputRequestOn(LAYER_USER, PIN_IGN_OUT);
   } else {
-    outputOff(PIN_IGN_OUT);
+    outputRequestOff(LAYER_USER, PIN_IGN_OUT);
   }
 }
 
 // --------------------------------------------------------------------------
-
+// Turn signals: standard flasher or mo.wave sweep (segments light up
+// sequentially 1→2→3→all, then off). Both are light patterns played by the
+// output timer – each restarts lit when its claim begins.
 // --------------------------------------------------------------------------
-// mo.wave sequential turn signal animation
-// Creates a sweep effect: segments light up sequentially (1→2→3→all),
-// then all off, then repeat. Gives a modern "running light" look.
-// --------------------------------------------------------------------------
-
-static void updateWaveFlasher(int pin, bool isActive, unsigned long now) {
-  if (!isActive) {
-    outputOff(pin);
-    return;
-  }
-
-  // Total cycle: MOWAVE_STEPS × MOWAVE_STEP_MS (on-sweep) + MOWAVE_OFF_MS (off)
-  unsigned long totalOn  = (unsigned long)MOWAVE_STEPS * MOWAVE_STEP_MS;
-  unsigned long totalCycle = totalOn + MOWAVE_OFF_MS;
-  unsigned long phase = (now - bike.waveStepStart) % totalCycle;
-
-  if (phase < totalOn) {
-    // During on-sweep: PWM brightness ramps up in steps
-    uint8_t step = phase / MOWAVE_STEP_MS;  // 0, 1, 2
-    // Brightness: step 0 = 33%, step 1 = 66%, step 2 = 100%
-    uint8_t duty = (uint8_t)(((step + 1) * 255) / MOWAVE_STEPS);
-    outputPWM(pin, duty);
-  } else {
-    // Off phase
-    outputOff(pin);
-  }
-}
 
 void updateTurnSignals() {
-  unsigned long now = millis();
-
-  // Standard flasher logic for non-wave mode
-  bool useWave = settings.moWaveEnabled && !bike.hazardLightsOn;
-
   if (bike.hazardLightsOn) {
     // Hazard: both flash together (always standard flash, never wave)
-    if (now - bike.lastFlasherToggle >= FLASHER_PERIOD_MS) {
-      bike.flasherState = !bike.flasherState;
-      bike.lastFlasherToggle = now;
-    }
-    if (bike.flasherState) {
-      outputOn(PIN_TURNL_OUT);
-      outputOn(PIN_TURNR_OUT);
-    } else {
-      outputOff(PIN_TURNL_OUT);
-      outputOff(PIN_TURNR_OUT);
-    }
-  } else if (bike.leftTurnOn) {
-    if (useWave) {
-      updateWaveFlasher(PIN_TURNL_OUT, true, now);
-    } else {
-      if (now - bike.lastFlasherToggle >= FLASHER_PERIOD_MS) {
-        bike.flasherState = !bike.flasherState;
-        bike.lastFlasherToggle = now;
-      }
-      if (bike.flasherState) outputOn(PIN_TURNL_OUT);
-      else                   outputOff(PIN_TURNL_OUT);
-    }
-    outputOff(PIN_TURNR_OUT);
+    const LightPattern& hazard = patternOr(PATTERN_SLOT_HAZARD, PATTERN_FLASHER);
+    outputRequestPattern(LAYER_HAZARD, PIN_TURNL_OUT, hazard);
+    outputRequestPattern(LAYER_HAZARD, PIN_TURNR_OUT, hazard);
+    return;
+  }
+
+  const LightPattern& flash = settings.moWaveEnabled ? PATTERN_MOWAVE : PATTERN_FLASHER;
+  if (bike.leftTurnOn) {
+    outputRequestPattern(LAYER_USER, PIN_TURNL_OUT, flash);
+    outputRequestOff(LAYER_USER, PIN_TURNR_OUT);
   } else if (bike.rightTurnOn) {
-    if (useWave) {
-      updateWaveFlasher(PIN_TURNR_OUT, true, now);
-    } else {
-      if (now - bike.lastFlasherToggle >= FLASHER_PERIOD_MS) {
-        bike.flasherState = !bike.flasherState;
-        bike.lastFlasherToggle = now;
-      }
-      if (bike.flasherState) outputOn(PIN_TURNR_OUT);
-      else                   outputOff(PIN_TURNR_OUT);
-    }
-    outputOff(PIN_TURNL_OUT);
-  } else {
-    outputOff(PIN_TURNL_OUT);
-    outputOff(PIN_TURNR_OUT);
+    outputRequestPattern(LAYER_USER, PIN_TURNR_OUT, flash);
+    outputRequestOff(LAYER_USER, PIN_TURNL_OUT);
   }
+  // Neither: unclaimed → off, or parking blinker when ignition is off
 }
 
 // --------------------------------------------------------------------------
 
 void updateLights() {
   if (!bike.ignitionOn) {
-    // Parking light is handled separately by updateParkingLight()
-    // Only turn off if parking light is not active
-    if (settings.parkingLightMode == 0 || bike.alarmTriggered) {
-      outputOff(PIN_LIGHT_OUT);
-    }
-    outputOff(PIN_HIBEAM_OUT);
+    // Lights unclaimed → off; parking light is its own layer
     return;
   }
 
@@ -308,22 +281,18 @@ void updateLights() {
 
   // Position light dimming (PWM)
   if (!bike.lowBeamOn && settings.positionLight > 0) {
-    uint8_t duty = map(settings.positionLight, 1, 9, 13, 128);  // ~5-50%
-    outputPWM(PIN_LIGHT_OUT, duty);
+    uint8_t level = map(settings.positionLight, 1, 9, DIM_POSITION_MIN, DIM_POSITION_MAX);
+    outputRequest(LAYER_USER, PIN_LIGHT_OUT, dimBrightness(level));  // ~5-50% at 12V
   } else if (bike.lowBeamOn) {
-    outputOn(PIN_LIGHT_OUT);
+    outputRequestOn(LAYER_USER, PIN_LIGHT_OUT);
   } else {
-    outputOff(PIN_LIGHT_OUT);
+    outputRequestOff(LAYER_USER, PIN_LIGHT_OUT);
   }
 
-  if (bike.highBeamOn) outputOn(PIN_HIBEAM_OUT);
-  else                 outputOff(PIN_HIBEAM_OUT);
+  if (bike.highBeamOn) outputRequestOn(LAYER_USER, PIN_HIBEAM_OUT);
+  else                 outputRequestOff(LAYER_USER, PIN_HIBEAM_OUT);
 }
 
-// --------------------------------------------------------------------------
-// FIX #7: Real PWM fade for BRAKE_FADE mode
-// --------------------------------------------------------------------------
-
 // --------------------------------------------------------------------------
 // Rear light modes (rearLightMode):
 //   0 = Standard (brake only)
@@ -336,14 +305,13 @@ void updateBrakeLight() {
     // When not braking, check rear light mode for tail light behavior
     if (bike.ignitionOn && settings.rearLightMode == 1) {
       // Dimmed tail light (~30% brightness)
-      outputPWM(PIN_BRAKE_OUT, 77);  // ~30% of 255
+      outputRequest(LAYER_USER, PIN_BRAKE_OUT, dimBrightness(DIM_TAIL_LEVEL));
     } else if (bike.ignitionOn && settings.rearLightMode == 2) {
       // Always on at full brightness
-      outputOn(PIN_BRAKE_OUT);
+      outputRequestOn(LAYER_USER, PIN_BRAKE_OUT);
     } else {
-      outputOff(PIN_BRAKE_OUT);
+      outputRequestOff(LAYER_USER, PIN_BRAKE_OUT);
     }
-    bike.brakeFlashState = false;
     if (bike.emergencyHazardActive) {
       bike.emergencyHazardActive = false;
       resolveHazardState();
@@ -351,86 +319,38 @@ void updateBrakeLight() {
     return;
   }
 
-  unsigned long now = millis();
-  unsigned long elapsed = now - bike.brakePressTime;
-
+  // Patterns restart from the press: the claim is lost while released
   switch (settings.brakeLightMode) {
-
-    case BRAKE_CONTINUOUS:
-      outputOn(PIN_BRAKE_OUT);
-      break;
-
-    // FIX #7: Real PWM fade using sine wave
-    case BRAKE_FADE: {
-      // 3Hz sine wave fade: period = 333ms
-      float phase = (float)(now % BRAKE_FADE_PERIOD_MS) / BRAKE_FADE_PERIOD_MS;
-      float sine = (sin(phase * 2.0f * PI) + 1.0f) / 2.0f;  // 0.0 – 1.0
-      uint8_t duty = 80 + (uint8_t)(sine * 175);  // 80-255 (never fully off)
-      outputPWM(PIN_BRAKE_OUT, duty);
+    case BRAKE_FADE:      // FIX #7: Real PWM fade (3Hz cosine table)
+      outputRequestPattern(LAYER_USER, PIN_BRAKE_OUT, PATTERN_BRAKE_FADE);
       break;
-    }
-
     case BRAKE_FLASH_5HZ:
-      if (now - bike.lastBrakeFlash >= BRAKE_FLASH_PERIOD_MS) {
-        bike.brakeFlashState = !bike.brakeFlashState;
-        bike.lastBrakeFlash = now;
-      }
-      if (bike.brakeFlashState) outputOn(PIN_BRAKE_OUT);
-      else                      outputOff(PIN_BRAKE_OUT);
+      outputRequestPattern(LAYER_USER, PIN_BRAKE_OUT, PATTERN_BRAKE_FLASH);
       break;
-
     case BRAKE_FLASH_8X:
-      if (elapsed < BRAKE_8X_DURATION_MS) {
-        if (now - bike.lastBrakeFlash >= BRAKE_FLASH_PERIOD_MS) {
-          bike.brakeFlashState = !bike.brakeFlashState;
-          bike.lastBrakeFlash = now;
-        }
-        if (bike.brakeFlashState) outputOn(PIN_BRAKE_OUT);
-        else                      outputOff(PIN_BRAKE_OUT);
-      } else {
-        outputOn(PIN_BRAKE_OUT);
-      }
+      outputRequestPattern(LAYER_USER, PIN_BRAKE_OUT, PATTERN_BRAKE_8X);
       break;
-
     case BRAKE_FLASH_2X:
-      if (elapsed < BRAKE_2X_DURATION_MS) {
-        if (now - bike.lastBrakeFlash >= BRAKE_FLASH_PERIOD_MS) {
-          bike.brakeFlashState = !bike.brakeFlashState;
-          bike.lastBrakeFlash = now;
-        }
-        if (bike.brakeFlashState) outputOn(PIN_BRAKE_OUT);
-        else                      outputOff(PIN_BRAKE_OUT);
-      } else {
-        outputOn(PIN_BRAKE_OUT);
-      }
+      outputRequestPattern(LAYER_USER, PIN_BRAKE_OUT, PATTERN_BRAKE_2X);
       break;
-
     case BRAKE_3S_FLASH:
-      if (elapsed < BRAKE_CONTINUOUS_DELAY_MS) {
-        outputOn(PIN_BRAKE_OUT);
-      } else {
-        if (now - bike.lastBrakeFlash >= BRAKE_FLASH_PERIOD_MS) {
-          bike.brakeFlashState = !bike.brakeFlashState;
-          bike.lastBrakeFlash = now;
-        }
-        if (bike.brakeFlashState) outputOn(PIN_BRAKE_OUT);
-        else                      outputOff(PIN_BRAKE_OUT);
-      }
+      outputRequestPattern(LAYER_USER, PIN_BRAKE_OUT, PATTERN_BRAKE_3S);
       break;
-
     case BRAKE_EMERGENCY:
       bike.emergencyHazardActive = true;
       resolveHazardState();
-      if (now - bike.lastBrakeFlash >= BRAKE_FLASH_PERIOD_MS) {
-        bike.brakeFlashState = !bike.brakeFlashState;
-        bike.lastBrakeFlash = now;
-      }
-      if (bike.brakeFlashState) outputOn(PIN_BRAKE_OUT);
-      else                      outputOff(PIN_BRAKE_OUT);
+      outputRequestPattern(LAYER_USER, PIN_BRAKE_OUT, PATTERN_BRAKE_FLASH);
       break;
-
+    case BRAKE_CUSTOM: {
+      // Continuous until a pattern has been uploaded
+      const LightPattern* custom = patternCustom(PATTERN_SLOT_BRAKE);
+      if (custom) outputRequestPattern(LAYER_USER, PIN_BRAKE_OUT, *custom);
+      else        outputRequestOn(LAYER_USER, PIN_BRAKE_OUT);
+      break;
+    }
+    case BRAKE_CONTINUOUS:
     default:
-      outputOn(PIN_BRAKE_OUT);
+      outputRequestOn(LAYER_USER, PIN_BRAKE_OUT);
       break;
   }
 }
@@ -439,9 +359,9 @@ void updateBrakeLight() {
 
 void updateHorn() {
   if (bike.hornPressed && bike.ignitionOn) {
-    outputOn(PIN_HORN_OUT);
+    outputRequestOn(LAYER_USER, PIN_HORN_OUT);
   } else {
-    outputOff(PIN_HORN_OUT);
+    outputRequestOff(LAYER_USER, PIN_HORN_OUT);
   }
 }
 
@@ -451,11 +371,11 @@ void updateHorn() {
 
 void updateStarter() {
   if (bike.starterEngaged && bike.ignitionOn && !bike.killActive) {
-    outputOn(PIN_START_OUT1);
-    outputOn(PIN_START_OUT2);
+    outputRequestOn(LAYER_USER, PIN_START_OUT1);
+    outputRequestOn(LAYER_USER, PIN_START_OUT2);
   } else {
-    outputOff(PIN_START_OUT1);
-    outputOff(PIN_START_OUT2);
+    outputRequestOff(LAYER_USER, PIN_START_OUT1);
+    outputRequestOff(LAYER_USER, PIN_START_OUT2);
   }
 }
 
@@ -465,6 +385,7 @@ void updateStarter() {
 //   1 = ON with engine running
 //   2 = Manual toggle (on/off via web UI)
 //   3 = Disabled (always off)
+// auxNPower > 0 drives an on output at that % of its 12V power (grips, vests)
 // --------------------------------------------------------------------------
 
 static bool auxShouldBeOn(uint8_t mode, bool manualOn) {
@@ -477,18 +398,15 @@ static bool auxShouldBeOn(uint8_t mode, bool manualOn) {
   }
 }
 
-void updateAuxOutputs() {
-  if (auxShouldBeOn(settings.aux1Mode, bike.aux1ManualOn)) {
-    outputOn(PIN_AUX1_OUT);
-  } else {
-    outputOff(PIN_AUX1_OUT);
-  }
+static void auxOutput(int pin, bool on, uint8_t powerPct) {
+  if (!on)           outputRequestOff(LAYER_USER, pin);
+  else if (powerPct) outputRequest(LAYER_USER, pin, dimPower(powerPct));
+  else               outputRequestOn(LAYER_USER, pin);
+}
 
-  if (auxShouldBeOn(settings.aux2Mode, bike.aux2ManualOn)) {
-    outputOn(PIN_AUX2_OUT);
-  } else {
-    outputOff(PIN_AUX2_OUT);
-  }
+void updateAuxOutputs() {
+  auxOutput(PIN_AUX1_OUT, auxShouldBeOn(settings.aux1Mode, bike.aux1ManualOn), settings.aux1Power);
+  auxOutput(PIN_AUX2_OUT, auxShouldBeOn(settings.aux2Mode, bike.aux2ManualOn), settings.aux2Power);
 }
 
 // --------------------------------------------------------------------------
@@ -501,24 +419,23 @@ void updateAuxOutputs() {
 // --------------------------------------------------------------------------
 
 void updateParkingLight() {
-  // Only active when ignition is OFF
-  if (bike.ignitionOn) return;
+  // Only active when ignition is OFF, and while the parked budget lasts
+  if (bike.ignitionOn || bike.parkCutoff) return;
 
   switch (settings.parkingLightMode) {
     case 1: {
       // Dim position light (~25%)
-      uint8_t duty = 64;
-      outputPWM(PIN_LIGHT_OUT, duty);
+      outputRequest(LAYER_PARKING, PIN_LIGHT_OUT, dimBrightness(DIM_PARKING_LEVEL));
       break;
     }
     case 2:
-      outputOn(PIN_TURNL_OUT);
+      outputRequestOn(LAYER_PARKING, PIN_TURNL_OUT);
       break;
     case 3:
-      outputOn(PIN_TURNR_OUT);
+      outputRequestOn(LAYER_PARKING, PIN_TURNR_OUT);
       break;
     default:
-      // Mode 0: nothing (outputs already off from safety)
+      // Mode 0: nothing claimed
       break;
   }
 }
@@ -530,6 +447,7 @@ void updateParkingLight() {
 //   ARMED → (vibration detected) → TRIGGERED (horn + lights for 30s)
 //   TRIGGERED → (30s elapsed) → ARMED (re-arm)
 //   Any state → (ignition on) → DISARMED
+//   ARMED → (parked battery floor, energy.cpp) → DISARMED until next ride
 // --------------------------------------------------------------------------
 
 void updateAlarm() {
@@ -539,67 +457,72 @@ void updateAlarm() {
     return;
   }
 
-  unsigned long now = millis();
+  TimeUs now = schedNow(SCHED_CONTROL);
 
   // Ignition turns off alarm
   if (bike.ignitionOn) {
     bike.alarmArmed     = false;
     bike.alarmTriggered = false;
-    bike.alarmTriggerTime = 0;
+    bike.alarmArmStart  = TIME_NONE;
+    return;
+  }
+
+  // Parked budget spent (energy.cpp): a running alarm finishes, no re-arm
+  if (bike.parkCutoff && !bike.alarmTriggered) {
+    if (bike.alarmArmed) LOG_W("Alarm: disarmed – parked battery floor reached");
+    bike.alarmArmed    = false;
+    bike.alarmArmStart = TIME_NONE;
     return;
   }
 
   // Alarm triggered → sound horn + flash lights for ALARM_DURATION_MS
   if (bike.alarmTriggered) {
-    unsigned long elapsed = now - bike.alarmTriggerTime;
-
-    if (elapsed >= ALARM_DURATION_MS) {
-      // Stop alarm, re-arm
+    TimeUs end = bike.alarmTriggerTime + usFromMs(ALARM_DURATION_MS);
+    if (now >= end) {
+      // Stop alarm, re-arm (outputs released to lower layers)
       bike.alarmTriggered = false;
-      outputOff(PIN_HORN_OUT);
-      outputOff(PIN_TURNL_OUT);
-      outputOff(PIN_TURNR_OUT);
       LOG_I("Alarm: timeout – re-armed");
       return;
     }
 
     // Flash turn signals + horn during alarm
-    bool flashState = ((now / 200) % 2) == 0;  // 5Hz flash
-    if (flashState) {
-      outputOn(PIN_TURNL_OUT);
-      outputOn(PIN_TURNR_OUT);
-      outputOn(PIN_HORN_OUT);
-    } else {
-      outputOff(PIN_TURNL_OUT);
-      outputOff(PIN_TURNR_OUT);
-      outputOff(PIN_HORN_OUT);
-    }
+    const LightPattern& alarm = patternOr(PATTERN_SLOT_ALARM, PATTERN_ALARM);
+    outputRequestPattern(LAYER_ALARM, PIN_TURNL_OUT, alarm);
+    outputRequestPattern(LAYER_ALARM, PIN_TURNR_OUT, alarm);
+    outputRequestPattern(LAYER_ALARM, PIN_HORN_OUT,  alarm);
+    controlWakeAt(end);
     return;
   }
 
   // Not yet armed → wait for arm delay after ignition off
   if (!bike.alarmArmed) {
-    // alarmTriggerTime doubles as arm-delay start when not triggered
-    if (bike.alarmTriggerTime == 0) {
-      bike.alarmTriggerTime = now;  // Start counting from now
+    if (!timeIsSet(bike.alarmArmStart)) {
+      bike.alarmArmStart = now;  // Start counting from now
     }
-    if (now - bike.alarmTriggerTime >= ALARM_ARM_DELAY_MS) {
-      bike.alarmArmed = true;
-      bike.alarmTriggerTime = 0;
+    if (timeElapsed(bike.alarmArmStart, usFromMs(ALARM_ARM_DELAY_MS), now)) {
+      bike.alarmArmed    = true;
+      bike.alarmArmStart = TIME_NONE;
       LOG_I("Alarm: armed");
+    } else {
+      controlWakeAt(bike.alarmArmStart + usFromMs(ALARM_ARM_DELAY_MS));
     }
     return;
   }
 
-  // Armed → check vibration sensor
-  if (now - bike.lastAlarmCheck >= ALARM_VIBRATION_DEBOUNCE_MS) {
+  // Armed → check vibration sensor (edges wake the loop; keep polling
+  // while the sensor is active so hits are counted)
+  const DurationUs debounce = usFromMs(ALARM_VIBRATION_DEBOUNCE_MS);
+  if (inputActive(PIN_VIBRATION) && timeIsSet(bike.lastAlarmCheck)) {
+    controlWakeAt(bike.lastAlarmCheck + debounce);
+  }
+  if (!timeIsSet(bike.lastAlarmCheck) || now - bike.lastAlarmCheck >= debounce) {
     bike.lastAlarmCheck = now;
 
     bool vibration = inputActive(PIN_VIBRATION);
     if (vibration) {
       // Count hits within window using static counters
       static uint8_t hitCount = 0;
-      static unsigned long firstHitTime = 0;
+      static TimeUs  firstHitTime = TIME_NONE;
 
       if (hitCount == 0) {
         firstHitTime = now;
@@ -608,7 +531,7 @@ void updateAlarm() {
       hitCount++;
 
       // Check if we exceeded the window
-      if (now - firstHitTime > ALARM_TRIGGER_WINDOW_MS) {
+      if (now - firstHitTime > usFromMs(ALARM_TRIGGER_WINDOW_MS)) {
         hitCount = 1;
         firstHitTime = now;
       }
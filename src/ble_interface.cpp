@@ -1,5 +1,10 @@
 #include "ble_interface.h"
 #include "settings_store.h"
+#include "control_loop.h"
+#include "scheduler.h"
+#include "battery_health.h"
+#include "dimming.h"
+#include "load_shed.h"
 #include <NimBLEDevice.h>
 #include <Preferences.h>
 
@@ -13,10 +18,12 @@ static NimBLECharacteristic* pCharVoltage  = nullptr;
 static NimBLECharacteristic* pCharSettings = nullptr;
 static NimBLECharacteristic* pCharErrors   = nullptr;
 static NimBLECharacteristic* pCharCommand  = nullptr;
+static NimBLECharacteristic* pCharPattern  = nullptr;
 
 static bool     newSettingsAvailable = false;
 static Settings pendingSettings;
-static unsigned long lastBleUpdate = 0;
+
+#define BLE_NOTIFY_INTERVAL_MS    200
 
 // ============================================================================
 // KEYLESS STATE
@@ -48,16 +55,23 @@ static struct {
   bool ignitionGranted    = false;
   bool engineWasRunning   = false;
   bool graceActive        = false;
-  unsigned long graceStart = 0;
-  unsigned long firstDetectTime = 0;
-  unsigned long lastDetectTime  = 0;
+  TimeUs        graceStart = 0;
+  SchedJob      graceJob   = SCHED_NONE;
+  TimeUs        firstDetectTime = TIME_NONE;
+  TimeUs        lastDetectTime  = 0;
 
   // Scanning
   bool         scanActive  = false;
   NimBLEScan*  pScan       = nullptr;
-  unsigned long lastScanTime = 0;
 } keyless;
 
+static void notifyState(TimeUs now);
+static void keylessScan(TimeUs now);
+static void keylessGraceExpired(TimeUs now);
+
+// Parked low-duty radio: advertising / scanning only inside windows
+static bool parkMode = false;
+
 static Preferences keylessPref;
 
 // ============================================================================
@@ -132,6 +146,7 @@ static bool macEquals(const uint8_t* a, const uint8_t* b) {
 class ServerCB : public NimBLEServerCallbacks {
   void onConnect(NimBLEServer*) override {
     bike.bleConnected = true;
+    controlWake();
     LOG_I("BLE GATT client connected");
   }
   void onDisconnect(NimBLEServer*) override {
@@ -146,10 +161,13 @@ class SettingsWriteCB : public NimBLECharacteristicCallbacks {
     std::string val = pChar->getValue();
     if (val.size() >= 14) {
       const uint8_t* d = (const uint8_t*)val.data();
+      // Fields the packet does not carry (watt table, battery, parking) keep
+      // their current values
+      pendingSettings = settings;
       pendingSettings.handlebarConfig = static_cast<HandlebarConfig>(constrain(d[0], CONFIG_A, CONFIG_E));
       pendingSettings.rearLightMode   = d[1];
       pendingSettings.turnSignalMode  = static_cast<TurnSignalMode>(constrain(d[2], TURN_OFF, TURN_30S));
-      pendingSettings.brakeLightMode  = static_cast<BrakeLightMode>(constrain(d[3], BRAKE_CONTINUOUS, BRAKE_EMERGENCY));
+      pendingSettings.brakeLightMode  = static_cast<BrakeLightMode>(constrain(d[3], BRAKE_CONTINUOUS, BRAKE_CUSTOM));
       pendingSettings.alarmMode       = d[4];
       pendingSettings.positionLight   = constrain(d[5], 0, 9);
       pendingSettings.moWaveEnabled   = d[6] != 0;
@@ -160,7 +178,23 @@ class SettingsWriteCB : public NimBLECharacteristicCallbacks {
       pendingSettings.parkingLightMode = d[11];
       pendingSettings.turnDistancePulsesTarget =
           constrain(d[12] | (d[13] << 8), TURN_DISTANCE_MIN_PULSES, TURN_DISTANCE_MAX_PULSES);
+      // Optional per-input debounce profile (bytes 14.., InputId order, ms)
+      if (val.size() >= 14 + INPUT_COUNT) {
+        memcpy(pendingSettings.debounceMs, d + 14, INPUT_COUNT);
+      }
+      // Optional alternator pole pairs (byte after the debounce profile)
+      if (val.size() >= 15 + INPUT_COUNT) {
+        pendingSettings.polePairs = constrain(d[14 + INPUT_COUNT], 1, RPM_POLE_PAIRS_MAX);
+      }
+      // Optional AUX constant-power % (0 = switched)
+      if (val.size() >= 16 + INPUT_COUNT) pendingSettings.aux1Power = auxPowerClamp(d[15 + INPUT_COUNT]);
+      if (val.size() >= 17 + INPUT_COUNT) pendingSettings.aux2Power = auxPowerClamp(d[16 + INPUT_COUNT]);
+      // Optional load-shedding tier per output (OUTPUT_PINS order)
+      for (int i = 0; i < OUTPUT_PIN_COUNT && val.size() >= 18 + INPUT_COUNT + (size_t)i; i++) {
+        pendingSettings.shedTier[i] = loadShedTierClamp(i, d[17 + INPUT_COUNT + i]);
+      }
       newSettingsAvailable = true;
+      controlWake();
       LOG_I("BLE: settings received");
     }
   }
@@ -172,6 +206,33 @@ class CommandCB : public NimBLECharacteristicCallbacks {
     if (val.empty()) return;
     if (val[0] == 0x01) esp_restart();
     if (val[0] == 0x02) { bike.errorFlags = ERR_NONE; LOG_I("BLE: errors cleared"); }
+    if (val[0] == 0x03) batteryHealthReset();
+    controlWake();
+  }
+};
+
+// Custom light pattern: [slot, (ms lo, ms hi, duty, repeat) × n], n ≤ 16.
+// Only the slot byte clears the slot (back to the built-in pattern).
+class PatternWriteCB : public NimBLECharacteristicCallbacks {
+  void onWrite(NimBLECharacteristic* pChar) override {
+    std::string val = pChar->getValue();
+    if (val.empty() || (val.size() - 1) % 4 != 0) return;
+    const uint8_t* d = (const uint8_t*)val.data();
+    size_t n = (val.size() - 1) / 4;
+    if (d[0] >= PATTERN_SLOT_COUNT || n > PATTERN_MAX_SEGS) return;
+
+    PatternSeg seg[PATTERN_MAX_SEGS];
+    for (size_t i = 0; i < n; i++) {
+      const uint8_t* s = d + 1 + i * 4;
+      seg[i].ms     = s[0] | (s[1] << 8);
+      seg[i].duty   = s[2];
+      seg[i].repeat = s[3];
+    }
+    PatternSlot slot = (PatternSlot)d[0];
+    if (patternSetCustom(slot, seg, n)) {
+      requestSaveCustomPattern(slot);
+      controlWake();
+    }
   }
 };
 
@@ -267,6 +328,9 @@ void bleInit() {
   pCharCommand  = svc->createCharacteristic(BLE_CHAR_COMMAND_UUID,
       NIMBLE_PROPERTY::WRITE);
   pCharCommand->setCallbacks(new CommandCB());
+  pCharPattern  = svc->createCharacteristic(BLE_CHAR_PATTERN_UUID,
+      NIMBLE_PROPERTY::WRITE);
+  pCharPattern->setCallbacks(new PatternWriteCB());
   svc->start();
 
   NimBLEAdvertising* adv = NimBLEDevice::getAdvertising();
@@ -284,28 +348,29 @@ void bleInit() {
   // Load keyless config
   loadKeylessConfig();
 
+  schedEvery(SCHED_COMMS, "ble_state", BLE_NOTIFY_INTERVAL_MS, notifyState, SCHED_SHEDDABLE);
+  schedEvery(SCHED_COMMS, "kl_scan", KEYLESS_SCAN_INTERVAL_MS, keylessScan);
+  keyless.graceJob = schedOneShot(SCHED_COMMS, "kl_grace", keylessGraceExpired);
+
   LOG_I("BLE initialized: %s", BLE_DEVICE_NAME);
 }
 
 // ============================================================================
-// PUBLIC: GATT UPDATE
+// GATT STATE NOTIFY (comms job, every BLE_NOTIFY_INTERVAL_MS)
 // ============================================================================
 
-void bleUpdate() {
-  unsigned long now = millis();
-  if (now - lastBleUpdate < 200) return;
-  lastBleUpdate = now;
-
+static void notifyState(TimeUs) {
   if (!bike.bleConnected) return;
 
   // Pack state
-  uint8_t buf[8] = {};
+  uint8_t buf[11] = {};
   buf[0] = (bike.ignitionOn ? 0x01 : 0)
           | (bike.engineRunning ? 0x02 : 0)
           | (bike.starterEngaged ? 0x04 : 0)
           | (bike.killActive ? 0x08 : 0)
           | (bike.standDown ? 0x10 : 0)
-          | (bike.lowVoltageWarning ? 0x20 : 0);
+          | (bike.lowVoltageWarning ? 0x20 : 0)
+          | (bike.batteryWorn ? 0x40 : 0);
   buf[1] = (bike.lowBeamOn ? 0x01 : 0)
           | (bike.highBeamOn ? 0x02 : 0)
           | (bike.leftTurnOn ? 0x04 : 0)
@@ -317,6 +382,12 @@ void bleUpdate() {
   buf[2] = vBat & 0xFF;
   buf[3] = (vBat >> 8) & 0xFF;
   buf[4] = bike.errorFlags;
+  buf[5] = bike.engineRpm & 0xFF;                      // RPM_UNKNOWN = 0xFFFF
+  buf[6] = (bike.engineRpm >> 8) & 0xFF;
+  buf[7] = bike.batterySoh;
+  buf[8] = bike.lampFaults;
+  buf[9] = bike.shedMask & 0xFF;
+  buf[10] = (bike.shedMask >> 8) & 0xFF;
 
   pCharState->setValue(buf, sizeof(buf));
   pCharState->notify();
@@ -325,8 +396,9 @@ void bleUpdate() {
   snprintf(vStr, sizeof(vStr), "%.1f", bike.batteryVoltage);
   pCharVoltage->setValue(vStr);
 
-  if (bike.errorFlags != ERR_NONE) {
-    pCharErrors->setValue(&bike.errorFlags, 1);
+  if (bike.errorFlags != ERR_NONE || bike.lampFaults) {
+    uint8_t errs[2] = { bike.errorFlags, bike.lampFaults };
+    pCharErrors->setValue(errs, sizeof(errs));
     pCharErrors->notify();
   }
 }
@@ -355,16 +427,7 @@ void bleKeylessUpdate() {
     return;
   }
 
-  unsigned long now = millis();
-
-  // Periodic background scan for paired devices
-  if (now - keyless.lastScanTime >= KEYLESS_SCAN_INTERVAL_MS) {
-    keyless.lastScanTime = now;
-    // Short scan burst (non-blocking)
-    if (!keyless.pScan->isScanning()) {
-      keyless.pScan->start(1, onScanComplete, false);  // 1 second, non-blocking
-    }
-  }
+  TimeUs now = schedNow(SCHED_COMMS);
 
   // Check if any paired device is in range
   bool anyDetected = false;
@@ -379,26 +442,27 @@ void bleKeylessUpdate() {
 
   if (anyDetected && !keyless.phoneDetected) {
     // First detection → start hold timer
-    if (keyless.firstDetectTime == 0) {
+    if (!timeIsSet(keyless.firstDetectTime)) {
       keyless.firstDetectTime = now;
     }
     // Must be detected for KEYLESS_DETECT_HOLD_MS continuously
-    if (now - keyless.firstDetectTime >= KEYLESS_DETECT_HOLD_MS) {
+    if (timeElapsed(keyless.firstDetectTime, usFromMs(KEYLESS_DETECT_HOLD_MS), now)) {
       keyless.phoneDetected = true;
       keyless.lastDetectTime = now;
       keyless.ignitionGranted = true;
       keyless.graceActive = false;
+      schedCancel(keyless.graceJob);
       LOG_I("Keyless: phone detected – ignition granted");
     }
   } else if (anyDetected) {
     keyless.lastDetectTime = now;
     keyless.firstDetectTime = now;  // Keep resetting
   } else {
-    keyless.firstDetectTime = 0;
+    keyless.firstDetectTime = TIME_NONE;
 
     // Phone lost
     if (keyless.phoneDetected) {
-      if (now - keyless.lastDetectTime >= KEYLESS_LOST_TIMEOUT_MS) {
+      if (now - keyless.lastDetectTime >= usFromMs(KEYLESS_LOST_TIMEOUT_MS)) {
         keyless.phoneDetected = false;
         // If engine was never running, lock immediately
         if (!keyless.engineWasRunning) {
@@ -415,21 +479,12 @@ void bleKeylessUpdate() {
     keyless.engineWasRunning = true;
   }
 
-  // Grace period countdown
-  if (keyless.graceActive) {
-    unsigned long graceMs = (unsigned long)keyless.graceSeconds * 1000UL;
-    if (now - keyless.graceStart >= graceMs) {
-      keyless.graceActive = false;
-      keyless.ignitionGranted = false;
-      keyless.engineWasRunning = false;
-      LOG_I("Keyless: grace period expired – locked");
-    }
-    // If engine restarts during grace, cancel grace
-    if (bike.engineRunning) {
-      keyless.graceActive = false;
-      keyless.engineWasRunning = true;
-      LOG_I("Keyless: engine restarted during grace");
-    }
+  // If engine restarts during grace, cancel grace
+  if (keyless.graceActive && bike.engineRunning) {
+    keyless.graceActive = false;
+    keyless.engineWasRunning = true;
+    schedCancel(keyless.graceJob);
+    LOG_I("Keyless: engine restarted during grace");
   }
 
   // Clear device detection flags for next scan cycle
@@ -441,6 +496,66 @@ void bleKeylessUpdate() {
   }
 }
 
+// Periodic background scan for paired devices (comms job)
+static void keylessScan(TimeUs) {
+  if (!keyless.enabled || keyless.pairedCount == 0 || parkMode) return;
+  // Short scan burst (non-blocking)
+  if (!keyless.pScan->isScanning()) {
+    keyless.pScan->start(1, onScanComplete, false);  // 1 second, non-blocking
+  }
+}
+
+// Grace period deadline (one-shot, armed by bleKeylessEngineOff)
+static void keylessGraceExpired(TimeUs) {
+  if (!keyless.graceActive) return;
+  keyless.graceActive = false;
+  keyless.ignitionGranted = false;
+  keyless.engineWasRunning = false;
+  LOG_I("Keyless: grace period expired – locked");
+}
+
+bool bleKeylessScanning() {
+  return keyless.pScan && keyless.pScan->isScanning();
+}
+
+bool bleKeylessBusy() {
+  return keyless.phoneDetected || keyless.ignitionGranted || keyless.graceActive ||
+         keyless.scanActive || timeIsSet(keyless.firstDetectTime);
+}
+
+// ============================================================================
+// PARKED LOW-DUTY RADIO
+// Advertising slows to PARK_ADV_INTERVAL_MS and, like the keyless scan,
+// only runs while the power mode holds a window open; the controller is
+// idle in between so the chip can light-sleep.
+// ============================================================================
+
+void bleParkMode(bool enable) {
+  if (enable == parkMode) return;
+  parkMode = enable;
+  NimBLEAdvertising* adv = NimBLEDevice::getAdvertising();
+  adv->stop();
+  if (keyless.pScan->isScanning() && !keyless.scanActive) keyless.pScan->stop();
+  // 0.625 ms units; 0 = stack default (fast advertising)
+  uint16_t itvl = enable ? (uint16_t)(PARK_ADV_INTERVAL_MS * 8 / 5) : 0;
+  adv->setMinInterval(itvl);
+  adv->setMaxInterval(itvl);
+  if (!enable) adv->start();
+}
+
+void bleParkWindow(bool open) {
+  if (!parkMode) return;
+  NimBLEAdvertising* adv = NimBLEDevice::getAdvertising();
+  if (open) {
+    adv->start();
+    if (keyless.enabled && keyless.pairedCount > 0 && !keyless.pScan->isScanning()) {
+      keyless.pScan->start(1, onScanComplete, false);
+    }
+  } else {
+    adv->stop();
+  }
+}
+
 bool bleKeylessIgnitionAllowed() {
   return keyless.ignitionGranted;
 }
@@ -452,7 +567,8 @@ void bleKeylessEngineOff() {
   // Engine was running and now stopped → start grace period
   if (!keyless.graceActive && !keyless.phoneDetected) {
     keyless.graceActive = true;
-    keyless.graceStart = millis();
+    keyless.graceStart = schedNow(SCHED_COMMS);
+    schedArm(keyless.graceJob, (uint32_t)keyless.graceSeconds * 1000UL);
     LOG_I("Keyless: engine off – %ds grace period", keyless.graceSeconds);
   }
 }
@@ -552,9 +668,9 @@ void bleKeylessBuildJson(JsonDocument& doc) {
   doc["graceActive"] = keyless.graceActive;
 
   if (keyless.graceActive) {
-    unsigned long elapsed = millis() - keyless.graceStart;
-    unsigned long totalMs = (unsigned long)keyless.graceSeconds * 1000UL;
-    int remaining = (int)((totalMs - min(elapsed, totalMs)) / 1000UL);
+    DurationUs elapsed = schedNow(SCHED_COMMS) - keyless.graceStart;
+    DurationUs total   = usFromSec(keyless.graceSeconds);
+    int remaining = (int)((total - min(elapsed, total)) / usFromSec(1));
     doc["graceRemaining"] = remaining;
   }
 
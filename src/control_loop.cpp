@@ -0,0 +1,203 @@
+#include "control_loop.h"
+#include "safety.h"
+#include "scheduler.h"
+#include "power_mode.h"
+#include <esp_timer.h>
+
+#if CONFIG_FREERTOS_HZ != 1000
+#error "Fixed-rate control tick assumes a 1 kHz FreeRTOS tick"
+#endif
+
+static TaskHandle_t      controlTask     = nullptr;
+static TaskHandle_t      commsTask       = nullptr;
+static TimeUs            nextDeadline    = 0;
+static bool              fixedRate       = true;
+
+// Latency probe: time of the first input edge not yet reflected in outputs
+static volatile int64_t  pendingEdgeUs   = 0;
+static int64_t           wokenEdgeUs     = 0;
+
+static struct {
+  uint32_t wakeups       = 0;
+  uint32_t edgeWakes     = 0;
+  uint32_t commandWakes  = 0;
+  uint32_t deadlineWakes = 0;
+  uint32_t sleepWakes    = 0;   // Light sleep (parked power mode)
+  uint32_t lastLatencyUs = 0;   // Edge → outputs written
+  uint32_t maxLatencyUs  = 0;
+  uint32_t avgLatencyUs  = 0;   // EWMA, 1/8 weight
+  uint32_t ticks         = 0;   // Fixed-rate ticks
+  uint32_t overruns      = 0;   // Tick started a full period late
+  uint32_t jitterMaxUs   = 0;   // |actual − scheduled| start
+  uint32_t jitterAvgUs   = 0;   // EWMA, 1/8 weight
+  uint32_t execLastUs    = 0;
+  uint32_t execMaxUs     = 0;   // Worst-case execution time per tick
+  uint32_t execAvgUs     = 0;   // EWMA, 1/8 weight
+} stats;
+
+static volatile bool commandPending = false;
+
+void IRAM_ATTR controlWakeFromISR() {
+  if (pendingEdgeUs == 0) pendingEdgeUs = esp_timer_get_time();
+  if (!controlTask) return;
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(controlTask, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+void controlWake() {
+  commandPending = true;
+  if (controlTask) xTaskNotifyGive(controlTask);
+}
+
+void controlWakeAt(TimeUs deadline) {
+  if (deadline < nextDeadline) nextDeadline = deadline;
+}
+
+void controlSetFixedRate(bool enable) {
+  fixedRate = enable;
+}
+
+void controlOutputsWritten() {
+  if (pendingEdgeUs != 0 && wokenEdgeUs == 0) {
+    // Fixed-rate ticks do not go through the event wait
+    wokenEdgeUs   = pendingEdgeUs;
+    pendingEdgeUs = 0;
+  }
+  if (wokenEdgeUs == 0) return;
+  uint32_t lat = (uint32_t)(esp_timer_get_time() - wokenEdgeUs);
+  wokenEdgeUs = 0;
+  stats.lastLatencyUs = lat;
+  if (lat > stats.maxLatencyUs) stats.maxLatencyUs = lat;
+  stats.avgLatencyUs += ((int32_t)lat - (int32_t)stats.avgLatencyUs) / 8;
+}
+
+// Sleep until the next event, then reset the deadline for the next pass
+static void waitForEvent() {
+  // Parked and nothing pending: light-sleep the chip instead of idling
+  uint32_t notified = ulTaskNotifyTake(pdTRUE, 0);
+  if (!notified && pendingEdgeUs == 0 && powerSleepUntil(nextDeadline)) {
+    stats.wakeups++;
+    stats.sleepWakes++;
+    commandPending = false;
+    return;
+  }
+
+  // Round up: waking a tick early would only re-arm the same deadline
+  DurationUs wait = nextDeadline - timeNow();
+  int64_t waitMs = wait > 0 ? msFromUs(wait + 999) : 0;
+
+  // Always block at least one tick so lower-priority tasks get CPU time
+  TickType_t ticks = pdMS_TO_TICKS(waitMs);
+  if (ticks == 0) ticks = 1;
+
+  if (!notified) notified = ulTaskNotifyTake(pdTRUE, ticks);
+
+  stats.wakeups++;
+  if (pendingEdgeUs != 0) {
+    wokenEdgeUs   = pendingEdgeUs;
+    pendingEdgeUs = 0;
+    stats.edgeWakes++;
+  } else if (notified && commandPending) {
+    stats.commandWakes++;
+  } else {
+    stats.deadlineWakes++;
+  }
+  commandPending = false;
+}
+
+static void recordTick(bool onSchedule, int64_t startUs, int64_t scheduledUs) {
+  uint32_t exec = (uint32_t)(esp_timer_get_time() - startUs);
+  stats.execLastUs = exec;
+  if (exec > stats.execMaxUs) stats.execMaxUs = exec;
+  stats.execAvgUs += ((int32_t)exec - (int32_t)stats.execAvgUs) / 8;
+
+  if (!onSchedule) return;
+  stats.ticks++;
+  int64_t d = startUs - scheduledUs;
+  uint32_t jitter = (uint32_t)(d < 0 ? -d : d);
+  if (jitter > stats.jitterMaxUs) stats.jitterMaxUs = jitter;
+  stats.jitterAvgUs += ((int32_t)jitter - (int32_t)stats.jitterAvgUs) / 8;
+}
+
+static void controlTaskMain(void* arg) {
+  void (*tick)() = reinterpret_cast<void (*)()>(arg);
+  safetyWatchCurrentTask();
+
+  TickType_t lastWake    = xTaskGetTickCount();
+  int64_t    scheduledUs = esp_timer_get_time();
+  bool       onSchedule  = false;   // Previous wait was a fixed-rate delay
+
+  for (;;) {
+    int64_t startUs = esp_timer_get_time();
+    nextDeadline = timeNow() + usFromMs(CONTROL_MAX_SLEEP_MS);
+    tick();
+    recordTick(onSchedule, startUs, scheduledUs);
+
+    if (fixedRate) {
+      if (!onSchedule) {
+        // (Re)enter fixed-rate mode: schedule from now
+        lastWake    = xTaskGetTickCount();
+        scheduledUs = startUs;
+      }
+      scheduledUs += CONTROL_PERIOD_US;
+      vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(CONTROL_PERIOD_US / 1000));
+      if (esp_timer_get_time() - scheduledUs >= CONTROL_PERIOD_US) {
+        // A full period lost (long tick or preemption): resync, don't burst
+        stats.overruns++;
+        lastWake    = xTaskGetTickCount();
+        scheduledUs = esp_timer_get_time();
+      }
+      onSchedule = true;
+    } else {
+      waitForEvent();
+      onSchedule = false;
+    }
+  }
+}
+
+static void commsTaskMain(void* arg) {
+  void (*tick)() = reinterpret_cast<void (*)()>(arg);
+  safetyWatchCurrentTask();
+  TickType_t lastWake = xTaskGetTickCount();
+  for (;;) {
+    safetyFeedWatchdog();
+    tick();
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(COMMS_PERIOD_MS));
+  }
+}
+
+void controlTasksStart(void (*controlTick)(), void (*commsTick)()) {
+  schedSetBudget(SCHED_CONTROL, CONTROL_BUDGET_US);
+  schedSetBudget(SCHED_COMMS, COMMS_BUDGET_US);
+  xTaskCreatePinnedToCore(controlTaskMain, "control", CONTROL_TASK_STACK,
+                          reinterpret_cast<void*>(controlTick),
+                          CONTROL_TASK_PRIORITY, &controlTask, CONTROL_TASK_CORE);
+  xTaskCreatePinnedToCore(commsTaskMain, "comms", COMMS_TASK_STACK,
+                          reinterpret_cast<void*>(commsTick),
+                          COMMS_TASK_PRIORITY, &commsTask, COMMS_TASK_CORE);
+  LOG_I("Control task: core %d, %d us period; comms task: core %d",
+        CONTROL_TASK_CORE, CONTROL_PERIOD_US, COMMS_TASK_CORE);
+}
+
+void controlBuildMetricsJson(JsonDocument& doc) {
+  JsonObject loop = doc["loop"].to<JsonObject>();
+  loop["uptimeMs"]      = millis();
+  loop["fixedRate"]     = fixedRate;
+  loop["periodUs"]      = CONTROL_PERIOD_US;
+  loop["ticks"]         = stats.ticks;
+  loop["overruns"]      = stats.overruns;
+  loop["jitterMaxUs"]   = stats.jitterMaxUs;
+  loop["jitterAvgUs"]   = stats.jitterAvgUs;
+  loop["execUs"]        = stats.execLastUs;
+  loop["execMaxUs"]     = stats.execMaxUs;
+  loop["execAvgUs"]     = stats.execAvgUs;
+  loop["wakeups"]       = stats.wakeups;
+  loop["edgeWakes"]     = stats.edgeWakes;
+  loop["commandWakes"]  = stats.commandWakes;
+  loop["deadlineWakes"] = stats.deadlineWakes;
+  loop["sleepWakes"]    = stats.sleepWakes;
+  loop["latencyUs"]     = stats.lastLatencyUs;
+  loop["latencyMaxUs"]  = stats.maxLatencyUs;
+  loop["latencyAvgUs"]  = stats.avgLatencyUs;
+}
@@ -0,0 +1,134 @@
+#include "crank_monitor.h"
+#include "battery_adc.h"
+
+enum CrankPhase : uint8_t { CRANK_IDLE, CRANK_INRUSH, CRANK_CRANKING, CRANK_DONE };
+
+static CrankPhase phase = CRANK_IDLE;
+static CrankStats last;
+static int32_t    restMv = 0;
+static int64_t    plateauSum = 0;
+static uint16_t   plateauBlocks = 0;
+static uint8_t    recovered = 0;
+static DurationUs firstRecovered = 0;
+static bool       caughtPending = false;
+static uint32_t   cranks = 0, catches = 0;
+
+static CrankStats   finished;
+static bool         finishedPending = false;
+static portMUX_TYPE crankMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void finish(TimeUs now) {
+  last.durationMs = (uint32_t)msFromUs(now - bike.starterStartTime);
+  portENTER_CRITICAL(&crankMux);
+  finished        = last;
+  finishedPending = true;
+  portEXIT_CRITICAL(&crankMux);
+  if (last.signature && !last.catchMs) {
+    LOG_I("Crank: %lu ms, no catch (rest %.2fV, crank %.2fV)", (unsigned long)last.durationMs,
+          last.restMv / 1000.0f, last.plateauMv / 1000.0f);
+  }
+  phase = CRANK_IDLE;
+}
+
+static void onBlock(TimeUs now, int32_t meanMv, int32_t, int32_t) {
+  if (!bike.starterEngaged) {
+    if (phase != CRANK_IDLE) finish(now);
+    restMv = restMv ? restMv + ((meanMv - restMv) >> 2) : meanMv;
+    return;
+  }
+
+  DurationUs t = now - bike.starterStartTime;
+  if (phase != CRANK_IDLE && last.blocks < CRANK_PROFILE_BLOCKS) {
+    last.profileMv[last.blocks++] = (uint16_t)meanMv;
+  }
+  switch (phase) {
+    case CRANK_IDLE:
+      last          = CrankStats();
+      last.restMv   = restMv;
+      last.dipMv    = meanMv;
+      plateauSum    = 0;
+      plateauBlocks = 0;
+      recovered     = 0;
+      caughtPending = false;
+      cranks++;
+      last.profileMv[last.blocks++] = (uint16_t)meanMv;
+      phase = CRANK_INRUSH;
+      // fall through
+    case CRANK_INRUSH:
+      if (meanMv < last.dipMv) last.dipMv = meanMv;
+      if (t < usFromMs(CRANK_SETTLE_MS)) break;
+      if (last.restMv - last.dipMv < CRANK_DIP_MIN_MV) {
+        LOG_W("Crank: no voltage sag – starter on button / timeout");
+        phase = CRANK_DONE;
+        break;
+      }
+      last.signature = true;
+      phase = CRANK_CRANKING;
+      // fall through
+    case CRANK_CRANKING: {
+      int32_t plateau = plateauBlocks ? (int32_t)(plateauSum / plateauBlocks) : meanMv;
+      int32_t target  = plateau + (last.restMv - plateau) * CRANK_RECOVER_PCT / 100;
+      if (t >= usFromMs(CRANK_MIN_MS) && plateauBlocks && meanMv >= target) {
+        if (recovered++ == 0) firstRecovered = t;
+        if (recovered >= CRANK_CATCH_BLOCKS) {
+          last.plateauMv = plateau;
+          last.catchMs   = (uint32_t)msFromUs(firstRecovered);
+          caughtPending  = true;
+          catches++;
+          phase = CRANK_DONE;
+          LOG_I("Engine caught after %lu ms (rest %.2fV, dip %.2fV, crank %.2fV) – starter cut",
+                (unsigned long)last.catchMs, last.restMv / 1000.0f, last.dipMv / 1000.0f,
+                plateau / 1000.0f);
+        }
+      } else {
+        recovered = 0;
+        plateauSum += meanMv;
+        plateauBlocks++;
+        last.plateauMv = (int32_t)(plateauSum / plateauBlocks);
+      }
+      break;
+    }
+    case CRANK_DONE:
+      break;
+  }
+}
+
+void crankMonitorInit() {
+  batteryAdcOnBlock(onBlock);
+}
+
+bool crankMonitorTracking() {
+  if (!batteryAdcCaptureAvailable()) return false;   // Polled fallback
+  return phase == CRANK_INRUSH || phase == CRANK_CRANKING ||
+         (phase == CRANK_DONE && last.signature);
+}
+
+bool crankMonitorCaught() {
+  bool c = caughtPending;
+  caughtPending = false;
+  return c;
+}
+
+const CrankStats& crankMonitorLast() {
+  return last;
+}
+
+bool crankMonitorTakeFinished(CrankStats& out) {
+  portENTER_CRITICAL(&crankMux);
+  bool ok = finishedPending;
+  if (ok) out = finished;
+  finishedPending = false;
+  portEXIT_CRITICAL(&crankMux);
+  return ok;
+}
+
+void crankMonitorBuildMetricsJson(JsonDocument& doc) {
+  JsonObject c = doc["crank"].to<JsonObject>();
+  c["cranks"]     = cranks;
+  c["catches"]    = catches;
+  c["restMv"]     = last.restMv;
+  c["dipMv"]      = last.dipMv;
+  c["plateauMv"]  = last.plateauMv;
+  c["durationMs"] = last.durationMs;
+  c["catchMs"]    = last.catchMs;
+}
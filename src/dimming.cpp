@@ -0,0 +1,47 @@
+#include "dimming.h"
+
+// 65535 × (level / 255)^2.2 at level = 8·i (i = 32 is past full scale)
+static const uint16_t GAMMA_LUT[33] = {
+      0,    32,   148,   362,   681,  1113,  1663,  2334,  3131,  4057,  5115,
+   6309,  7640,  9111, 10724, 12482, 14386, 16439, 18642, 20996, 23504, 26168,
+  28988, 31966, 35103, 38402, 41862, 45487, 49275, 53230, 57352, 61642, 65535,
+};
+
+static uint16_t factorQ12 = 4096;
+static int32_t  factorMv  = 0;      // Voltage the factor was computed for
+
+void dimmingUpdate() {
+  int32_t mv = (int32_t)(bike.batteryVoltage * 1000.0f);
+  if (factorMv && abs(mv - factorMv) < DIM_HYST_MV) return;   // Duty steps only on real moves
+  factorMv = mv;
+  if (mv <= DIM_NOMINAL_MV) {
+    factorQ12 = 4096;
+    return;
+  }
+  uint64_t nom = (uint64_t)DIM_NOMINAL_MV * DIM_NOMINAL_MV;
+  factorQ12 = (uint16_t)((nom << 12) / ((uint64_t)mv * mv));
+}
+
+// duty256 = duty × 256 at nominal voltage
+static uint8_t compensate(uint32_t duty256) {
+  uint32_t d = (duty256 * factorQ12 + (1u << 19)) >> 20;
+  if (d == 0 && duty256) d = 1;                             // Dim, but never dark
+  return (uint8_t)min(d, (uint32_t)255);
+}
+
+uint8_t dimBrightness(uint8_t level) {
+  if (!level) return 0;
+  uint8_t i = level >> 3, f = level & 7;
+  uint32_t lin = level == 255 ? 65535
+               : GAMMA_LUT[i] + (((uint32_t)(GAMMA_LUT[i + 1] - GAMMA_LUT[i]) * f) >> 3);
+  return compensate(lin - (lin >> 8));                      // 65535 → 255 × 256
+}
+
+uint8_t dimPower(uint8_t pct) {
+  if (!pct) return 0;
+  return compensate((uint32_t)min(pct, (uint8_t)100) * 255 * 256 / 100);
+}
+
+uint16_t dimmingFactorQ12() {
+  return factorQ12;
+}
@@ -0,0 +1,176 @@
+#include "energy.h"
+#include "outputs.h"
+#include "scheduler.h"
+#include "ble_interface.h"
+#include "web_server.h"
+#include "power_mode.h"
+
+static constexpr uint8_t SOC_UNKNOWN = 0xFF;
+
+struct Account {
+  uint64_t outMaUs[OUTPUT_PIN_COUNT];  // mA·µs per output
+  uint32_t outOnMs[OUTPUT_PIN_COUNT];  // Time with duty > 0
+  uint64_t baseMaUs, wifiMaUs, bleMaUs;
+  uint32_t wifiMs, bleMs, sleepMs;
+  uint32_t durationMs;
+};
+
+static Account      parked, ride;
+static portMUX_TYPE energyMux = portMUX_INITIALIZER_UNLOCKED;
+static TimeUs       lastSample = TIME_NONE;
+static uint64_t     lastSleptUs = 0;
+static bool         wasOn      = false;
+static TimeUs       parkStart  = 0;
+static uint8_t      soc0       = SOC_UNKNOWN;  // % at parking (rest voltage)
+static float        soc0UsedMah = 0.0f;        // Parked draw before the rest reading
+
+static float mahOf(uint64_t maUs) {
+  return maUs / 3.6e9f;
+}
+
+static float totalMah(const Account& a) {
+  uint64_t sum = a.baseMaUs + a.wifiMaUs + a.bleMaUs;
+  for (int i = 0; i < OUTPUT_PIN_COUNT; i++) sum += a.outMaUs[i];
+  return mahOf(sum);
+}
+
+// ============================================================================
+// PARKED BUDGET
+// ============================================================================
+
+static float remainingMah() {
+  if (soc0 == SOC_UNKNOWN) return -1.0f;
+  return soc0 * settings.batteryAh * 10.0f - (totalMah(parked) - soc0UsedMah);
+}
+
+static void checkBudget(TimeUs now) {
+  if (soc0 == SOC_UNKNOWN && now - parkStart >= usFromMs(ENERGY_SOC_SETTLE_MS)) {
+    int32_t mv = (int32_t)(bike.batteryVoltage * 1000.0f);
+    soc0 = (uint8_t)constrain((mv - ENERGY_SOC_EMPTY_MV) * 100 / (ENERGY_SOC_FULL_MV - ENERGY_SOC_EMPTY_MV),
+                              0, 100);
+    soc0UsedMah = totalMah(parked);
+    LOG_I("Parked: rest %.2fV → %u%% of %u Ah", mv / 1000.0f, soc0, settings.batteryAh);
+  }
+  if (soc0 == SOC_UNKNOWN || !settings.parkFloorPct || bike.parkCutoff) return;
+
+  float floorMah = settings.parkFloorPct * settings.batteryAh * 10.0f;
+  float left = remainingMah();
+  if (left < floorMah) {
+    bike.parkCutoff = true;
+    LOG_W("Parked drain: %.0f mAh used, ~%.0f mAh left < floor %u%% – parking light / alarm off",
+          totalMah(parked), left, settings.parkFloorPct);
+  }
+}
+
+// ============================================================================
+// SAMPLING JOB
+// ============================================================================
+
+// dtUs of which sleepUs in light sleep (controller at ENERGY_SLEEP_MA)
+static void add(Account& a, const uint8_t* duty, bool wifi, bool ble, uint32_t dtUs,
+                uint32_t sleepUs) {
+  uint32_t dtMs = dtUs / 1000;
+  for (int i = 0; i < OUTPUT_PIN_COUNT; i++) {
+    if (!duty[i]) continue;
+    a.outMaUs[i] += (uint64_t)duty[i] * settings.outputWatts[i] * dtUs * 1000000ULL
+                    / (255ULL * ENERGY_NOMINAL_MV);
+    a.outOnMs[i] += dtMs;
+  }
+  a.baseMaUs += (uint64_t)ENERGY_BASE_MA * (dtUs - sleepUs) + (uint64_t)ENERGY_SLEEP_MA * sleepUs;
+  a.sleepMs  += sleepUs / 1000;
+  if (wifi) { a.wifiMaUs += (uint64_t)ENERGY_WIFI_AP_MA * dtUs; a.wifiMs += dtMs; }
+  if (ble)  { a.bleMaUs  += (uint64_t)ENERGY_BLE_SCAN_MA * dtUs; a.bleMs  += dtMs; }
+  a.durationMs += dtMs;
+}
+
+static void energyJob(TimeUs now) {
+  bool on = bike.ignitionOn;
+  if (on != wasOn) {
+    wasOn = on;
+    portENTER_CRITICAL(&energyMux);
+    if (on) ride = Account();
+    else    parked = Account();
+    portEXIT_CRITICAL(&energyMux);
+    if (on) {
+      bike.parkCutoff = false;
+    } else {
+      parkStart = now;
+      soc0 = SOC_UNKNOWN;
+    }
+  }
+
+  // The comms task is stopped while the chip light-sleeps: a sample can
+  // span a whole parked cycle, mostly asleep
+  uint64_t slept = powerSleptUs();
+  if (lastSample != TIME_NONE) {
+    uint8_t duty[OUTPUT_PIN_COUNT];
+    for (int i = 0; i < OUTPUT_PIN_COUNT; i++) duty[i] = outputDuty(OUTPUT_PINS[i]);
+    uint32_t dtUs = (uint32_t)min(now - lastSample, (DurationUs)usFromMs(2 * PARK_CYCLE_MS));
+    uint32_t sleepUs = (uint32_t)min(slept - lastSleptUs, (uint64_t)dtUs);
+    bool wifi = webApActive(), ble = bleKeylessScanning();
+    portENTER_CRITICAL(&energyMux);
+    add(on ? ride : parked, duty, wifi, ble, dtUs, sleepUs);
+    portEXIT_CRITICAL(&energyMux);
+  }
+  lastSample  = now;
+  lastSleptUs = slept;
+
+  if (!on) checkBudget(now);
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+void energyInit() {
+  schedEvery(SCHED_COMMS, "energy", ENERGY_SAMPLE_MS, energyJob, SCHED_SHEDDABLE);
+}
+
+float energyParkedMah() {
+  return totalMah(parked);
+}
+
+static void accountJson(JsonObject o, const Account& a) {
+  static const char* const KEYS[OUTPUT_PIN_COUNT] = {
+    "turnLOut", "turnROut", "lightOut", "hibeam", "brakeOut", "hornOut",
+    "start1", "start2", "ignOut", "aux1Out", "aux2Out"
+  };
+  o["minutes"] = a.durationMs / 60000.0f;
+  o["mah"]     = totalMah(a);
+  JsonObject outs = o["outputs"].to<JsonObject>();
+  for (int i = 0; i < OUTPUT_PIN_COUNT; i++) {
+    if (!a.outOnMs[i]) continue;
+    JsonObject x = outs[KEYS[i]].to<JsonObject>();
+    x["onS"] = a.outOnMs[i] / 1000;
+    x["mah"] = mahOf(a.outMaUs[i]);
+  }
+  o["baseMah"] = mahOf(a.baseMaUs);
+  o["wifiS"]   = a.wifiMs / 1000;
+  o["wifiMah"] = mahOf(a.wifiMaUs);
+  o["bleS"]    = a.bleMs / 1000;
+  o["bleMah"]  = mahOf(a.bleMaUs);
+  o["sleepS"]  = a.sleepMs / 1000;
+}
+
+void energyBuildJson(JsonDocument& doc) {
+  Account p, r;
+  portENTER_CRITICAL(&energyMux);
+  p = parked;
+  r = ride;
+  portEXIT_CRITICAL(&energyMux);
+
+  accountJson(doc["parked"].to<JsonObject>(), p);
+  accountJson(doc["ride"].to<JsonObject>(), r);
+  doc["batteryAh"] = settings.batteryAh;
+  doc["floorPct"]  = settings.parkFloorPct;
+  doc["cutoff"]    = bike.parkCutoff;
+  if (soc0 != SOC_UNKNOWN) {
+    float left = remainingMah();
+    doc["socParkPct"] = soc0;
+    doc["leftMah"]    = left;
+    float hours = p.durationMs / 3.6e6f;
+    float drainMa = hours > 0.0f ? totalMah(p) / hours : 0.0f;
+    float floorMah = settings.parkFloorPct * settings.batteryAh * 10.0f;
+    if (drainMa > 0.0f && left > floorMah) doc["hoursToFloor"] = (left - floorMah) / drainMa;
+  }
+}
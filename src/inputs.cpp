@@ -1,68 +1,246 @@
 #include "inputs.h"
+#include "control_loop.h"
+#include "scheduler.h"
+#include "outputs.h"
+#include <soc/gpio_reg.h>
+#include <esp_timer.h>
 
 // ============================================================================
-// DEBOUNCED INPUT
+// INPUT SNAPSHOT + VERTICAL-COUNTER DEBOUNCE
+// All inputs are read from the two GPIO input registers in one go and
+// debounced in parallel: bit n of each counter plane belongs to InputId n.
+// A change must be seen on consecutive samples before it reaches
+// bike.inputWord. An idle input (counter 0) is sampled every pass, so a
+// change is caught on the first tick; from that sample on its counter is
+// clocked every db_periodUs[i], anchored to it, and preloaded so that the
+// last of the samples lands settings.debounceMs[i] later (8 samples, or
+// one per ms below 7 ms). Accepted within one tick of the configured time.
 // ============================================================================
 
 // ESP32-S3 max GPIO number is 48 → MAX_PIN defined in config.h
 
-static bool db_initialized[MAX_PIN] = {};
-static bool db_stableState[MAX_PIN] = {};
-static bool db_lastReading[MAX_PIN] = {};
-static unsigned long db_lastChangeTime[MAX_PIN] = {};
+static int8_t   pinToInput[MAX_PIN];            // GPIO → InputId, -1 = none
+static bool     db_initialized  = false;
+static uint16_t db_cnt0 = 0, db_cnt1 = 0, db_cnt2 = 0;   // 3-bit counters
+static uint32_t db_periodUs[INPUT_COUNT];       // Sample period while counting
+static uint16_t db_pre0 = 0, db_pre1 = 0, db_pre2 = 0;   // Counter after the first sample
+static uint16_t db_passMask = 0;                // Inputs with debounce 0 ms
+static TimeUs   db_nextSample[INPUT_COUNT] = {};
 
-bool inputRawActive(int pin) {
-  if (pin == PIN_LOCK) {
-    return digitalRead(pin) == HIGH;   // LOCK connects to +12V
+// Safety fast path: asserting edges latched by the brake / kill ISRs
+static portMUX_TYPE      fp_mux     = portMUX_INITIALIZER_UNLOCKED;
+static volatile uint16_t fp_latched = 0;
+
+static void speedSensorInit();
+
+// Read the GPIO input registers once and pack them into an active-high word
+static uint16_t readInputWordRaw() {
+  uint32_t in0 = REG_READ(GPIO_IN_REG);    // GPIO 0-31
+  uint32_t in1 = REG_READ(GPIO_IN1_REG);   // GPIO 32-48
+
+  uint16_t level = 0;
+  for (int i = 0; i < INPUT_COUNT; i++) {
+    int pin = INPUT_PINS[i];
+    uint32_t bit = (pin < 32) ? (in0 >> pin) : (in1 >> (pin - 32));
+    level |= (uint16_t)((bit & 1u) << i);
   }
-  return digitalRead(pin) == LOW;      // All other inputs switch to ground
+
+  // Active-high inputs keep their level, all others are inverted
+  return (level ^ ~INPUT_ACTIVE_HIGH_MASK) & INPUT_ALL_MASK;
 }
 
-bool inputActive(int pin) {
-  if (pin < 0 || pin >= MAX_PIN) {
-    LOG_E("inputActive: invalid pin %d", pin);
-    return false;   // FIX: return safe default, not raw read
+// Any edge on a switch input wakes the control loop (speed has its own ISR)
+static void IRAM_ATTR inputEdgeISR() {
+  controlWakeFromISR();
+}
+
+// Fast-path masks: which inputs bypass the debounce on their asserting edge,
+// and the word level that counts as asserted. Kill polarity follows
+// standKillMode % 3 (0 = N/O, 1 = N/C, 2 = disabled).
+static inline void IRAM_ATTR fastPathMask(uint16_t& mask, uint16_t& level) {
+  mask  = INPUT_BIT(IN_BRAKE);
+  level = INPUT_BIT(IN_BRAKE);
+  switch (settings.standKillMode % 3) {
+    case 0: mask |= INPUT_BIT(IN_KILL); level |= INPUT_BIT(IN_KILL); break;
+    case 1: mask |= INPUT_BIT(IN_KILL); break;
+    default: break;
+  }
+}
+
+static_assert(PIN_BRAKE < 32 && PIN_KILL < 32, "fast-path ISRs read GPIO_IN_REG");
+
+// Brake pressed → brake light on right now, before any debounce
+static void IRAM_ATTR brakeEdgeISR() {
+  if (!(REG_READ(GPIO_IN_REG) & (1u << PIN_BRAKE))) {
+    outputsFastBrakeOn();
+    portENTER_CRITICAL_ISR(&fp_mux);
+    fp_latched |= INPUT_BIT(IN_BRAKE);
+    portEXIT_CRITICAL_ISR(&fp_mux);
+  }
+  controlWakeFromISR();
+}
+
+// Kill asserted → ignition and starter cut right now
+static void IRAM_ATTR killEdgeISR() {
+  uint16_t mask, level;
+  fastPathMask(mask, level);
+  if (mask & INPUT_BIT(IN_KILL)) {
+    bool active   = !(REG_READ(GPIO_IN_REG) & (1u << PIN_KILL));
+    bool asserted = active == ((level & INPUT_BIT(IN_KILL)) != 0);
+    if (asserted) {
+      outputsFastKill();
+      portENTER_CRITICAL_ISR(&fp_mux);
+      fp_latched |= INPUT_BIT(IN_KILL);
+      portEXIT_CRITICAL_ISR(&fp_mux);
+    }
+  }
+  controlWakeFromISR();
+}
+
+void inputsInit() {
+  for (int pin = 0; pin < MAX_PIN; pin++) pinToInput[pin] = -1;
+  inputsApplyDebounceProfile();
+
+  for (int i = 0; i < INPUT_COUNT; i++) {
+    pinToInput[INPUT_PINS[i]] = (int8_t)i;
+    pinMode(INPUT_PINS[i],
+            (INPUT_ACTIVE_HIGH_MASK & INPUT_BIT(i)) ? INPUT_PULLDOWN
+                                                    : INPUT_PULLUP);
+    if (i == IN_BRAKE) {
+      attachInterrupt(digitalPinToInterrupt(INPUT_PINS[i]), brakeEdgeISR, CHANGE);
+    } else if (i == IN_KILL) {
+      attachInterrupt(digitalPinToInterrupt(INPUT_PINS[i]), killEdgeISR, CHANGE);
+    } else if (i != IN_SPEED) {
+      attachInterrupt(digitalPinToInterrupt(INPUT_PINS[i]), inputEdgeISR, CHANGE);
+    }
+  }
+
+  speedSensorInit();
+}
+
+void inputsApplyDebounceProfile() {
+  db_passMask = 0;
+  db_pre0 = db_pre1 = db_pre2 = 0;
+  for (int i = 0; i < INPUT_COUNT; i++) {
+    uint8_t ms = settings.debounceMs[i];
+    if (ms == 0) db_passMask |= INPUT_BIT(i);
+    // Samples spanning ms: 8, or one per control tick for short times
+    uint8_t n   = constrain(ms + 1, 2, DEBOUNCE_COUNTER_SAMPLES);
+    uint8_t pre = DEBOUNCE_COUNTER_SAMPLES + 1 - n;
+    db_periodUs[i] = (uint32_t)ms * 1000 / (n - 1);
+    if (pre & 1) db_pre0 |= INPUT_BIT(i);
+    if (pre & 2) db_pre1 |= INPUT_BIT(i);
+    if (pre & 4) db_pre2 |= INPUT_BIT(i);
+  }
+}
+
+void inputsSample() {
+  TimeUs now = schedNow(SCHED_CONTROL);
+  uint16_t raw = readInputWordRaw();
+  bike.inputSampleTime = now;
+
+  if (!db_initialized) {
+    db_initialized = true;
+    bike.inputWord = raw;
+    for (int i = 0; i < INPUT_COUNT; i++) db_nextSample[i] = now;
+    return;
   }
 
-  bool reading = inputRawActive(pin);
+  // Unfiltered inputs follow the raw level directly
+  bike.inputWord = (bike.inputWord & ~db_passMask) | (raw & db_passMask);
 
-  if (!db_initialized[pin]) {
-    db_initialized[pin]    = true;
-    db_stableState[pin]    = reading;
-    db_lastReading[pin]    = reading;
-    db_lastChangeTime[pin] = millis();
-    return db_stableState[pin];
+  // Safety fast path: an asserting brake / kill level (or an edge latched by
+  // the ISR in between) is taken at once; only the release is debounced.
+  uint16_t fastMask, fastLevel;
+  fastPathMask(fastMask, fastLevel);
+  portENTER_CRITICAL(&fp_mux);
+  uint16_t latched = fp_latched;
+  fp_latched = 0;
+  portEXIT_CRITICAL(&fp_mux);
+  if (latched) {
+    outputsFastRelease(latched & INPUT_BIT(IN_BRAKE), latched & INPUT_BIT(IN_KILL));
   }
 
-  if (reading != db_lastReading[pin]) {
-    db_lastReading[pin]    = reading;
-    db_lastChangeTime[pin] = millis();
+  uint16_t asserted = ((uint16_t)~(raw ^ fastLevel) & fastMask) | (latched & fastMask);
+  bike.inputWord = (bike.inputWord & ~asserted) | (fastLevel & asserted);
+  db_cnt0 &= ~asserted;
+  db_cnt1 &= ~asserted;
+  db_cnt2 &= ~asserted;
+
+  // Which inputs are due for a debounce sample this pass: idle ones always,
+  // counting ones on their own period
+  uint16_t idle = ~(db_cnt0 | db_cnt1 | db_cnt2);
+  uint16_t clk  = idle;
+  for (int i = 0; i < INPUT_COUNT; i++) {
+    if (!(idle & INPUT_BIT(i)) && now >= db_nextSample[i]) {
+      clk |= INPUT_BIT(i);
+      db_nextSample[i] += db_periodUs[i];
+    }
   }
 
-  if ((millis() - db_lastChangeTime[pin]) >= DEBOUNCE_DELAY_MS
-      && db_stableState[pin] != reading) {
-    db_stableState[pin] = reading;
+  // Count up where a clocked sample differs from the stable state, reset
+  // where it agrees; unclocked bits hold. A counter wrapping 7 → 0 means
+  // the input has been stable long enough.
+  uint16_t delta = raw ^ bike.inputWord;
+  uint16_t inc = delta & clk;
+  uint16_t rst = ~delta & clk;
+  db_cnt2 = (db_cnt2 ^ (db_cnt1 & db_cnt0 & inc)) & ~rst;
+  db_cnt1 = (db_cnt1 ^ (db_cnt0 & inc)) & ~rst;
+  db_cnt0 = (db_cnt0 ^ inc) & ~rst;
+
+  // First sample of a change: preload the count and start the period clock
+  uint16_t start = inc & idle;
+  if (start) {
+    db_cnt0 = (db_cnt0 & ~start) | (db_pre0 & start);
+    db_cnt1 = (db_cnt1 & ~start) | (db_pre1 & start);
+    db_cnt2 = (db_cnt2 & ~start) | (db_pre2 & start);
+    for (int i = 0; i < INPUT_COUNT; i++) {
+      if (start & INPUT_BIT(i)) db_nextSample[i] = now + db_periodUs[i];
+    }
   }
 
-  return db_stableState[pin];
+  uint16_t toggle = inc & ~(db_cnt0 | db_cnt1 | db_cnt2);
+  bike.inputWord ^= toggle;
+
+  // Keep sampling while a switch input differs from its stable state
+  uint16_t pending = (raw ^ bike.inputWord) & ~INPUT_BIT(IN_SPEED);
+  for (int i = 0; pending; i++, pending >>= 1) {
+    if (pending & 1) controlWakeAt(db_nextSample[i]);
+  }
+}
+
+bool inputRawActive(int pin) {
+  if (pin == PIN_LOCK) {
+    return digitalRead(pin) == HIGH;   // LOCK connects to +12V
+  }
+  return digitalRead(pin) == LOW;      // All other inputs switch to ground
+}
+
+bool inputActive(int pin) {
+  if (pin < 0 || pin >= MAX_PIN || pinToInput[pin] < 0) {
+    LOG_E("inputActive: invalid pin %d", pin);
+    return false;   // FIX: return safe default, not raw read
+  }
+  return inputBit((InputId)pinToInput[pin]);
 }
 
 // ============================================================================
 // BUTTON EVENT PROCESSING
 // ============================================================================
 
-void updateButtonEvent(int pin, ButtonEvent& event,
+void updateButtonEvent(InputId id, ButtonEvent& event,
                        unsigned long longPressMs,
                        unsigned long doubleClickMs) {
-  bool state = inputActive(pin);
-  unsigned long now = millis();
+  bool state = inputBit(id);
+  TimeUs now = bike.inputSampleTime;
 
   event.pressed     = state && !event.state;
   event.released    = !state && event.state;
   event.doubleClick = false;
 
   if (event.pressed) {
-    if (now - event.lastReleaseTime <= doubleClickMs) {
+    if (timeIsSet(event.lastReleaseTime)
+        && now - event.lastReleaseTime <= usFromMs(doubleClickMs)) {
       event.doubleClick = true;
     }
     event.pressStartTime   = now;
@@ -74,34 +252,90 @@ void updateButtonEvent(int pin, ButtonEvent& event,
   }
 
   event.longPress = false;
-  if (state && longPressMs > 0 && !event.longPressLatched
-      && (now - event.pressStartTime >= longPressMs)) {
-    event.longPress        = true;
-    event.longPressLatched = true;
+  if (state && longPressMs > 0 && !event.longPressLatched) {
+    if (now - event.pressStartTime >= usFromMs(longPressMs)) {
+      event.longPress        = true;
+      event.longPressLatched = true;
+    } else {
+      controlWakeAt(event.pressStartTime + usFromMs(longPressMs));
+    }
   }
 
   event.state = state;
 }
 
 void refreshInputEvents() {
-  updateButtonEvent(PIN_LOCK,  lockEvent);
-  updateButtonEvent(PIN_TURNL, turnLeftEvent,  LONG_PRESS_THRESHOLD_MS);
-  updateButtonEvent(PIN_TURNR, turnRightEvent, LONG_PRESS_THRESHOLD_MS);
-  updateButtonEvent(PIN_LIGHT, lightEvent,     LONG_PRESS_THRESHOLD_MS);
-  updateButtonEvent(PIN_START, startEvent,     0, 500);
-  updateButtonEvent(PIN_HORN,  hornEvent,      LONG_PRESS_THRESHOLD_MS);
+  inputsSample();
+
+  updateButtonEvent(IN_LOCK,  lockEvent);
+  updateButtonEvent(IN_TURNL, turnLeftEvent,  LONG_PRESS_THRESHOLD_MS);
+  updateButtonEvent(IN_TURNR, turnRightEvent, LONG_PRESS_THRESHOLD_MS);
+  updateButtonEvent(IN_LIGHT, lightEvent,     LONG_PRESS_THRESHOLD_MS);
+  updateButtonEvent(IN_START, startEvent,     0, 500);
+  updateButtonEvent(IN_HORN,  hornEvent,      LONG_PRESS_THRESHOLD_MS);
 }
 
 // ============================================================================
 // SPEED SENSOR
+// Every active edge on PIN_SPEED is counted in an ISR and timestamped with
+// esp_timer (µs), so pulses are not lost behind the 50ms input debounce.
+// The loop only copies the totals and derives speed from the last period.
 // ============================================================================
 
+static portMUX_TYPE      spd_mux = portMUX_INITIALIZER_UNLOCKED;
+static volatile uint32_t spd_pulseCount = 0;
+static volatile int64_t  spd_lastEdgeUs = 0;
+static volatile uint32_t spd_periodUs   = 0;
+static TimeUs            spd_lastFilter = 0;
+
+static void IRAM_ATTR speedEdgeISR() {
+  int64_t now = esp_timer_get_time();
+  portENTER_CRITICAL_ISR(&spd_mux);
+  if (spd_lastEdgeUs != 0) {
+    int64_t dt = now - spd_lastEdgeUs;
+    if (dt < SPEED_MIN_PERIOD_US) {          // Contact bounce / EMI spike
+      portEXIT_CRITICAL_ISR(&spd_mux);
+      return;
+    }
+    spd_periodUs = (uint32_t)min<int64_t>(dt, UINT32_MAX);
+  }
+  spd_lastEdgeUs = now;
+  spd_pulseCount++;
+  portEXIT_CRITICAL_ISR(&spd_mux);
+}
+
+static void speedSensorInit() {
+  // Sensor pulls to GND when active → count falling edges
+  attachInterrupt(digitalPinToInterrupt(PIN_SPEED), speedEdgeISR, FALLING);
+}
+
 void handleSpeedSensor() {
-  static bool lastSpeedState = false;
-  bool speedState = inputActive(PIN_SPEED);
+  portENTER_CRITICAL(&spd_mux);
+  uint32_t count  = spd_pulseCount;
+  int64_t  lastUs = spd_lastEdgeUs;
+  uint32_t period = spd_periodUs;
+  portEXIT_CRITICAL(&spd_mux);
 
-  if (speedState && !lastSpeedState) {
-    bike.speedPulseCount++;
+  bike.speedPulseCount = count;
+
+  // Instantaneous speed from the last period. While no new edge arrives,
+  // the time since the last edge bounds the period so speed decays to 0.
+  int64_t sinceLast = esp_timer_get_time() - lastUs;
+  if (lastUs == 0 || period == 0 || sinceLast >= SPEED_STOP_TIMEOUT_US) {
+    bike.speedPulseHz = 0.0f;
+  } else {
+    uint32_t effective = max<uint32_t>(period, (uint32_t)sinceLast);
+    bike.speedPulseHz = 1000000.0f / effective;
+  }
+
+  // Smoothed road speed (first-order IIR at a fixed update rate)
+  TimeUs now = bike.inputSampleTime;
+  if (now - spd_lastFilter >= usFromMs(SPEED_FILTER_INTERVAL_MS)) {
+    spd_lastFilter = now;
+    float kmh = bike.speedPulseHz * SPEED_MM_PER_PULSE * 0.0036f;
+    bike.speedKmh += (kmh - bike.speedKmh) / (1 << SPEED_FILTER_SHIFT);
+  }
+  if (bike.speedPulseHz > 0.0f || bike.speedKmh > 0.05f) {
+    controlWakeAt(spd_lastFilter + usFromMs(SPEED_FILTER_INTERVAL_MS));
   }
-  lastSpeedState = speedState;
 }
@@ -0,0 +1,226 @@
+#include "lamp_monitor.h"
+#include "battery_adc.h"
+#include "outputs.h"
+#include "scheduler.h"
+#include <Preferences.h>
+
+static constexpr int        LAMP_COUNT = CALIBRATION_PIN_COUNT;
+static constexpr DurationUs BLOCK_US   = 1000000ULL * VBAT_ADC_FRAME_SAMPLES / VBAT_ADC_SAMPLE_HZ;
+
+static_assert(LAMP_COUNT <= 8, "lampFaults holds one bit per calibration output");
+
+static Preferences  lampPref;
+static const char*  NAMESPACE = "moto32lamp";
+
+struct Lamp {
+  uint16_t baseMa;      // Learned in calibration (full duty), 0 = none
+  uint16_t lastMa;      // Last step, scaled to full duty
+  uint8_t  openStreak;
+  uint8_t  okStreak;
+  uint32_t calSum;
+  uint8_t  calCount;
+};
+
+static Lamp    lamps[LAMP_COUNT];
+static int8_t  lampOf[OUTPUT_PIN_COUNT];   // Output index → lamp index, -1 = not a lamp
+static uint8_t prevDuty[OUTPUT_PIN_COUNT];
+static uint8_t faults = 0;
+static bool    calibrating = false;
+static volatile bool savePending = false;
+
+// Measurement in flight (control task only: edges and blocks both arrive there)
+static int8_t  active = -1;
+static bool    activeOn;
+static uint8_t activeDuty;
+static TimeUs  edgeAt;
+static int32_t lastMv = 0, preMv = 0;
+static int32_t postSum = 0;
+static uint8_t postBlocks = 0;
+static uint32_t measured = 0, dropped = 0;
+
+// ============================================================================
+// BASELINES (NVS, one key per lamp)
+// ============================================================================
+
+static void load() {
+  lampPref.begin(NAMESPACE, true);
+  for (int i = 0; i < LAMP_COUNT; i++) {
+    char k[4];
+    snprintf(k, sizeof(k), "b%d", i);
+    lamps[i].baseMa = lampPref.getUShort(k, 0);
+  }
+  lampPref.end();
+}
+
+// Comms job: NVS writes stay off the control core
+static void lampJob(TimeUs) {
+  if (!savePending) return;
+  savePending = false;
+  lampPref.begin(NAMESPACE, false);
+  for (int i = 0; i < LAMP_COUNT; i++) {
+    char k[4];
+    snprintf(k, sizeof(k), "b%d", i);
+    lampPref.putUShort(k, lamps[i].baseMa);
+  }
+  lampPref.end();
+}
+
+// ============================================================================
+// VERDICT
+// ============================================================================
+
+static void judge(int i, int32_t stepMv) {
+  Lamp& l = lamps[i];
+  float rMohm = bike.batteryRint > 0.0f ? bike.batteryRint : (float)LAMP_RLOOP_DEFAULT_MOHM;
+  uint32_t ma = stepMv > 0 ? (uint32_t)(stepMv * 1000.0f / rMohm) * 255 / activeDuty : 0;
+  l.lastMa = (uint16_t)min(ma, (uint32_t)UINT16_MAX);
+  measured++;
+
+  if (calibrating) {
+    l.calSum += l.lastMa;
+    l.calCount++;
+    return;
+  }
+  if ((uint32_t)l.baseMa * activeDuty / 255 < LAMP_MIN_MA) return;
+
+  uint8_t bit = (uint8_t)(1u << i);
+  uint32_t pct = (uint32_t)l.lastMa * 100 / l.baseMa;
+  if (pct < LAMP_OPEN_PCT) {
+    l.okStreak = 0;
+    if (l.openStreak < LAMP_CONFIRM) l.openStreak++;
+    if (l.openStreak >= LAMP_CONFIRM && !(faults & bit)) {
+      faults |= bit;
+      LOG_W("Lamp on GPIO %d open: %u mA, expected %u mA", CALIBRATION_PINS[i], l.lastMa, l.baseMa);
+    }
+  } else if (pct >= LAMP_OK_PCT) {
+    l.openStreak = 0;
+    if (l.okStreak < LAMP_CONFIRM) l.okStreak++;
+    if (l.okStreak >= LAMP_CONFIRM && (faults & bit)) {
+      faults &= ~bit;
+      LOG_I("Lamp on GPIO %d OK again (%u mA)", CALIBRATION_PINS[i], l.lastMa);
+    }
+  }
+}
+
+static void onBlock(TimeUs now, int32_t meanMv, int32_t, int32_t) {
+  if (active < 0) {
+    lastMv = meanMv;
+    return;
+  }
+  if (now < edgeAt + usFromMs(LAMP_SETTLE_MS) + BLOCK_US) return;   // Block overlaps edge / inrush
+  postSum += meanMv;
+  if (++postBlocks < LAMP_AVG_BLOCKS) return;
+
+  int32_t postMv = postSum / LAMP_AVG_BLOCKS;
+  judge(active, activeOn ? preMv - postMv : postMv - preMv);
+  active = -1;
+  lastMv = meanMv;
+}
+
+// ============================================================================
+// CALIBRATION (every lamp switched alone by setup_mode.cpp)
+// ============================================================================
+
+static void calibrationStart() {
+  calibrating = true;
+  for (int i = 0; i < LAMP_COUNT; i++) {
+    lamps[i].calSum   = 0;
+    lamps[i].calCount = 0;
+  }
+}
+
+static void calibrationEnd() {
+  calibrating = false;
+  uint8_t learned = 0;
+  for (int i = 0; i < LAMP_COUNT; i++) {
+    Lamp& l = lamps[i];
+    if (!l.calCount) continue;
+    l.baseMa     = (uint16_t)(l.calSum / l.calCount);
+    l.openStreak = 0;
+    l.okStreak   = 0;
+    learned++;
+    LOG_I("Lamp on GPIO %d: baseline %u mA%s", CALIBRATION_PINS[i], l.baseMa,
+          l.baseMa < LAMP_MIN_MA ? " (too small, not monitored)" : "");
+  }
+  if (learned < LAMP_COUNT) {
+    LOG_W("Lamp baselines: %u of %d learned (engine must be off)", learned, LAMP_COUNT);
+  }
+  faults = 0;
+  savePending = learned > 0;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+void lampMonitorInit() {
+  for (int i = 0; i < OUTPUT_PIN_COUNT; i++) {
+    lampOf[i] = -1;
+    for (int j = 0; j < LAMP_COUNT; j++) {
+      if (OUTPUT_PINS[i] == CALIBRATION_PINS[j]) lampOf[i] = (int8_t)j;
+    }
+  }
+  load();
+  batteryAdcOnBlock(onBlock);
+  schedEvery(SCHED_COMMS, "lamps", 200, lampJob, SCHED_SHEDDABLE);
+}
+
+void lampMonitorLearn(bool on) {
+  if (on) calibrationStart();
+  else if (calibrating) calibrationEnd();
+}
+
+void lampMonitorUpdate(TimeUs now) {
+  uint8_t duty[OUTPUT_PIN_COUNT];
+  int changed = -1;
+  uint8_t changes = 0;
+  for (int i = 0; i < OUTPUT_PIN_COUNT; i++) {
+    duty[i] = outputDuty(OUTPUT_PINS[i]);
+    if (duty[i] != prevDuty[i]) {
+      changed = i;
+      changes++;
+    }
+  }
+
+  // Any other change while measuring mixes two loads into the step
+  if (active >= 0 && (changes || now - edgeAt > usFromMs(LAMP_TIMEOUT_MS))) {
+    active = -1;
+    dropped++;
+  }
+
+  if (active < 0 && changes == 1 && lampOf[changed] >= 0 && lastMv > 0
+      && !bike.engineRunning && !bike.starterEngaged) {
+    uint8_t was = prevDuty[changed];
+    uint8_t is  = duty[changed];
+    if ((was == DUTY_OFF) != (is == DUTY_OFF)) {
+      active     = lampOf[changed];
+      activeOn   = is != DUTY_OFF;
+      activeDuty = activeOn ? is : was;
+      edgeAt     = now;
+      preMv      = lastMv;
+      postSum    = 0;
+      postBlocks = 0;
+    }
+  }
+
+  memcpy(prevDuty, duty, sizeof(prevDuty));
+}
+
+uint8_t lampMonitorFaults() {
+  return faults;
+}
+
+void lampMonitorBuildMetricsJson(JsonDocument& doc) {
+  JsonObject m = doc["lamps"].to<JsonObject>();
+  m["measured"] = measured;
+  m["dropped"]  = dropped;
+  m["faults"]   = faults;
+  JsonArray arr = m["outputs"].to<JsonArray>();
+  for (int i = 0; i < LAMP_COUNT; i++) {
+    JsonObject o = arr.add<JsonObject>();
+    o["pin"]    = CALIBRATION_PINS[i];
+    o["baseMa"] = lamps[i].baseMa;
+    o["lastMa"] = lamps[i].lastMa;
+    o["open"]   = (faults >> i) & 1;
+  }
+}
@@ -0,0 +1,251 @@
+#include "light_patterns.h"
+
+// ============================================================================
+// BUILT-IN TABLES
+// ============================================================================
+
+#define P_COUNT(a) (uint8_t)(sizeof(a) / sizeof(a[0]))
+
+// 80 + 175·(1 + cos(2πk/37)) / 2 – starts at full, never fully dark
+static constexpr PatternSeg BRAKE_FADE_SEGS[] = {
+  {BRAKE_FADE_STEP_MS, 255, 0}, {BRAKE_FADE_STEP_MS, 254, 0}, {BRAKE_FADE_STEP_MS, 250, 0},
+  {BRAKE_FADE_STEP_MS, 244, 0}, {BRAKE_FADE_STEP_MS, 236, 0}, {BRAKE_FADE_STEP_MS, 225, 0},
+  {BRAKE_FADE_STEP_MS, 213, 0}, {BRAKE_FADE_STEP_MS, 200, 0}, {BRAKE_FADE_STEP_MS, 186, 0},
+  {BRAKE_FADE_STEP_MS, 171, 0}, {BRAKE_FADE_STEP_MS, 156, 0}, {BRAKE_FADE_STEP_MS, 142, 0},
+  {BRAKE_FADE_STEP_MS, 128, 0}, {BRAKE_FADE_STEP_MS, 115, 0}, {BRAKE_FADE_STEP_MS, 104, 0},
+  {BRAKE_FADE_STEP_MS,  95, 0}, {BRAKE_FADE_STEP_MS,  88, 0}, {BRAKE_FADE_STEP_MS,  83, 0},
+  {BRAKE_FADE_STEP_MS,  80, 0}, {BRAKE_FADE_STEP_MS,  80, 0}, {BRAKE_FADE_STEP_MS,  83, 0},
+  {BRAKE_FADE_STEP_MS,  88, 0}, {BRAKE_FADE_STEP_MS,  95, 0}, {BRAKE_FADE_STEP_MS, 104, 0},
+  {BRAKE_FADE_STEP_MS, 115, 0}, {BRAKE_FADE_STEP_MS, 128, 0}, {BRAKE_FADE_STEP_MS, 142, 0},
+  {BRAKE_FADE_STEP_MS, 156, 0}, {BRAKE_FADE_STEP_MS, 171, 0}, {BRAKE_FADE_STEP_MS, 186, 0},
+  {BRAKE_FADE_STEP_MS, 200, 0}, {BRAKE_FADE_STEP_MS, 213, 0}, {BRAKE_FADE_STEP_MS, 225, 0},
+  {BRAKE_FADE_STEP_MS, 236, 0}, {BRAKE_FADE_STEP_MS, 244, 0}, {BRAKE_FADE_STEP_MS, 250, 0},
+  {BRAKE_FADE_STEP_MS, 254, 0},
+};
+static_assert(P_COUNT(BRAKE_FADE_SEGS) * BRAKE_FADE_STEP_MS == BRAKE_FADE_PERIOD_MS,
+              "Brake fade table must span one period");
+
+static constexpr PatternSeg BRAKE_FLASH_SEGS[] = {
+  {BRAKE_FLASH_PERIOD_MS, 255, 0}, {BRAKE_FLASH_PERIOD_MS, 0, PATTERN_FOREVER},
+};
+
+static constexpr PatternSeg BRAKE_8X_SEGS[] = {
+  {BRAKE_FLASH_PERIOD_MS, 255, 0},
+  {BRAKE_FLASH_PERIOD_MS, 0, BRAKE_8X_DURATION_MS / (2 * BRAKE_FLASH_PERIOD_MS)},
+  {0, 255, 0},
+};
+
+static constexpr PatternSeg BRAKE_2X_SEGS[] = {
+  {BRAKE_FLASH_PERIOD_MS, 255, 0},
+  {BRAKE_FLASH_PERIOD_MS, 0, BRAKE_2X_DURATION_MS / (2 * BRAKE_FLASH_PERIOD_MS)},
+  {0, 255, 0},
+};
+
+static constexpr PatternSeg BRAKE_3S_SEGS[] = {
+  {BRAKE_CONTINUOUS_DELAY_MS, 255, 1},
+  {BRAKE_FLASH_PERIOD_MS, 0, 0}, {BRAKE_FLASH_PERIOD_MS, 255, PATTERN_FOREVER},
+};
+
+static constexpr PatternSeg FLASHER_SEGS[] = {
+  {FLASHER_PERIOD_MS, 255, 0}, {FLASHER_PERIOD_MS, 0, 0},
+};
+
+// Segment brightness (step + 1) × 255 / MOWAVE_STEPS, then dark
+static constexpr PatternSeg MOWAVE_SEGS[] = {
+  {MOWAVE_STEP_MS, 85, 0}, {MOWAVE_STEP_MS, 170, 0}, {MOWAVE_STEP_MS, 255, 0},
+  {MOWAVE_OFF_MS, 0, 0},
+};
+static_assert(MOWAVE_STEPS == 3, "MOWAVE_SEGS has one entry per segment");
+
+static constexpr PatternSeg ALARM_SEGS[] = {
+  {ALARM_FLASH_PERIOD_MS, 255, 0}, {ALARM_FLASH_PERIOD_MS, 0, 0},
+};
+
+const LightPattern PATTERN_BRAKE_FADE  = { BRAKE_FADE_SEGS,  P_COUNT(BRAKE_FADE_SEGS) };
+const LightPattern PATTERN_BRAKE_FLASH = { BRAKE_FLASH_SEGS, P_COUNT(BRAKE_FLASH_SEGS) };
+const LightPattern PATTERN_BRAKE_8X    = { BRAKE_8X_SEGS,    P_COUNT(BRAKE_8X_SEGS) };
+const LightPattern PATTERN_BRAKE_2X    = { BRAKE_2X_SEGS,    P_COUNT(BRAKE_2X_SEGS) };
+const LightPattern PATTERN_BRAKE_3S    = { BRAKE_3S_SEGS,    P_COUNT(BRAKE_3S_SEGS) };
+const LightPattern PATTERN_FLASHER     = { FLASHER_SEGS,     P_COUNT(FLASHER_SEGS) };
+const LightPattern PATTERN_MOWAVE      = { MOWAVE_SEGS,      P_COUNT(MOWAVE_SEGS) };
+const LightPattern PATTERN_ALARM       = { ALARM_SEGS,       P_COUNT(ALARM_SEGS) };
+
+// ============================================================================
+// PLAYER
+// ============================================================================
+
+// Total length of one pass, 0 if the pattern never finishes (hold / endless)
+static uint32_t patternCycleMs(const LightPattern& p) {
+  uint32_t total = 0, group = 0;
+  for (uint8_t i = 0; i < p.count; i++) {
+    const PatternSeg& s = p.seg[i];
+    if (s.ms == 0 || s.repeat == PATTERN_FOREVER) return 0;
+    group += s.ms;
+    if (s.repeat != 0 || i + 1 == p.count) {
+      total += group * (s.repeat ? s.repeat : 1);
+      group = 0;
+    }
+  }
+  return total;
+}
+
+uint8_t patternEval(const LightPattern& p, uint32_t elapsedMs, uint32_t* msToNext) {
+  uint32_t cycle = patternCycleMs(p);
+  uint32_t t = cycle ? elapsedMs % cycle : elapsedMs;
+
+  uint8_t first = 0;
+  uint32_t groupMs = 0;
+  for (uint8_t i = 0; i < p.count; i++) {
+    const PatternSeg& s = p.seg[i];
+    if (s.ms == 0) {                      // Hold
+      *msToNext = PATTERN_NEVER;
+      return s.duty;
+    }
+    groupMs += s.ms;
+    bool groupEnd = s.repeat != 0 || i + 1 == p.count || p.seg[i + 1].ms == 0;
+    if (!groupEnd) continue;
+
+    bool forever = s.repeat == PATTERN_FOREVER;
+    uint32_t plays = forever ? 1 : (s.repeat ? s.repeat : 1);
+    if (forever || t < groupMs * plays) {
+      t %= groupMs;
+      for (uint8_t k = first; k <= i; k++) {
+        if (t < p.seg[k].ms) {
+          *msToNext = p.seg[k].ms - t;
+          return p.seg[k].duty;
+        }
+        t -= p.seg[k].ms;
+      }
+    }
+    t -= groupMs * plays;
+    first = i + 1;
+    groupMs = 0;
+  }
+
+  *msToNext = PATTERN_NEVER;              // Empty pattern
+  return 0;
+}
+
+// ============================================================================
+// CUSTOM SLOTS
+// Double-buffered: an upload fills the idle buffer and then swaps the live
+// pointer. A player can still hold the buffer from the upload before last,
+// so players evaluate under patMux (patternEvalLocked).
+// ============================================================================
+
+struct CustomSlot {
+  PatternSeg             buf[2][PATTERN_MAX_SEGS];
+  LightPattern           pat[2];
+  const LightPattern*    live;
+  uint8_t                idle;
+};
+
+static CustomSlot custom[PATTERN_SLOT_COUNT] = {};
+static portMUX_TYPE patMux = portMUX_INITIALIZER_UNLOCKED;
+
+static const char* const SLOT_NAMES[PATTERN_SLOT_COUNT] = { "brake", "hazard", "alarm" };
+
+uint8_t patternEvalLocked(const LightPattern& p, uint32_t elapsedMs, uint32_t* msToNext) {
+  portENTER_CRITICAL_SAFE(&patMux);
+  uint8_t duty = patternEval(p, elapsedMs, msToNext);
+  portEXIT_CRITICAL_SAFE(&patMux);
+  return duty;
+}
+
+// Brake light: lit in the first segment, no dark stretch (across segments,
+// groups and repeats) over BRAKE_PATTERN_MAX_DARK_MS, no dark hold or endless
+// dark group. Same grouping rules as patternEval().
+static bool brakePatternSafe(const PatternSeg* seg, uint8_t count) {
+  if (count == 0) return true;                       // Cleared: built-in pattern
+  if (seg[0].duty < BRAKE_PATTERN_MIN_DUTY) return false;
+
+  uint32_t dark = 0;                                 // Current dark stretch
+  uint8_t  first = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    const PatternSeg& s = seg[i];
+    if (s.ms == 0) return s.duty >= BRAKE_PATTERN_MIN_DUTY;   // Hold: nothing after
+    bool groupEnd = s.repeat != 0 || i + 1 == count || seg[i + 1].ms == 0;
+    if (!groupEnd) continue;
+
+    bool     forever = s.repeat == PATTERN_FOREVER;
+    uint32_t plays   = forever ? 2 : (s.repeat ? s.repeat : 1);
+    bool     lit     = false;
+    uint32_t groupMs = 0;
+    for (uint8_t k = first; k <= i; k++) {
+      lit |= seg[k].duty >= BRAKE_PATTERN_MIN_DUTY;
+      groupMs += seg[k].ms;
+    }
+    if (!lit) {
+      if (forever) return false;
+      dark += groupMs * plays;
+      if (dark > BRAKE_PATTERN_MAX_DARK_MS) return false;
+    } else {
+      // Two plays cover the dark stretch across the repeat boundary
+      for (uint32_t n = 0; n < plays && n < 2; n++) {
+        for (uint8_t k = first; k <= i; k++) {
+          if (seg[k].duty >= BRAKE_PATTERN_MIN_DUTY) {
+            dark = 0;
+          } else if ((dark += seg[k].ms) > BRAKE_PATTERN_MAX_DARK_MS) {
+            return false;
+          }
+        }
+      }
+    }
+    if (forever) return true;                        // Nothing after
+    first = i + 1;
+  }
+  return true;                                       // Loops back to the lit start
+}
+
+bool patternSetCustom(PatternSlot slot, const PatternSeg* seg, uint8_t count) {
+  if (slot >= PATTERN_SLOT_COUNT || count > PATTERN_MAX_SEGS) return false;
+  if (slot == PATTERN_SLOT_BRAKE && !brakePatternSafe(seg, count)) {
+    LOG_W("Pattern brake: rejected, would leave the brake light dark");
+    return false;
+  }
+
+  portENTER_CRITICAL(&patMux);
+  CustomSlot& c = custom[slot];
+  if (count == 0) {
+    c.live = nullptr;
+  } else {
+    uint8_t b = c.idle;
+    memcpy(c.buf[b], seg, count * sizeof(PatternSeg));
+    c.pat[b] = LightPattern{ c.buf[b], count };
+    c.live = &c.pat[b];
+    c.idle = b ^ 1;
+  }
+  portEXIT_CRITICAL(&patMux);
+
+  LOG_I("Pattern %s: %u segments", SLOT_NAMES[slot], count);
+  return true;
+}
+
+const LightPattern* patternCustom(PatternSlot slot) {
+  return slot < PATTERN_SLOT_COUNT ? custom[slot].live : nullptr;
+}
+
+uint8_t patternCopyCustom(PatternSlot slot, PatternSeg* out) {
+  if (slot >= PATTERN_SLOT_COUNT) return 0;
+  portENTER_CRITICAL(&patMux);
+  const LightPattern* p = custom[slot].live;
+  uint8_t n = p ? p->count : 0;
+  if (n) memcpy(out, p->seg, n * sizeof(PatternSeg));
+  portEXIT_CRITICAL(&patMux);
+  return n;
+}
+
+const char* patternSlotName(PatternSlot slot) {
+  return slot < PATTERN_SLOT_COUNT ? SLOT_NAMES[slot] : "?";
+}
+
+bool patternSlotFromName(const char* name, PatternSlot& slot) {
+  if (!name) return false;
+  for (uint8_t i = 0; i < PATTERN_SLOT_COUNT; i++) {
+    if (strcmp(name, SLOT_NAMES[i]) == 0) {
+      slot = (PatternSlot)i;
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,107 @@
+#include "load_shed.h"
+#include "outputs.h"
+
+static const int32_t  TIER_MV[SHED_TIERS + 1]   = { 0, SHED_TIER1_MV, SHED_TIER2_MV, SHED_TIER3_MV };
+static const uint32_t TIER_HOLD[SHED_TIERS + 1] = { 0, SHED_TIER1_HOLD_MS, SHED_TIER2_HOLD_MS,
+                                                    SHED_TIER3_HOLD_MS };
+
+static const int PROTECTED_PINS[] = {
+  PIN_TURNL_OUT, PIN_TURNR_OUT, PIN_BRAKE_OUT, PIN_START_OUT1, PIN_START_OUT2, PIN_IGN_OUT
+};
+
+static_assert(SHED_TIERS == 3, "Tier tables list SHED_TIERS entries");
+
+static uint8_t  level = 0;                          // Tiers 1..level are shed
+static TimeUs   belowSince[SHED_TIERS + 1] = { TIME_NONE, TIME_NONE, TIME_NONE, TIME_NONE };
+static TimeUs   aboveSince = TIME_NONE;
+static uint32_t sheds = 0, restores = 0;
+
+static uint16_t maskFor(uint8_t lvl) {
+  uint16_t m = 0;
+  for (int i = 0; i < OUTPUT_PIN_COUNT; i++) {
+    uint8_t t = settings.shedTier[i];
+    if (t && t <= lvl) m |= (uint16_t)(1u << i);
+  }
+  return m;
+}
+
+static void logOutputs(char* buf, size_t len, uint16_t mask) {
+  size_t n = 0;
+  buf[0] = '\0';
+  for (int i = 0; i < OUTPUT_PIN_COUNT && n < len; i++) {
+    if (mask & (1u << i)) n += snprintf(buf + n, len - n, " GPIO%d", OUTPUT_PINS[i]);
+  }
+  if (!mask) snprintf(buf, len, " (no outputs)");
+}
+
+static void setLevel(uint8_t lvl, int32_t mv) {
+  char outs[96];
+  if (lvl > level) {
+    logOutputs(outs, sizeof(outs), maskFor(lvl) & ~maskFor(level));
+    LOG_W("Load shed tier %u: %.2fV for %lus –%s off", lvl, mv / 1000.0f,
+          (unsigned long)(TIER_HOLD[lvl] / 1000), outs);
+    sheds++;
+  } else {
+    logOutputs(outs, sizeof(outs), maskFor(level) & ~maskFor(lvl));
+    LOG_I("Load restore tier %u: %.2fV –%s back", level, mv / 1000.0f, outs);
+    restores++;
+  }
+  level = lvl;
+  aboveSince = TIME_NONE;                            // Next restore needs its own window
+}
+
+uint8_t loadShedTierClamp(int outputIdx, int tier) {
+  if (outputIdx < 0 || outputIdx >= OUTPUT_PIN_COUNT) return 0;
+  for (int pin : PROTECTED_PINS) {
+    if (OUTPUT_PINS[outputIdx] == pin) return 0;
+  }
+  return (uint8_t)constrain(tier, 0, SHED_TIERS);
+}
+
+void loadShedUpdate(TimeUs now) {
+  int32_t mv = (int32_t)(bike.batteryVoltage * 1000.0f);
+
+  if (bike.starterEngaged) {
+    // Cranking sag is expected: no time below or above a tier counts across
+    // it, so the filtered voltage gets a full hold to recover after a start
+    for (TimeUs& t : belowSince) t = TIME_NONE;
+    aboveSince = TIME_NONE;
+  } else if (mv > 1000) {                            // A disconnected ADC reads ~0
+    uint8_t target = level;
+    for (uint8_t t = level + 1; t <= SHED_TIERS; t++) {
+      if (mv >= TIER_MV[t]) {
+        belowSince[t] = TIME_NONE;
+        continue;
+      }
+      if (belowSince[t] == TIME_NONE) belowSince[t] = now;
+      if (now - belowSince[t] >= usFromMs(TIER_HOLD[t])) target = t;
+    }
+
+    if (target > level) {
+      setLevel(target, mv);
+    } else if (level && mv >= TIER_MV[level] + SHED_HYST_MV) {
+      if (aboveSince == TIME_NONE) aboveSince = now;
+      if (now - aboveSince >= usFromMs(SHED_RESTORE_MS)) {
+        belowSince[level] = TIME_NONE;
+        setLevel(level - 1, mv);
+      }
+    } else {
+      aboveSince = TIME_NONE;
+    }
+  }
+
+  uint16_t mask = maskFor(level);
+  for (int i = 0; i < OUTPUT_PIN_COUNT; i++) {
+    if (mask & (1u << i)) outputRequestOff(LAYER_SAFETY, OUTPUT_PINS[i]);
+  }
+  bike.shedMask  = mask;
+  bike.shedLevel = level;
+}
+
+void loadShedBuildMetricsJson(JsonDocument& doc) {
+  JsonObject s = doc["shed"].to<JsonObject>();
+  s["level"]    = level;
+  s["mask"]     = maskFor(level);
+  s["sheds"]    = sheds;
+  s["restores"] = restores;
+}
@@ -48,6 +48,17 @@
 #include "setup_mode.h"
 #include "ble_interface.h"
 #include "web_server.h"
+#include "control_loop.h"
+#include "scheduler.h"
+#include "battery_adc.h"
+#include "ripple_analysis.h"
+#include "crank_monitor.h"
+#include "battery_health.h"
+#include "lamp_monitor.h"
+#include "dimming.h"
+#include "load_shed.h"
+#include "energy.h"
+#include "power_mode.h"
 
 // ============================================================================
 // GLOBAL STATE INSTANCES
@@ -63,6 +74,9 @@ ButtonEvent startEvent;
 ButtonEvent hornEvent;
 ButtonEvent lockEvent;
 
+static void controlTick();
+static void commsTick();
+
 // ============================================================================
 // SETUP
 // ============================================================================
@@ -79,33 +93,18 @@ void setup() {
   Serial.begin(115200);
   LOG_I("Moto32 Firmware v" FIRMWARE_VERSION_STRING " starting...");
 
-  // Load persistent settings from NVS
+  // Load persistent settings from NVS; deferred saves run on the comms task
   loadSettings();
+  settingsStoreInit();
 
   // Initialize PWM channels
   outputsInitPWM();
 
-  // FIX #2: Initialize hardware watchdog
+  // FIX #2: Initialize hardware watchdog (tasks subscribe when started)
   safetyInitWatchdog();
 
-  // Configure ADC for battery voltage monitoring
-  analogReadResolution(12);
-  analogSetAttenuation(ADC_11db);
-  pinMode(PIN_VBAT_ADC, INPUT);
-
-  // Configure input pins
-  pinMode(PIN_LOCK,  INPUT_PULLDOWN);  // Active HIGH (12V)
-  pinMode(PIN_TURNL, INPUT_PULLUP);
-  pinMode(PIN_TURNR, INPUT_PULLUP);
-  pinMode(PIN_LIGHT, INPUT_PULLUP);
-  pinMode(PIN_START, INPUT_PULLUP);
-  pinMode(PIN_HORN,  INPUT_PULLUP);
-  pinMode(PIN_BRAKE, INPUT_PULLUP);
-  pinMode(PIN_KILL,  INPUT_PULLUP);
-  pinMode(PIN_STAND, INPUT_PULLUP);
-  pinMode(PIN_AUX1,  INPUT_PULLUP);
-  pinMode(PIN_AUX2,  INPUT_PULLUP);
-  pinMode(PIN_SPEED, INPUT_PULLUP);
+  // Configure input pins (LOCK pulled down, all others pulled up)
+  inputsInit();
 
   // Cold start LED test
   LOG_D("Cold start – LED test");
@@ -125,23 +124,37 @@ void setup() {
   // Web Dashboard (WiFi AP + HTTP + WebSocket)
   webInit();
 
-  // Initial voltage reading
-  safetyUpdateVoltage();
+  // Battery voltage: continuous DMA sampling, first reading ready on return
+  batteryAdcInit();
+  rippleAnalysisInit();
+  crankMonitorInit();
+  batteryHealthInit();
+  lampMonitorInit();
+  energyInit();
+  powerModeInit();
 
   LOG_I("Moto32 ready. Battery: %.1fV", bike.batteryVoltage);
+
+  // Control on core 1, BLE / web / NVS on core 0
+  controlTasksStart(controlTick, commsTick);
 }
 
-// Track previous engine state for keyless grace trigger
-static bool prevEngineRunning = false;
+// Arduino loopTask is not used – all work runs in the two pinned tasks
+void loop() {
+  vTaskDelete(NULL);
+}
 
 // ============================================================================
-// MAIN LOOP
+// CONTROL TICK (core 1, fixed CONTROL_PERIOD_US while active)
 // ============================================================================
 
-void loop() {
+static void controlTick() {
   // Feed watchdog first thing
   safetyFeedWatchdog();
 
+  // Cached tick for this pass + due periodic jobs
+  TimeUs now = schedRun(SCHED_CONTROL);
+
   // Read all button inputs
   refreshInputEvents();
 
@@ -149,15 +162,15 @@ void loop() {
   processCalibrationSequence();
   if (bike.calibrationState == CALIB_DONE) {
     bike.calibrationState = CALIB_IDLE;
-    saveSettings();
+    requestSaveSettings();
   }
 
   // Setup mode exit check
   if (bike.inSetupMode) {
     setupModeHandleExit();
     if (bike.inSetupMode) {
-      bleUpdate();
-      webUpdate();
+      outputsArbitrate();
+      controlSetFixedRate(true);
       return;
     }
   }
@@ -173,24 +186,19 @@ void loop() {
   handleBrake();
   handleSpeedSensor();
 
-  // BLE Keyless: update proximity scan + state machine
-  bleKeylessUpdate();
-
   // Keyless ignition: if phone detected, grant ignition even without key
   if (bleKeylessIgnitionAllowed() && !bike.ignitionOn) {
     bike.ignitionOn = true;
     LOG_I("Keyless: ignition ON (BLE proximity)");
   }
 
-  // Detect engine-off transition → trigger keyless grace period
-  if (prevEngineRunning && !bike.engineRunning) {
-    bleKeylessEngineOff();
-  }
-  prevEngineRunning = bike.engineRunning;
-
-  // FIX #10: Battery monitoring
-  safetyUpdateVoltage();
+  // FIX #10: Battery monitoring (filtered blocks from the DMA reader task)
+  batteryAdcUpdate();
   safetyCheckVoltage();
+  loadShedUpdate(now);
+  dimmingUpdate();
+  bike.errorFlags = (bike.errorFlags & ~ERR_CHARGING_MASK) | rippleAnalysisFaults();
+  bike.engineRpm  = rippleAnalysisRpm();
 
   // FIX #4 + #6: Safety priorities (kill switch, sidestand, ignition)
   safetyApplyPriorities();
@@ -205,30 +213,73 @@ void loop() {
   updateAuxOutputs();
   updateParkingLight();
   updateAlarm();
+  outputsArbitrate();
+  controlOutputsWritten();
+  lampMonitorUpdate(now);
+  bike.lampFaults = lampMonitorFaults();
 
-  // BLE GATT + Web Dashboard updates
-  bleUpdate();
-  webUpdate();
-
-  // Check for BLE settings update
+  // Check for BLE settings update (persisted by the comms task)
   if (bleHasNewSettings()) {
     settings = bleGetNewSettings();
-    saveSettings();
+    inputsApplyDebounceProfile();
+    requestSaveSettings();
     LOG_I("Settings updated via BLE");
   }
+  if (webHasNewSettings()) {
+    settings = webGetNewSettings();
+    inputsApplyDebounceProfile();
+    requestSaveSettings();
+  }
 
   // Status LED: blink when ignition on, fast blink on error
-  if (bike.errorFlags != ERR_NONE) {
+  if (bike.errorFlags != ERR_NONE || bike.lampFaults) {
     // Fast blink on error (5Hz)
-    digitalWrite(LED_STATUS, (millis() % 200) < 100 ? HIGH : LOW);
+    DurationUs phase = now % usFromMs(200);
+    digitalWrite(LED_STATUS, phase < usFromMs(100) ? HIGH : LOW);
+    controlWakeAt(now - now % usFromMs(100) + usFromMs(100));
   } else if (bike.ignitionOn) {
     // Slow blink when ignition on
-    digitalWrite(LED_STATUS,
-        (millis() % STATUS_LED_PERIOD_MS) < STATUS_LED_ON_MS ? HIGH : LOW);
+    DurationUs phase = now % usFromMs(STATUS_LED_PERIOD_MS);
+    bool on = phase < usFromMs(STATUS_LED_ON_MS);
+    digitalWrite(LED_STATUS, on ? HIGH : LOW);
+    controlWakeAt(now - phase + usFromMs(on ? STATUS_LED_ON_MS : STATUS_LED_PERIOD_MS));
   } else {
     digitalWrite(LED_STATUS, LOW);
   }
 
-  // Yield to FreeRTOS scheduler (non-blocking, replaces delay(10))
-  vTaskDelay(pdMS_TO_TICKS(1));
+  TimeUs due;
+  if (schedNextDue(SCHED_CONTROL, due)) controlWakeAt(due);
+
+  // Parked: sleep until an input edge, a pending command or the next deadline
+  controlSetFixedRate(bike.ignitionOn || bike.alarmTriggered ||
+                      bike.calibrationState != CALIB_IDLE);
+}
+
+// ============================================================================
+// COMMS TICK (core 0, every COMMS_PERIOD_MS)
+// ============================================================================
+
+// Track previous engine state for keyless grace trigger
+static bool prevEngineRunning = false;
+static bool prevKeylessAllowed = false;
+
+static void commsTick() {
+  // BLE GATT notify, keyless scan / grace, WebSocket broadcasts, NVS flush
+  // (notify / broadcasts / NVS are shed once COMMS_BUDGET_US is spent)
+  schedRun(SCHED_COMMS);
+
+  // BLE Keyless: proximity state machine
+  bleKeylessUpdate();
+
+  // Detect engine-off transition → trigger keyless grace period
+  bool engineRunning = bike.engineRunning;
+  if (prevEngineRunning && !engineRunning) {
+    bleKeylessEngineOff();
+  }
+  prevEngineRunning = engineRunning;
+
+  // Keyless grant changed → let a parked control task react now
+  bool allowed = bleKeylessIgnitionAllowed();
+  if (allowed != prevKeylessAllowed) controlWake();
+  prevKeylessAllowed = allowed;
 }
@@ -1,8 +1,175 @@
 #include "outputs.h"
+#include <soc/gpio_reg.h>
+#include <soc/gpio_sig_map.h>
+#include <esp_rom_gpio.h>
+#include <esp_timer.h>
+#include <driver/ledc.h>
 
-// Track which pins have PWM attached
-static bool pwmAttached[MAX_PIN] = {};
-static uint8_t pinToChannel[MAX_PIN] = {};
+// Track which pins have PWM attached (pad routed to LEDC)
+static volatile bool pwmAttached[MAX_PIN] = {};
+static int8_t pinToChannel[MAX_PIN];
+
+// ============================================================================
+// LEDC CHANNEL POOL
+// Channels are handed out on first PWM use and stay with their pin, so
+// switching between PWM and on/off is just a duty write (0 or full).
+// Channel pairs (0/1, 2/3, …) share a timer and must agree on frequency
+// and resolution. A channel is only reclaimed when the pool is exhausted.
+// ============================================================================
+
+struct PwmChannel {
+  int8_t   pin;        // -1 = free
+  uint8_t  bits;
+  uint32_t freqHz;
+  uint8_t  duty;       // Last 8-bit duty written
+  uint32_t lastPwmMs;  // Last fractional duty, for eviction order
+};
+
+static PwmChannel channels[PWM_CHANNEL_COUNT];
+static uint32_t   outFreqHz[OUTPUT_PIN_COUNT];
+static uint8_t    outBits[OUTPUT_PIN_COUNT];
+
+// ============================================================================
+// OUTPUT WORD
+// outputOn()/outputOff() only edit a target word; outputsCommit() writes the
+// difference to the hardware with one W1TS and one W1TC store per bank.
+// Bank 0 = GPIO 0-31, bank 1 = GPIO 32-48. PWM-owned pins are masked out.
+// The brake / kill ISRs edit the same words on this core: every
+// read-modify-write of a bank holds outMux.
+// ============================================================================
+
+struct OutputBank {
+  uint32_t target;    // Wanted level this tick
+  uint32_t applied;   // Level last written to the pad
+  uint32_t dirty;     // Force a write (pad state unknown, e.g. after PWM)
+  uint32_t pwm;       // Pins routed to LEDC – never touched here
+  uint32_t fastOn;    // Fast-path levels, kept over every commit until
+  uint32_t fastOff;   // inputsSample() has taken the ISR's latch
+};
+
+static OutputBank banks[2] = {};
+static portMUX_TYPE outMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void outputsCommit();
+
+// Arbitration state: per-layer requests (bit i = OUTPUT_PINS[i] claimed)
+static int8_t      pinToOutput[MAX_PIN];
+static uint16_t    reqMask[LAYER_COUNT] = {};
+static uint8_t     reqDuty[LAYER_COUNT][OUTPUT_PIN_COUNT] = {};
+static const LightPattern* reqPattern[LAYER_COUNT][OUTPUT_PIN_COUNT] = {};
+static uint8_t     resolvedDuty[OUTPUT_PIN_COUNT] = {};
+static OutputLayer resolvedLayer[OUTPUT_PIN_COUNT];
+
+static const char* const LAYER_NAMES[LAYER_COUNT] = {
+  "safety", "service", "alarm", "hazard", "user", "parking"
+};
+
+static const uint32_t SET_REG[2] = { GPIO_OUT_W1TS_REG, GPIO_OUT1_W1TS_REG };
+static const uint32_t CLR_REG[2] = { GPIO_OUT_W1TC_REG, GPIO_OUT1_W1TC_REG };
+
+static inline OutputBank& bankOf(int pin, uint32_t& bit) {
+  bit = 1u << (pin & 31);
+  return banks[pin >> 5];
+}
+
+// 8-bit duty → channel resolution (0 and 255 map to fully off / on)
+static inline void channelWrite(int ch, uint8_t duty) {
+  uint32_t max = (1u << channels[ch].bits) - 1;
+  channels[ch].duty = duty;
+  ledcWrite(ch, ((uint32_t)duty * max + 127) / 255);
+}
+
+// ============================================================================
+// PATTERN PLAYER
+// A one-shot esp_timer per output evaluates the pattern at the elapsed time
+// since start, writes LEDC and re-arms for the next segment boundary.
+// Evaluating from the absolute start keeps outputs started together in
+// phase (hazard) however late a callback runs. No float anywhere.
+// ============================================================================
+
+struct PatternPlayer {
+  esp_timer_handle_t  timer;
+  const LightPattern* pattern;   // nullptr = idle (checked under outMux)
+  int64_t             startUs;
+  uint8_t             channel;
+  uint8_t             duty;      // Last duty written, for the dashboard
+};
+
+static PatternPlayer players[OUTPUT_PIN_COUNT] = {};
+
+// Write the duty for the current time and arm for the next change.
+// Caller holds outMux.
+static void patternStep(PatternPlayer& p, int64_t nowUs) {
+  uint32_t elapsedMs = (uint32_t)((nowUs - p.startUs) / 1000);
+  uint32_t msToNext;
+  p.duty = patternEvalLocked(*p.pattern, elapsedMs, &msToNext);
+  channelWrite(p.channel, p.duty);
+  if (msToNext != PATTERN_NEVER) {
+    // Align to the absolute boundary, not "now + segment"
+    int64_t dueUs = p.startUs + (int64_t)(elapsedMs + msToNext) * 1000;
+    esp_timer_start_once(p.timer, dueUs > nowUs ? dueUs - nowUs : 1);
+  }
+}
+
+// esp_timer task context
+static void patternTick(void* arg) {
+  PatternPlayer& p = *static_cast<PatternPlayer*>(arg);
+  portENTER_CRITICAL(&outMux);
+  if (p.pattern) patternStep(p, esp_timer_get_time());
+  portEXIT_CRITICAL(&outMux);
+}
+
+static void patternStop(int idx) {
+  PatternPlayer& p = players[idx];
+  if (!p.pattern) return;
+  portENTER_CRITICAL(&outMux);
+  p.pattern = nullptr;
+  esp_timer_stop(p.timer);
+  portEXIT_CRITICAL(&outMux);
+}
+
+static void outputPWM(int pin, uint8_t duty);
+
+// Attach the pin to LEDC and start the pattern at startUs
+static void patternStart(int idx, const LightPattern* pattern, int64_t startUs) {
+  PatternPlayer& p = players[idx];
+  int pin = OUTPUT_PINS[idx];
+
+  uint32_t unused;
+  outputPWM(pin, patternEvalLocked(*pattern, 0, &unused));
+  if (!pwmAttached[pin]) return;              // Pin has no LEDC channel
+
+  if (!p.timer) {
+    esp_timer_create_args_t args = {};
+    args.callback = patternTick;
+    args.arg      = &p;
+    args.name     = "pattern";
+    if (esp_timer_create(&args, &p.timer) != ESP_OK) return;
+  }
+  portENTER_CRITICAL(&outMux);
+  p.pattern = pattern;
+  p.startUs = startUs;
+  p.channel = pinToChannel[pin];
+  patternStep(p, startUs);
+  portEXIT_CRITICAL(&outMux);
+}
+
+// Hand a pin back from LEDC to the output word at the channel's last level
+// (channelAttach() cleared its word bit), so an arbitration pass that is
+// already past this pin does not commit a lit lamp off
+static void releasePwm(int pin, bool on) {
+  ledcDetachPin(pin);
+  pwmAttached[pin] = false;
+  pinMode(pin, OUTPUT);
+  uint32_t bit;
+  OutputBank& b = bankOf(pin, bit);
+  portENTER_CRITICAL(&outMux);
+  if (on) b.target |= bit;
+  else    b.target &= ~bit;
+  b.pwm   &= ~bit;
+  b.dirty |= bit;
+  portEXIT_CRITICAL(&outMux);
+}
 
 // ============================================================================
 // CRITICAL: Early init – called FIRST in setup(), before Serial, before anything
@@ -17,6 +184,19 @@ void outputsInitEarly() {
     pinMode(OUTPUT_PINS[i], OUTPUT);
     digitalWrite(OUTPUT_PINS[i], LOW);
   }
+  // Output word starts all-off, matching the pads
+  banks[0] = OutputBank{};
+  banks[1] = OutputBank{};
+
+  for (int pin = 0; pin < MAX_PIN; pin++) {
+    pinToOutput[pin]  = -1;
+    pinToChannel[pin] = -1;
+  }
+  for (int i = 0; i < OUTPUT_PIN_COUNT; i++) {
+    pinToOutput[OUTPUT_PINS[i]] = (int8_t)i;
+    resolvedLayer[i] = LAYER_NONE;
+  }
+
   // Status LED off
   pinMode(LED_STATUS, OUTPUT);
   digitalWrite(LED_STATUS, LOW);
@@ -27,70 +207,369 @@ void outputsInitEarly() {
 // ============================================================================
 
 void outputsInitPWM() {
-  // Brake light PWM (for BRAKE_FADE mode + rear light dimming)
-  ledcSetup(PWM_CHANNEL_BRAKE, PWM_FREQ_HZ, PWM_RESOLUTION_BITS);
+  for (int ch = 0; ch < PWM_CHANNEL_COUNT; ch++) {
+    channels[ch] = PwmChannel{ -1, PWM_RESOLUTION_BITS, PWM_FREQ_HZ, 0, 0 };
+  }
+  for (int i = 0; i < OUTPUT_PIN_COUNT; i++) {
+    outFreqHz[i] = PWM_FREQ_HZ;
+    outBits[i]   = PWM_RESOLUTION_BITS;
+  }
+}
+
+// Ignition and starters are switched only – the kill fast path writes
+// their pads through the GPIO register and must never find them on LEDC
+static bool pwmCapable(int pin) {
+  return pin != PIN_IGN_OUT && pin != PIN_START_OUT1 && pin != PIN_START_OUT2;
+}
+
+static bool timerCompatible(int ch, uint32_t freqHz, uint8_t bits) {
+  const PwmChannel& sibling = channels[ch ^ 1];
+  return sibling.pin < 0 || (sibling.freqHz == freqHz && sibling.bits == bits);
+}
+
+// Return a channel to the pool, handing its pin back to the output word
+static void channelFree(int ch) {
+  int pin = channels[ch].pin;
+  if (pin < 0) return;
+  if (pwmAttached[pin]) releasePwm(pin, channels[ch].duty != DUTY_OFF);
+  pinToChannel[pin] = -1;
+  channels[ch].pin  = -1;
+}
+
+static int channelAlloc(int pin) {
+  int idx = pinToOutput[pin];
+  uint32_t freqHz = outFreqHz[idx];
+  uint8_t  bits   = outBits[idx];
+
+  int ch = -1;
+  for (int c = 0; c < PWM_CHANNEL_COUNT && ch < 0; c++) {
+    if (channels[c].pin < 0 && timerCompatible(c, freqHz, bits)) ch = c;
+  }
+  if (ch < 0) {
+    // Pool exhausted: take the channel whose pin has been plain on/off the
+    // longest and is not animating
+    uint32_t oldest = UINT32_MAX;
+    for (int c = 0; c < PWM_CHANNEL_COUNT; c++) {
+      const PwmChannel& pc = channels[c];
+      if (pc.pin < 0 || !timerCompatible(c, freqHz, bits)) continue;
+      if (pc.duty != DUTY_OFF && pc.duty != DUTY_ON) continue;
+      if (players[pinToOutput[pc.pin]].pattern) continue;
+      if (pc.lastPwmMs < oldest) { oldest = pc.lastPwmMs; ch = c; }
+    }
+    if (ch < 0) return -1;
+    channelFree(ch);
+  }
+
+  ledcSetup(ch, freqHz, bits);
+  channels[ch] = PwmChannel{ (int8_t)pin, bits, freqHz, DUTY_OFF, millis() };
+  pinToChannel[pin] = (int8_t)ch;
+  return ch;
+}
 
-  // Position light PWM
-  ledcSetup(PWM_CHANNEL_POSITION, PWM_FREQ_HZ, PWM_RESOLUTION_BITS);
+// Route the pad to its channel (first use, or after the brake fast path).
+// A pad the fast path holds on GPIO stays there until the hold is released.
+static void channelAttach(int pin, int ch) {
+  if (pwmAttached[pin]) return;
+  uint32_t bit;
+  OutputBank& b = bankOf(pin, bit);
+  if (b.fastOn & bit) return;
+  ledcAttachPin(pin, ch);
+  portENTER_CRITICAL(&outMux);
+  if (b.fastOn & bit) {
+    // The ISR fired during the attach: give the pad back to its GPIO level
+    esp_rom_gpio_connect_out_signal(pin, SIG_GPIO_OUT_IDX, false, false);
+  } else {
+    pwmAttached[pin] = true;
+    b.pwm    |= bit;
+    b.target &= ~bit;
+  }
+  portEXIT_CRITICAL(&outMux);
+}
 
-  // Turn signal PWM (for mo.wave sequential animation)
-  ledcSetup(PWM_CHANNEL_TURNL, PWM_FREQ_HZ, PWM_RESOLUTION_BITS);
-  ledcSetup(PWM_CHANNEL_TURNR, PWM_FREQ_HZ, PWM_RESOLUTION_BITS);
+bool outputSetPwmConfig(int pin, uint32_t freqHz, uint8_t resolutionBits) {
+  if (pin < 0 || pin >= MAX_PIN || pinToOutput[pin] < 0 || !pwmCapable(pin)) return false;
+  if (freqHz == 0 || resolutionBits < 1 || resolutionBits > PWM_RESOLUTION_MAX_BITS) return false;
+  int idx = pinToOutput[pin];
+  outFreqHz[idx] = freqHz;
+  outBits[idx]   = resolutionBits;
+  // Re-allocated with the new timer settings on the next PWM request
+  int ch = pinToChannel[pin];
+  if (ch >= 0 && (channels[ch].freqHz != freqHz || channels[ch].bits != resolutionBits)) {
+    patternStop(idx);
+    channelFree(ch);
+  }
+  return true;
 }
 
 // ============================================================================
 // BASIC OUTPUT CONTROL
+// A pin that owns a channel stays on LEDC: on/off is duty full / 0.
+// Other pins go through the output word.
 // ============================================================================
 
-void outputOn(int pin) {
-  // If PWM is attached to this pin, detach first
-  if (pin >= 0 && pin < MAX_PIN && pwmAttached[pin]) {
-    ledcDetachPin(pin);
-    pwmAttached[pin] = false;
-    pinMode(pin, OUTPUT);
+static void outputLevel(int pin, bool on) {
+  if (pin < 0 || pin >= MAX_PIN) return;
+  int ch = pinToChannel[pin];
+  if (ch >= 0) {
+    channelAttach(pin, ch);
+    channelWrite(ch, on ? DUTY_ON : DUTY_OFF);
+    return;
   }
-  digitalWrite(pin, HIGH);
+  uint32_t bit;
+  OutputBank& b = bankOf(pin, bit);
+  portENTER_CRITICAL(&outMux);
+  if (on) b.target |= bit;
+  else    b.target &= ~bit;
+  portEXIT_CRITICAL(&outMux);
 }
 
-void outputOff(int pin) {
-  if (pin >= 0 && pin < MAX_PIN && pwmAttached[pin]) {
-    ledcDetachPin(pin);
-    pwmAttached[pin] = false;
-    pinMode(pin, OUTPUT);
-  }
-  digitalWrite(pin, LOW);
+static void outputOn(int pin)  { outputLevel(pin, true); }
+static void outputOff(int pin) { outputLevel(pin, false); }
+
+bool outputState(int pin) {
+  if (pin < 0 || pin >= MAX_PIN) return false;
+  uint32_t bit;
+  OutputBank& b = bankOf(pin, bit);
+  if (b.pwm & bit) return channels[pinToChannel[pin]].duty != DUTY_OFF;
+  return (b.target & bit) != 0;
 }
 
-void outputPWM(int pin, uint8_t duty) {
+static void outputPWM(int pin, uint8_t duty) {
   if (pin < 0 || pin >= MAX_PIN) return;
 
-  uint8_t channel = 0;
-  if (pin == PIN_BRAKE_OUT) {
-    channel = PWM_CHANNEL_BRAKE;
-  } else if (pin == PIN_LIGHT_OUT) {
-    channel = PWM_CHANNEL_POSITION;
-  } else if (pin == PIN_TURNL_OUT) {
-    channel = PWM_CHANNEL_TURNL;
-  } else if (pin == PIN_TURNR_OUT) {
-    channel = PWM_CHANNEL_TURNR;
-  } else {
-    // Unsupported pin for PWM – fall back to on/off
+  int ch = pinToChannel[pin];
+  if (ch < 0 && pwmCapable(pin) && pinToOutput[pin] >= 0) ch = channelAlloc(pin);
+  if (ch < 0) {
+    // No channel for this pin – fall back to on/off
     if (duty > 127) outputOn(pin);
     else outputOff(pin);
     return;
   }
 
-  if (!pwmAttached[pin]) {
-    ledcAttachPin(pin, channel);
-    pwmAttached[pin] = true;
-    pinToChannel[pin] = channel;
+  channelAttach(pin, ch);
+  channelWrite(ch, duty);
+  if (duty != DUTY_OFF && duty != DUTY_ON) channels[ch].lastPwmMs = millis();
+}
+
+// ============================================================================
+// ARBITER
+// ============================================================================
+
+void outputRequest(OutputLayer layer, int pin, uint8_t duty) {
+  if (layer >= LAYER_COUNT || pin < 0 || pin >= MAX_PIN) return;
+  int idx = pinToOutput[pin];
+  if (idx < 0) return;
+  reqMask[layer] |= (uint16_t)(1u << idx);
+  reqDuty[layer][idx] = duty;
+  reqPattern[layer][idx] = nullptr;
+}
+
+void outputRequestPattern(OutputLayer layer, int pin, const LightPattern& pattern) {
+  outputRequest(layer, pin, DUTY_OFF);
+  int idx = pin >= 0 && pin < MAX_PIN ? pinToOutput[pin] : -1;
+  if (layer < LAYER_COUNT && idx >= 0 && pattern.count) reqPattern[layer][idx] = &pattern;
+}
+
+void outputsArbitrate() {
+  int64_t nowUs = esp_timer_get_time();   // Common start for patterns begun this pass
+  for (int i = 0; i < OUTPUT_PIN_COUNT; i++) {
+    uint16_t bit = (uint16_t)(1u << i);
+    OutputLayer winner = LAYER_NONE;
+    uint8_t duty = DUTY_OFF;
+    const LightPattern* pattern = nullptr;
+    for (uint8_t l = 0; l < LAYER_COUNT; l++) {
+      if (reqMask[l] & bit) {
+        winner = (OutputLayer)l;
+        duty    = reqDuty[l][i];
+        pattern = reqPattern[l][i];
+        break;
+      }
+    }
+    resolvedLayer[i] = winner;
+    resolvedDuty[i]  = duty;
+
+    // Pattern keeps running untouched while the same claim keeps winning
+    if (pattern && players[i].pattern == pattern && pwmAttached[OUTPUT_PINS[i]]) {
+      resolvedDuty[i] = players[i].duty;
+      continue;
+    }
+    patternStop(i);
+    if (pattern) {
+      patternStart(i, pattern, nowUs);
+      if (players[i].pattern == pattern) {
+        resolvedDuty[i] = players[i].duty;
+        continue;
+      }
+      duty = resolvedDuty[i] = DUTY_ON;       // No LEDC channel: solid on
+    }
+
+    int pin = OUTPUT_PINS[i];
+    if (duty == DUTY_OFF)     outputOff(pin);
+    else if (duty == DUTY_ON) outputOn(pin);
+    else                      outputPWM(pin, duty);
+  }
+
+  for (uint8_t l = 0; l < LAYER_COUNT; l++) reqMask[l] = 0;
+  outputsCommit();
+}
+
+uint8_t outputDuty(int pin) {
+  if (pin < 0 || pin >= MAX_PIN || pinToOutput[pin] < 0) return DUTY_OFF;
+  int idx = pinToOutput[pin];
+  return players[idx].pattern ? players[idx].duty : resolvedDuty[idx];
+}
+
+OutputLayer outputWinner(int pin) {
+  if (pin < 0 || pin >= MAX_PIN || pinToOutput[pin] < 0) return LAYER_NONE;
+  return resolvedLayer[pinToOutput[pin]];
+}
+
+const char* outputLayerName(OutputLayer layer) {
+  return layer < LAYER_COUNT ? LAYER_NAMES[layer] : "none";
+}
+
+// ============================================================================
+// COMMIT – one set + one clear register store per bank, changed pins only
+// ============================================================================
+
+static void outputsCommit() {
+  portENTER_CRITICAL(&outMux);
+  for (int i = 0; i < 2; i++) {
+    OutputBank& b = banks[i];
+    // An ISR level not yet seen by inputsSample() outranks this pass
+    b.target = (b.target | b.fastOn) & ~b.fastOff;
+    uint32_t changed = ((b.target ^ b.applied) | b.dirty) & ~b.pwm;
+    if (!changed) continue;
+    uint32_t set = changed & b.target;
+    uint32_t clr = changed & ~b.target;
+    if (set) REG_WRITE(SET_REG[i], set);
+    if (clr) REG_WRITE(CLR_REG[i], clr);
+    b.applied = (b.applied & ~changed) | set;
+    b.dirty   = 0;
   }
-  ledcWrite(channel, duty);
+  portEXIT_CRITICAL(&outMux);
+}
+
+// ============================================================================
+// SAFETY FAST PATH (called from brake / kill edge ISRs)
+// Writes the pad directly and keeps the output word in sync. The level is
+// also held in fastOn / fastOff: an arbitration that ran on inputs sampled
+// before the edge must not undo it. inputsSample() releases the hold when it
+// takes the ISR's latch, so from then on the debounced input owns the pin.
+// ============================================================================
+
+static inline void IRAM_ATTR gpioFastWrite(int pin, bool level) {
+  uint32_t bit = 1u << (pin & 31);
+  OutputBank& b = banks[pin >> 5];
+  if (pin < 32) {
+    REG_WRITE(level ? GPIO_OUT_W1TS_REG : GPIO_OUT_W1TC_REG, bit);
+  } else {
+    REG_WRITE(level ? GPIO_OUT1_W1TS_REG : GPIO_OUT1_W1TC_REG, bit);
+  }
+  if (level) { b.applied |= bit;  b.target |= bit;  b.fastOn |= bit;  b.fastOff &= ~bit; }
+  else       { b.applied &= ~bit; b.target &= ~bit; b.fastOff |= bit; b.fastOn &= ~bit;  }
+}
+
+void IRAM_ATTR outputsFastBrakeOn() {
+  portENTER_CRITICAL_ISR(&outMux);
+  // The brake logic already has the press and the light is full on or
+  // playing its pattern (a bounce edge): leave output and pattern phase alone
+  PatternPlayer& p = players[pinToOutput[PIN_BRAKE_OUT]];
+  uint32_t bit = 1u << (PIN_BRAKE_OUT & 31);
+  bool lit = pwmAttached[PIN_BRAKE_OUT]
+           ? channels[pinToChannel[PIN_BRAKE_OUT]].duty == DUTY_ON
+           : (banks[PIN_BRAKE_OUT >> 5].applied & bit) != 0;
+  if (bike.brakePressed && (lit || p.pattern)) {
+    portEXIT_CRITICAL_ISR(&outMux);
+    return;
+  }
+  if (p.pattern) {
+    // A pattern the arbitration has not stopped yet (release accepted this
+    // pass). esp_timer_stop() is in IRAM and ISR-safe; without it the next
+    // patternStart() would find the timer still armed.
+    p.pattern = nullptr;
+    esp_timer_stop(p.timer);
+  }
+  if (pwmAttached[PIN_BRAKE_OUT]) {
+    // Route the pad back to the GPIO output register (same as ledcDetachPin)
+    esp_rom_gpio_connect_out_signal(PIN_BRAKE_OUT, SIG_GPIO_OUT_IDX, false, false);
+    pwmAttached[PIN_BRAKE_OUT] = false;
+    banks[PIN_BRAKE_OUT >> 5].pwm &= ~(1u << (PIN_BRAKE_OUT & 31));
+  }
+  gpioFastWrite(PIN_BRAKE_OUT, true);
+  portEXIT_CRITICAL_ISR(&outMux);
+}
+
+void IRAM_ATTR outputsFastKill() {
+  portENTER_CRITICAL_ISR(&outMux);
+  gpioFastWrite(PIN_IGN_OUT,    false);
+  gpioFastWrite(PIN_START_OUT1, false);
+  gpioFastWrite(PIN_START_OUT2, false);
+  portEXIT_CRITICAL_ISR(&outMux);
+}
+
+void outputsFastRelease(bool brake, bool kill) {
+  portENTER_CRITICAL(&outMux);
+  if (brake) banks[PIN_BRAKE_OUT >> 5].fastOn &= ~(1u << (PIN_BRAKE_OUT & 31));
+  if (kill) {
+    for (int pin : { PIN_IGN_OUT, PIN_START_OUT1, PIN_START_OUT2 }) {
+      banks[pin >> 5].fastOff &= ~(1u << (pin & 31));
+    }
+  }
+  portEXIT_CRITICAL(&outMux);
 }
 
 void outputsAllOff() {
   for (int i = 0; i < OUTPUT_PIN_COUNT; i++) {
+    patternStop(i);
     outputOff(OUTPUT_PINS[i]);
   }
+  outputsCommit();
   digitalWrite(LED_STATUS, LOW);
 }
+
+// ============================================================================
+// LIGHT SLEEP
+// LEDC only keeps counting in light sleep when clocked from RC_FAST, and all
+// low-speed timers share one source, so every timer in use moves over for
+// the sleep and back afterwards (a single-period glitch). Pattern timers do
+// not run asleep, so the sleep is refused while one plays. Outputs on the
+// GPIO word hold their pad level on their own.
+// ============================================================================
+
+static uint8_t slowTimers = 0;   // Bit per LEDC timer (channel pair)
+
+static bool timerClock(int timer, ledc_clk_cfg_t clk) {
+  const PwmChannel& c = channels[timer * 2].pin >= 0 ? channels[timer * 2] : channels[timer * 2 + 1];
+  ledc_timer_config_t cfg = {};
+  cfg.speed_mode      = LEDC_LOW_SPEED_MODE;
+  cfg.duty_resolution = (ledc_timer_bit_t)c.bits;
+  cfg.timer_num       = (ledc_timer_t)timer;
+  cfg.freq_hz         = c.freqHz;
+  cfg.clk_cfg         = clk;
+  return ledc_timer_config(&cfg) == ESP_OK;
+}
+
+int outputsSleepPrepare() {
+  for (int i = 0; i < OUTPUT_PIN_COUNT; i++) {
+    if (players[i].pattern) return -1;
+  }
+  for (int ch = 0; ch < PWM_CHANNEL_COUNT; ch++) {
+    uint8_t bit = 1u << (ch / 2);
+    if (channels[ch].pin < 0 || (slowTimers & bit)) continue;
+    slowTimers |= bit;
+    if (!timerClock(ch / 2, LEDC_USE_RTC8M_CLK)) {
+      // Frequency × resolution beyond RC_FAST: stay awake
+      outputsSleepRelease();
+      return -1;
+    }
+  }
+  return __builtin_popcount(slowTimers);
+}
+
+void outputsSleepRelease() {
+  for (int t = 0; t < PWM_CHANNEL_COUNT / 2; t++) {
+    if (slowTimers & (1u << t)) timerClock(t, LEDC_AUTO_CLK);
+  }
+  slowTimers = 0;
+}
@@ -0,0 +1,215 @@
+#include "power_mode.h"
+#include "outputs.h"
+#include "battery_adc.h"
+#include "scheduler.h"
+#include "settings_store.h"
+#include "ble_interface.h"
+#include "web_server.h"
+#include <driver/gpio.h>
+#include <esp_sleep.h>
+#include <esp_timer.h>
+
+static const gpio_num_t WAKE_PINS[] = { (gpio_num_t)PIN_LOCK, (gpio_num_t)PIN_VIBRATION };
+static constexpr int    WAKE_PIN_COUNT = sizeof(WAKE_PINS) / sizeof(WAKE_PINS[0]);
+
+static const char* const MODE_NAMES[] = { "active", "parked", "sleep" };
+
+// Comms task
+static volatile PowerMode mode = POWER_ACTIVE;
+static TimeUs parkSince  = 0;
+static bool   windowOpen = false;
+static TimeUs windowEnd  = 0;
+
+// Comms → control: light sleep allowed until windowAt
+static portMUX_TYPE powerMux = portMUX_INITIALIZER_UNLOCKED;
+static bool     sleepOk  = false;
+static TimeUs   windowAt = 0;
+static uint64_t sleptUs  = 0;
+
+static struct {
+  uint32_t entries        = 0;   // PARKED → SLEEP
+  uint32_t windows        = 0;
+  uint32_t sleeps         = 0;
+  uint32_t timerWakes     = 0;
+  uint32_t lockWakes      = 0;
+  uint32_t vibrationWakes = 0;
+  uint32_t refused        = 0;   // Pattern playing, RC_FAST out of range, rejected
+  uint32_t lastSleepMs    = 0;
+} stats;
+
+static void setSleepWindow(bool ok, TimeUs at) {
+  portENTER_CRITICAL(&powerMux);
+  sleepOk  = ok;
+  windowAt = at;
+  portEXIT_CRITICAL(&powerMux);
+}
+
+// ============================================================================
+// MODE / WINDOW JOB (comms task)
+// ============================================================================
+
+// Anything that needs the radios or a responsive loop keeps the bike awake
+static bool parkHold() {
+  return bike.alarmTriggered || bike.inSetupMode || bike.calibrationState != CALIB_IDLE ||
+         bike.bleConnected || webClientCount() > 0 || bleKeylessBusy() ||
+         settingsSavePending();
+}
+
+static void enterMode(PowerMode m, TimeUs now, const char* why) {
+  if (m == mode) return;
+  if (mode == POWER_SLEEP) {
+    setSleepWindow(false, 0);
+    windowOpen = false;
+    bleParkMode(false);
+    webApStart();
+    LOG_I("Parked: awake (%s), radios up", why);
+  }
+  if (m == POWER_SLEEP) {
+    webApStop();
+    bleParkMode(true);
+    windowOpen = false;
+    setSleepWindow(true, now + usFromMs(PARK_CYCLE_MS));
+    stats.entries++;
+    LOG_I("Parked: light sleep, BLE %u ms every %u s", PARK_WINDOW_MS, PARK_CYCLE_MS / 1000);
+  }
+  parkSince = now;
+  mode = m;
+}
+
+static void powerJob(TimeUs now) {
+  if (bike.ignitionOn) {
+    enterMode(POWER_ACTIVE, now, "ignition");
+    return;
+  }
+  if (mode == POWER_ACTIVE) enterMode(POWER_PARKED, now, nullptr);
+
+  if (parkHold() || !settings.parkSleepMin) {
+    enterMode(POWER_PARKED, now, "activity");
+    parkSince = now;                                 // Delay restarts once quiet
+    return;
+  }
+  if (mode == POWER_PARKED) {
+    if (now - parkSince >= usFromMs(settings.parkSleepMin * 60000UL)) {
+      enterMode(POWER_SLEEP, now, nullptr);
+    }
+    return;
+  }
+
+  // Asleep: the control task stays awake from windowAt until the window
+  // has been opened here, and sleeps again once it is closed
+  if (!windowOpen) {
+    portENTER_CRITICAL(&powerMux);
+    TimeUs at = windowAt;
+    portEXIT_CRITICAL(&powerMux);
+    if (now < at) return;
+    setSleepWindow(false, at);
+    bleParkWindow(true);
+    windowOpen = true;
+    windowEnd  = now + usFromMs(PARK_WINDOW_MS);
+    stats.windows++;
+  } else if (now >= windowEnd && !bleKeylessScanning()) {
+    bleParkWindow(false);
+    windowOpen = false;
+    setSleepWindow(true, now + usFromMs(PARK_CYCLE_MS - PARK_WINDOW_MS));
+  }
+}
+
+// ============================================================================
+// LIGHT SLEEP (control task)
+// ============================================================================
+
+bool powerSleepUntil(TimeUs deadline) {
+  portENTER_CRITICAL(&powerMux);
+  bool   ok = sleepOk;
+  TimeUs at = windowAt;
+  portEXIT_CRITICAL(&powerMux);
+  if (!ok) return false;
+
+  TimeUs now   = timeNow();
+  TimeUs until = deadline < at ? deadline : at;
+  if (until - now < usFromMs(PARK_SLEEP_MIN_MS)) return false;
+
+  int slow = outputsSleepPrepare();
+  if (slow < 0) {
+    stats.refused++;
+    return false;
+  }
+  esp_sleep_pd_config(ESP_PD_DOMAIN_RTC8M, slow ? ESP_PD_OPTION_ON : ESP_PD_OPTION_AUTO);
+  batteryAdcSleepPrepare();                          // SAR would stay powered
+
+  // Wake on any change: arm the level each pin is not at now. The edge
+  // interrupts are masked meanwhile – a level type would fire on wake-up.
+  int level[WAKE_PIN_COUNT];
+  for (int i = 0; i < WAKE_PIN_COUNT; i++) {
+    level[i] = gpio_get_level(WAKE_PINS[i]);
+    gpio_intr_disable(WAKE_PINS[i]);
+    gpio_wakeup_enable(WAKE_PINS[i], level[i] ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+  }
+  esp_sleep_enable_gpio_wakeup();
+  esp_sleep_enable_timer_wakeup(until - now);
+
+  int64_t   startUs = esp_timer_get_time();
+  esp_err_t err     = esp_light_sleep_start();
+  int64_t   dur     = esp_timer_get_time() - startUs;
+
+  esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);
+  for (int i = 0; i < WAKE_PIN_COUNT; i++) {
+    gpio_wakeup_disable(WAKE_PINS[i]);
+    gpio_set_intr_type(WAKE_PINS[i], GPIO_INTR_ANYEDGE);
+    gpio_intr_enable(WAKE_PINS[i]);
+  }
+  outputsSleepRelease();
+  batteryAdcSleepRelease();
+
+  if (err != ESP_OK) {
+    stats.refused++;
+    return false;
+  }
+
+  portENTER_CRITICAL(&powerMux);
+  sleptUs += dur;
+  portEXIT_CRITICAL(&powerMux);
+  stats.sleeps++;
+  stats.lastSleepMs = (uint32_t)(dur / 1000);
+  if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_GPIO)      stats.timerWakes++;
+  else if (gpio_get_level(WAKE_PINS[0]) != level[0])             stats.lockWakes++;
+  else                                                           stats.vibrationWakes++;
+  return true;
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+void powerModeInit() {
+  // Outputs and the status LED keep their active pad config while asleep
+  for (int i = 0; i < OUTPUT_PIN_COUNT; i++) gpio_sleep_sel_dis((gpio_num_t)OUTPUT_PINS[i]);
+  gpio_sleep_sel_dis((gpio_num_t)LED_STATUS);
+  schedEvery(SCHED_COMMS, "power", POWER_JOB_MS, powerJob);
+}
+
+PowerMode powerMode() {
+  return mode;
+}
+
+uint64_t powerSleptUs() {
+  portENTER_CRITICAL(&powerMux);
+  uint64_t us = sleptUs;
+  portEXIT_CRITICAL(&powerMux);
+  return us;
+}
+
+void powerBuildMetricsJson(JsonDocument& doc) {
+  JsonObject p = doc["power"].to<JsonObject>();
+  p["mode"]           = MODE_NAMES[mode];
+  p["sleepAfterMin"]  = settings.parkSleepMin;
+  p["entries"]        = stats.entries;
+  p["windows"]        = stats.windows;
+  p["sleeps"]         = stats.sleeps;
+  p["sleptS"]         = (uint32_t)(powerSleptUs() / 1000000);
+  p["lastSleepMs"]    = stats.lastSleepMs;
+  p["timerWakes"]     = stats.timerWakes;
+  p["lockWakes"]      = stats.lockWakes;
+  p["vibrationWakes"] = stats.vibrationWakes;
+  p["refused"]        = stats.refused;
+}
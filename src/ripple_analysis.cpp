@@ -0,0 +1,254 @@
+#include "ripple_analysis.h"
+#include "battery_adc.h"
+#include "scheduler.h"
+
+#if __has_include(<esp_dsp.h>)
+#define RIPPLE_ESP_DSP 1
+#include <esp_dsp.h>
+#else
+#define RIPPLE_ESP_DSP 0
+#endif
+
+static constexpr int   FFT_N  = RIPPLE_FFT_SIZE;
+static constexpr float BIN_HZ = (float)VBAT_ADC_SAMPLE_HZ / FFT_N;
+static constexpr int   BIN_MIN = (RIPPLE_MIN_HZ * FFT_N + VBAT_ADC_SAMPLE_HZ - 1) / VBAT_ADC_SAMPLE_HZ;
+
+static_assert((FFT_N & (FFT_N - 1)) == 0, "RIPPLE_FFT_SIZE must be a power of two");
+
+// ============================================================================
+// FFT (complex, in place, interleaved re / im)
+// ============================================================================
+
+static float fftBuf[2 * FFT_N] __attribute__((aligned(16)));
+static float window[FFT_N];
+
+#if RIPPLE_ESP_DSP
+
+static bool fftInit() {
+  return dsps_fft2r_init_fc32(nullptr, FFT_N) == ESP_OK;
+}
+
+static void fftRun(float* x) {
+  dsps_fft2r_fc32(x, FFT_N);
+  dsps_bit_rev_fc32(x, FFT_N);
+}
+
+#else  // Portable radix-2 decimation in time
+
+static float twRe[FFT_N / 2], twIm[FFT_N / 2];
+
+static bool fftInit() {
+  for (int k = 0; k < FFT_N / 2; k++) {
+    twRe[k] =  cosf(2.0f * (float)M_PI * k / FFT_N);
+    twIm[k] = -sinf(2.0f * (float)M_PI * k / FFT_N);
+  }
+  return true;
+}
+
+static void fftRun(float* x) {
+  for (int i = 1, j = 0; i < FFT_N; i++) {
+    int bit = FFT_N >> 1;
+    for (; j & bit; bit >>= 1) j ^= bit;
+    j ^= bit;
+    if (i < j) {
+      float re = x[2 * i], im = x[2 * i + 1];
+      x[2 * i] = x[2 * j]; x[2 * i + 1] = x[2 * j + 1];
+      x[2 * j] = re;       x[2 * j + 1] = im;
+    }
+  }
+  for (int len = 2; len <= FFT_N; len <<= 1) {
+    int half = len >> 1, step = FFT_N / len;
+    for (int i = 0; i < FFT_N; i += len) {
+      for (int k = 0; k < half; k++) {
+        float  wr = twRe[k * step], wi = twIm[k * step];
+        float* a  = &x[2 * (i + k)];
+        float* b  = &x[2 * (i + k + half)];
+        float  tr = b[0] * wr - b[1] * wi;
+        float  ti = b[0] * wi + b[1] * wr;
+        b[0] = a[0] - tr; b[1] = a[1] - ti;
+        a[0] += tr;       a[1] += ti;
+      }
+    }
+  }
+}
+
+#endif
+
+// ============================================================================
+// CLASSIFIER
+// ============================================================================
+
+static float samples[FFT_N];
+static float mag[FFT_N / 2];
+
+// Strongest bin within ±1 of a line (Hann leakage)
+static float lineAt(int k) {
+  float a = mag[k];
+  if (k > 1 && mag[k - 1] > a) a = mag[k - 1];
+  if (k + 1 < FFT_N / 2 && mag[k + 1] > a) a = mag[k + 1];
+  return a;
+}
+
+static uint8_t analyse(const float* mv, RippleResult& r) {
+  float sum = 0, mn = mv[0], mx = mv[0];
+  for (int i = 0; i < FFT_N; i++) {
+    sum += mv[i];
+    if (mv[i] < mn) mn = mv[i];
+    if (mv[i] > mx) mx = mv[i];
+  }
+  float mean = sum / FFT_N;
+  r.meanV         = mean / 1000.0f;
+  r.p2pMv         = mx - mn;
+  r.fundamentalHz = 0;
+  r.thd           = 0;
+  r.rpm           = 0;
+
+  uint8_t verdict = r.meanV > RIPPLE_OVERCHARGE_V ? ERR_OVERCHARGE : 0;
+
+  for (int i = 0; i < FFT_N; i++) {
+    fftBuf[2 * i]     = (mv[i] - mean) * window[i];
+    fftBuf[2 * i + 1] = 0;
+  }
+  fftRun(fftBuf);
+
+  float peak = 0, total = 0;
+  for (int k = 1; k < FFT_N / 2; k++) {
+    mag[k] = sqrtf(fftBuf[2 * k] * fftBuf[2 * k] + fftBuf[2 * k + 1] * fftBuf[2 * k + 1]);
+    if (k < BIN_MIN) continue;
+    total += mag[k];
+    if (mag[k] > peak) peak = mag[k];
+  }
+  if (peak < RPM_LINE_SNR * total / (FFT_N / 2 - BIN_MIN)) return verdict;   // Noise only
+
+  // Fundamental: lowest local maximum at half the strongest line or more
+  int k0 = 0;
+  for (int k = BIN_MIN; k < FFT_N / 2 - 1 && !k0; k++) {
+    if (mag[k] >= 0.5f * peak && mag[k] >= mag[k - 1] && mag[k] >= mag[k + 1]) k0 = k;
+  }
+  if (!k0) return verdict;
+
+  float h2 = 0;
+  for (int h = 2; h <= 6 && k0 * h < FFT_N / 2; h++) {
+    float a = lineAt(k0 * h);
+    h2 += a * a;
+  }
+  float a = mag[k0 - 1], b = mag[k0], c = mag[k0 + 1];     // Parabolic peak
+  float d = a - 2 * b + c < 0 ? 0.5f * (a - c) / (a - 2 * b + c) : 0;
+  r.fundamentalHz = (k0 + d) * BIN_HZ;
+  r.thd           = sqrtf(h2) / mag[k0];
+
+  if (r.p2pMv >= RIPPLE_MIN_MV) {                          // Else the battery absorbs it
+    if (r.thd >= RIPPLE_DIODE_THD)       verdict |= ERR_RECT_DIODE;
+    else if (r.p2pMv >= RIPPLE_HIGH_MV)  verdict |= ERR_OPEN_PHASE;
+  }
+
+  // Ripple line → stator frequency: 6 pulses per electrical turn when healthy
+  float pulses = (verdict & ERR_RECT_DIODE) ? 1 : (verdict & ERR_OPEN_PHASE) ? 2 : 6;
+  r.rpm = r.fundamentalHz / pulses * 60.0f / settings.polePairs;
+  return verdict;
+}
+
+// ============================================================================
+// JOB (comms task, sheddable)
+// ============================================================================
+
+static RippleResult     result;
+static volatile uint8_t faults = 0;
+static uint8_t          streak[3] = {};
+static bool             capturing = false;
+static uint32_t         captures = 0;
+static uint32_t         fftUs = 0, fftUsMax = 0;
+static volatile uint16_t rpm = 0;
+static float            rpmPrev = 0;
+
+// Publish once two consecutive captures agree (rejects a stray line)
+static void trackRpm(float est) {
+  bool agree = est > 0 && rpmPrev > 0 && fabsf(est - rpmPrev) <= RPM_TRACK_TOLERANCE * rpmPrev;
+  rpmPrev = est;
+  if (est <= 0)   rpm = 0;
+  else if (agree) rpm = (uint16_t)(est + 0.5f);
+}
+
+static void confirm(uint8_t verdict) {
+  for (int b = 0; b < 3; b++) {
+    uint8_t bit = ERR_RECT_DIODE << b;
+    if (!(verdict & bit) == !(faults & bit)) {
+      streak[b] = 0;
+    } else if (++streak[b] >= RIPPLE_CONFIRM) {
+      faults ^= bit;
+      streak[b] = 0;
+      LOG_W("Charging system: %s %s", b == 0 ? "diode fault" : b == 1 ? "open phase" : "overcharge",
+            (faults & bit) ? "detected" : "cleared");
+    }
+  }
+}
+
+static void rippleJob(TimeUs now) {
+  if (!bike.ignitionOn) {
+    capturing = false;
+    rpm = 0;
+    rpmPrev = 0;
+    return;
+  }
+  if (capturing && batteryAdcCaptureTake(samples)) {
+    result.verdict = analyse(samples, result);
+    fftUs = (uint32_t)(timeNow() - now);
+    if (fftUs > fftUsMax) fftUsMax = fftUs;
+    captures++;
+    trackRpm(result.rpm);
+
+    // Cranking ripple is the starter's commutator, not the rectifier
+    if (bike.engineRunning && !bike.starterEngaged) confirm(result.verdict);
+    else memset(streak, 0, sizeof(streak));
+  }
+  capturing = batteryAdcCaptureArm();
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+void rippleAnalysisInit() {
+  for (int i = 0; i < FFT_N; i++) {
+    window[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / FFT_N);
+  }
+  if (!fftInit()) {
+    LOG_E("Ripple analysis: FFT init failed");
+    return;
+  }
+  schedEvery(SCHED_COMMS, "ripple", RIPPLE_ANALYSIS_MS, rippleJob, SCHED_SHEDDABLE);
+  LOG_I("Ripple analysis: %d-point %s FFT, %.1f Hz bins", FFT_N,
+        RIPPLE_ESP_DSP ? "esp-dsp" : "radix-2", BIN_HZ);
+}
+
+bool rippleAnalysisAvailable() {
+  return batteryAdcCaptureAvailable();
+}
+
+uint8_t rippleAnalysisFaults() {
+  return faults;
+}
+
+uint16_t rippleAnalysisRpm() {
+  return rippleAnalysisAvailable() ? rpm : RPM_UNKNOWN;
+}
+
+const RippleResult& rippleAnalysisResult() {
+  return result;
+}
+
+void rippleAnalysisBuildMetricsJson(JsonDocument& doc) {
+  JsonObject r = doc["ripple"].to<JsonObject>();
+  r["available"] = rippleAnalysisAvailable();
+  r["kernel"]   = RIPPLE_ESP_DSP ? "esp-dsp" : "radix2";
+  r["captures"] = captures;
+  r["fftUs"]    = fftUs;
+  r["fftUsMax"] = fftUsMax;
+  r["meanV"]    = result.meanV;
+  r["p2pMv"]    = result.p2pMv;
+  r["hz"]       = result.fundamentalHz;
+  r["thd"]      = result.thd;
+  if (rippleAnalysisAvailable()) r["rpm"] = rpm;
+  r["verdict"]  = result.verdict;
+  r["faults"]   = faults;
+}
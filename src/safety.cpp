@@ -16,15 +16,17 @@ void safetyInitWatchdog() {
     .trigger_panic  = true        // Panic on timeout → restart
   };
   esp_task_wdt_reconfigure(&wdtConfig);
-  esp_task_wdt_add(NULL);         // Add current task (loopTask)
 #else
   // Legacy ESP-IDF v4.x API
   esp_task_wdt_init(WATCHDOG_TIMEOUT_S, true);
-  esp_task_wdt_add(NULL);
 #endif
   LOG_I("Watchdog initialized (%ds)", WATCHDOG_TIMEOUT_S);
 }
 
+void safetyWatchCurrentTask() {
+  esp_task_wdt_add(NULL);
+}
+
 void safetyFeedWatchdog() {
   esp_task_wdt_reset();
 }
@@ -33,33 +35,6 @@ void safetyFeedWatchdog() {
 // BATTERY VOLTAGE MONITORING (FIX #10)
 // ============================================================================
 
-static float voltageBuffer[VBAT_FILTER_SAMPLES] = {};
-static int   voltageIndex = 0;
-static bool  voltageBufferFull = false;
-static unsigned long lastVoltageRead = 0;
-
-void safetyUpdateVoltage() {
-  unsigned long now = millis();
-  if (now - lastVoltageRead < VBAT_SAMPLE_INTERVAL_MS) return;
-  lastVoltageRead = now;
-
-  int raw = analogRead(PIN_VBAT_ADC);
-  float voltage = (raw / 4095.0f) * 3.3f * VBAT_DIVIDER_RATIO;
-
-  voltageBuffer[voltageIndex] = voltage;
-  voltageIndex = (voltageIndex + 1) % VBAT_FILTER_SAMPLES;
-  if (voltageIndex == 0) voltageBufferFull = true;
-
-  // Calculate moving average
-  int count = voltageBufferFull ? VBAT_FILTER_SAMPLES : voltageIndex;
-  if (count == 0) count = 1;
-  float sum = 0;
-  for (int i = 0; i < count; i++) {
-    sum += voltageBuffer[i];
-  }
-  bike.batteryVoltage = sum / count;
-}
-
 float safetyGetVoltage() {
   return bike.batteryVoltage;
 }
@@ -67,15 +42,13 @@ float safetyGetVoltage() {
 void safetyCheckVoltage() {
   float v = bike.batteryVoltage;
 
-  // Low voltage
+  // Low voltage (non-essential outputs: load_shed.cpp)
   if (v < VBAT_CRITICAL_LOW && v > 1.0f) {  // > 1V to ignore disconnected ADC
+    if (!(bike.errorFlags & ERR_LOW_VOLTAGE)) {
+      LOG_W("CRITICAL: Battery voltage %.1fV", v);
+    }
     bike.errorFlags |= ERR_LOW_VOLTAGE;
     bike.lowVoltageWarning = true;
-    LOG_W("CRITICAL: Battery voltage %.1fV – shutting down non-essential", v);
-    // Turn off non-essential outputs
-    outputOff(PIN_AUX1_OUT);
-    outputOff(PIN_AUX2_OUT);
-    outputOff(PIN_HORN_OUT);
   } else if (v < VBAT_WARNING_LOW && v > 1.0f) {
     bike.lowVoltageWarning = true;
     if (!(bike.errorFlags & ERR_LOW_VOLTAGE)) {
@@ -104,7 +77,7 @@ void safetyCheckVoltage() {
 // ============================================================================
 
 void safetyHandleStand() {
-  bike.standDown = inputActive(PIN_STAND);
+  bike.standDown = inputBit(IN_STAND);
 
   // If stand is down and engine running → kill engine
   // This is standard motorcycle safety behavior.
@@ -131,7 +104,7 @@ void safetyHandleStand() {
 // ============================================================================
 
 static void handleKillSwitch() {
-  bool killState = inputActive(PIN_KILL);
+  bool killState = inputBit(IN_KILL);
   uint8_t killConfig = settings.standKillMode % 3;
 
   // FIX: Always update killActive based on current switch state
@@ -173,6 +146,9 @@ void safetyApplyPriorities() {
   if (bike.killActive) {
     bike.engineRunning  = false;
     bike.starterEngaged = false;
+    outputRequestOff(LAYER_SAFETY, PIN_IGN_OUT);
+    outputRequestOff(LAYER_SAFETY, PIN_START_OUT1);
+    outputRequestOff(LAYER_SAFETY, PIN_START_OUT2);
   }
 
   // Priority 2: without ignition, disable everything dynamic
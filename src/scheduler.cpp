@@ -0,0 +1,306 @@
+#include "scheduler.h"
+
+#define WHEEL_BITS    6
+#define WHEEL_SLOTS   (1 << WHEEL_BITS)
+#define WHEEL_MASK    (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS  3
+#define WHEEL_SPAN    (1UL << (WHEEL_BITS * WHEEL_LEVELS))   // 262144 ms
+
+struct Job {
+  const char* name      = nullptr;
+  SchedFn     fn        = nullptr;
+  uint32_t    periodMs  = 0;          // 0 = one-shot
+  uint32_t    expiry    = 0;
+  SchedTask   task      = SCHED_CONTROL;
+  bool        sheddable = false;
+  bool        armed     = false;
+  bool        rearm     = false;      // Periodic re-insert after this run
+  int8_t      next      = SCHED_NONE;
+  int8_t      prev      = SCHED_NONE;
+  uint8_t     level     = 0;
+  uint8_t     slot      = 0;
+
+  // Statistics
+  uint32_t    runs      = 0;
+  uint32_t    overruns  = 0;          // Periods skipped (ran ≥ 1 period late)
+  uint32_t    shed      = 0;          // Runs skipped for the budget
+  TimeUs      lastRun   = 0;
+  uint32_t    actualMs  = 0;          // Last measured period
+  uint32_t    maxActualMs = 0;
+  uint32_t    runUs     = 0;
+  uint32_t    maxRunUs  = 0;
+};
+
+struct Wheel {
+  int8_t   head[WHEEL_LEVELS][WHEEL_SLOTS];
+  uint32_t now;                       // Last processed wheel millisecond
+  TimeUs   tick;                      // Cached time of this iteration
+  bool     started;
+
+  // Budget
+  TaskHandle_t owner;                 // Task calling schedRun() (log shedding)
+  uint32_t budgetUs;
+  bool     over;                      // Budget spent in this iteration
+  uint32_t iterations;
+  uint32_t overIterations;
+  uint32_t logShed;
+};
+
+static Job     jobs[SCHED_MAX_JOBS];
+static int8_t  jobCount = 0;
+static Wheel   wheels[SCHED_TASK_COUNT] = {};
+
+static Wheel& wheelFor(SchedTask task) {
+  Wheel& w = wheels[task];
+  if (!w.started) {
+    memset(w.head, SCHED_NONE, sizeof(w.head));
+    w.tick = timeNow();
+    w.now  = (uint32_t)msFromUs(w.tick);
+    w.started = true;
+  }
+  return w;
+}
+
+// ============================================================================
+// WHEEL
+// ============================================================================
+
+static void unlink(Wheel& w, int8_t idx) {
+  Job& j = jobs[idx];
+  if (j.prev != SCHED_NONE) jobs[j.prev].next = j.next;
+  else                      w.head[j.level][j.slot] = j.next;
+  if (j.next != SCHED_NONE) jobs[j.next].prev = j.prev;
+  j.next = j.prev = SCHED_NONE;
+}
+
+// Slot by distance from the wheel position; callers guarantee expiry ≥ now
+static void insert(Wheel& w, int8_t idx) {
+  Job& j = jobs[idx];
+  uint32_t delta = j.expiry - w.now;
+  if (delta >= WHEEL_SPAN) delta = WHEEL_SPAN - 1;    // Re-slotted on cascade
+  uint32_t at = w.now + delta;
+
+  j.level = delta < (1UL << WHEEL_BITS) ? 0 : delta < (1UL << (2 * WHEEL_BITS)) ? 1 : 2;
+  j.slot  = (at >> (WHEEL_BITS * j.level)) & WHEEL_MASK;
+  j.prev  = SCHED_NONE;
+  j.next  = w.head[j.level][j.slot];
+  if (j.next != SCHED_NONE) jobs[j.next].prev = idx;
+  w.head[j.level][j.slot] = idx;
+}
+
+static void cascade(Wheel& w, uint8_t level, uint8_t slot) {
+  int8_t idx = w.head[level][slot];
+  w.head[level][slot] = SCHED_NONE;
+  while (idx != SCHED_NONE) {
+    int8_t next = jobs[idx].next;
+    insert(w, idx);
+    idx = next;
+  }
+}
+
+static bool budgetSpent(Wheel& w) {
+  if (w.over) return true;
+  if (w.budgetUs == 0 || timeNow() - w.tick < (DurationUs)w.budgetUs) return false;
+  w.over = true;
+  w.overIterations++;
+  return true;
+}
+
+static void runJob(Wheel& w, int8_t idx) {
+  Job& j = jobs[idx];
+  j.armed = false;
+  j.rearm = j.periodMs != 0;
+
+  if (j.sheddable && budgetSpent(w)) {
+    j.shed++;
+    if (j.periodMs) {
+      j.expiry += j.periodMs;         // Drop this run, keep the phase
+    } else {
+      j.expiry = w.now + 1;           // One-shot: try again next millisecond
+    }
+    j.armed = true;
+    insert(w, idx);
+    return;
+  }
+
+  TimeUs t0 = timeNow();
+  j.fn(w.tick);
+  uint32_t us = (uint32_t)(timeNow() - t0);
+
+  j.runUs = us;
+  if (us > j.maxRunUs) j.maxRunUs = us;
+  if (j.runs && j.periodMs) {
+    j.actualMs = (uint32_t)msFromUs(w.tick - j.lastRun);
+    if (j.actualMs > j.maxActualMs) j.maxActualMs = j.actualMs;
+  }
+  j.lastRun = w.tick;
+  j.runs++;
+
+  // Periodic: keep the phase, but resync instead of bursting after a stall.
+  // Skip if the callback re-armed or cancelled itself.
+  if (j.rearm && !j.armed) {
+    uint32_t tickMs = (uint32_t)msFromUs(w.tick);
+    uint32_t next = j.expiry + j.periodMs;
+    if ((int32_t)(next - tickMs) <= 0) {
+      j.overruns++;
+      next = tickMs + j.periodMs;
+    }
+    j.expiry = next;
+    j.armed  = true;
+    insert(w, idx);
+  }
+}
+
+// One millisecond at a time; cascades happen as the lower level wraps
+static void advance(Wheel& w, uint32_t target) {
+  while ((int32_t)(target - w.now) > 0) {
+    uint32_t t = ++w.now;
+    if ((t & WHEEL_MASK) == 0) {
+      if (((t >> WHEEL_BITS) & WHEEL_MASK) == 0) {
+        cascade(w, 2, (t >> (2 * WHEEL_BITS)) & WHEEL_MASK);
+      }
+      cascade(w, 1, (t >> WHEEL_BITS) & WHEEL_MASK);
+    }
+    int8_t idx;
+    while ((idx = w.head[0][t & WHEEL_MASK]) != SCHED_NONE) {
+      unlink(w, idx);
+      runJob(w, idx);
+    }
+  }
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+static SchedJob addJob(SchedTask task, const char* name, uint32_t periodMs, SchedFn fn,
+                       SchedClass cls) {
+  if (jobCount >= SCHED_MAX_JOBS || task >= SCHED_TASK_COUNT || !fn) {
+    LOG_E("Scheduler: cannot add job %s", name);
+    return SCHED_NONE;
+  }
+  SchedJob idx = jobCount++;
+  Job& j = jobs[idx];
+  j.name     = name;
+  j.fn       = fn;
+  j.periodMs = periodMs;
+  j.task     = task;
+  j.sheddable = cls == SCHED_SHEDDABLE;
+  return idx;
+}
+
+SchedJob schedEvery(SchedTask task, const char* name, uint32_t periodMs, SchedFn fn,
+                    SchedClass cls) {
+  SchedJob idx = addJob(task, name, periodMs ? periodMs : 1, fn, cls);
+  if (idx != SCHED_NONE) schedArm(idx, periodMs);
+  return idx;
+}
+
+SchedJob schedOneShot(SchedTask task, const char* name, SchedFn fn, SchedClass cls) {
+  return addJob(task, name, 0, fn, cls);
+}
+
+void schedArm(SchedJob job, uint32_t delayMs) {
+  if (job < 0 || job >= jobCount) return;
+  Job& j = jobs[job];
+  Wheel& w = wheelFor(j.task);
+  if (j.armed) unlink(w, job);
+
+  // The current wheel slot has already run – never land in it
+  uint32_t expiry = (uint32_t)msFromUs(w.tick) + delayMs;
+  if ((int32_t)(expiry - w.now) <= 0) expiry = w.now + 1;
+  j.expiry = expiry;
+  j.armed  = true;
+  insert(w, job);
+}
+
+void schedCancel(SchedJob job) {
+  if (job < 0 || job >= jobCount) return;
+  jobs[job].rearm = false;
+  if (!jobs[job].armed) return;
+  unlink(wheels[jobs[job].task], job);
+  jobs[job].armed = false;
+}
+
+bool schedArmed(SchedJob job) {
+  return job >= 0 && job < jobCount && jobs[job].armed;
+}
+
+void schedSetBudget(SchedTask task, uint32_t budgetUs) {
+  wheelFor(task).budgetUs = budgetUs;
+}
+
+bool schedOverBudget(SchedTask task) {
+  return budgetSpent(wheelFor(task));
+}
+
+bool logShed() {
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  for (Wheel& w : wheels) {
+    if (w.started && w.owner == self && budgetSpent(w)) {
+      w.logShed++;
+      return true;
+    }
+  }
+  return false;
+}
+
+TimeUs schedRun(SchedTask task) {
+  Wheel& w = wheelFor(task);
+  w.tick  = timeNow();
+  w.owner = xTaskGetCurrentTaskHandle();
+  w.over  = false;
+  w.iterations++;
+  advance(w, (uint32_t)msFromUs(w.tick));
+  return w.tick;
+}
+
+TimeUs schedNow(SchedTask task) {
+  return wheelFor(task).tick;
+}
+
+bool schedNextDue(SchedTask task, TimeUs& due) {
+  const Wheel& w = wheelFor(task);
+  uint32_t tickMs = (uint32_t)msFromUs(w.tick);
+  bool found = false;
+  int32_t first = 0;
+  for (int8_t i = 0; i < jobCount; i++) {
+    const Job& j = jobs[i];
+    if (j.task != task || !j.armed) continue;
+    int32_t inMs = (int32_t)(j.expiry - tickMs);
+    if (!found || inMs < first) first = inMs;
+    found = true;
+  }
+  if (found) due = usFromMs(msFromUs(w.tick) + first);
+  return found;
+}
+
+void schedBuildMetricsJson(JsonDocument& doc) {
+  JsonArray arr = doc["sched"].to<JsonArray>();
+  for (int8_t i = 0; i < jobCount; i++) {
+    const Job& j = jobs[i];
+    JsonObject o = arr.add<JsonObject>();
+    o["name"]        = j.name;
+    o["task"]        = j.task == SCHED_CONTROL ? "control" : "comms";
+    o["periodMs"]    = j.periodMs;
+    o["actualMs"]    = j.actualMs;
+    o["maxActualMs"] = j.maxActualMs;
+    o["runUs"]       = j.runUs;
+    o["maxRunUs"]    = j.maxRunUs;
+    o["runs"]        = j.runs;
+    o["overruns"]    = j.overruns;
+    o["shed"]        = j.shed;
+    o["armed"]       = j.armed;
+  }
+
+  JsonArray budget = doc["budget"].to<JsonArray>();
+  for (uint8_t t = 0; t < SCHED_TASK_COUNT; t++) {
+    const Wheel& w = wheels[t];
+    JsonObject o = budget.add<JsonObject>();
+    o["task"]       = t == SCHED_CONTROL ? "control" : "comms";
+    o["budgetUs"]   = w.budgetUs;
+    o["iterations"] = w.iterations;
+    o["overBudget"] = w.overIterations;
+    o["logShed"]    = w.logShed;
+  }
+}
@@ -1,10 +1,43 @@
 #include "settings_store.h"
+#include "scheduler.h"
+#include "dimming.h"
+#include "load_shed.h"
 #include <Preferences.h>
 
 static Preferences preferences;
 static const char* NAMESPACE = "moto32";
+static volatile bool    saveRequested = false;
+static volatile uint8_t patternsPending = 0;   // Bit per PatternSlot
+static portMUX_TYPE     pendingMux = portMUX_INITIALIZER_UNLOCKED;
 
-void saveSettings() {
+static void patternKey(PatternSlot slot, char* key, size_t len) {
+  snprintf(key, len, "pat_%s", patternSlotName(slot));
+}
+
+static void saveCustomPattern(PatternSlot slot) {
+  char key[16];
+  patternKey(slot, key, sizeof(key));
+  PatternSeg seg[PATTERN_MAX_SEGS];
+  uint8_t n = patternCopyCustom(slot, seg);
+  preferences.begin(NAMESPACE, false);
+  if (n) preferences.putBytes(key, seg, n * sizeof(PatternSeg));
+  else   preferences.remove(key);
+  preferences.end();
+}
+
+static void loadCustomPatterns() {
+  PatternSeg seg[PATTERN_MAX_SEGS];
+  char key[16];
+  for (uint8_t i = 0; i < PATTERN_SLOT_COUNT; i++) {
+    patternKey((PatternSlot)i, key, sizeof(key));
+    size_t len = preferences.getBytesLength(key);
+    if (len == 0 || len % sizeof(PatternSeg) || len > sizeof(seg)) continue;
+    preferences.getBytes(key, seg, len);
+    patternSetCustom((PatternSlot)i, seg, len / sizeof(PatternSeg));
+  }
+}
+
+static void saveSettings() {
   preferences.begin(NAMESPACE, false);
   preferences.putUChar ("handlebar", settings.handlebarConfig);
   preferences.putUChar ("rear",      settings.rearLightMode);
@@ -19,10 +52,51 @@ void saveSettings() {
   preferences.putUChar ("stand",     settings.standKillMode);
   preferences.putUChar ("park",      settings.parkingLightMode);
   preferences.putUShort("tdist",     settings.turnDistancePulsesTarget);
+  preferences.putBytes ("debounce",  settings.debounceMs, sizeof(settings.debounceMs));
+  preferences.putUChar ("poles",     settings.polePairs);
+  preferences.putUChar ("aux1pw",    settings.aux1Power);
+  preferences.putUChar ("aux2pw",    settings.aux2Power);
+  preferences.putBytes ("shed",      settings.shedTier, sizeof(settings.shedTier));
+  preferences.putBytes ("watts",     settings.outputWatts, sizeof(settings.outputWatts));
+  preferences.putUChar ("battAh",    settings.batteryAh);
+  preferences.putUChar ("parkFlr",   settings.parkFloorPct);
+  preferences.putUChar ("pSleep",    settings.parkSleepMin);
   preferences.end();
   LOG_I("Settings saved");
 }
 
+void requestSaveSettings() {
+  saveRequested = true;
+}
+
+void requestSaveCustomPattern(PatternSlot slot) {
+  portENTER_CRITICAL(&pendingMux);
+  patternsPending |= 1 << slot;
+  portEXIT_CRITICAL(&pendingMux);
+}
+
+static void flushSettings(TimeUs) {
+  portENTER_CRITICAL(&pendingMux);
+  uint8_t pats = patternsPending;
+  patternsPending = 0;
+  portEXIT_CRITICAL(&pendingMux);
+  for (uint8_t i = 0; i < PATTERN_SLOT_COUNT; i++) {
+    if (pats & (1 << i)) saveCustomPattern((PatternSlot)i);
+  }
+
+  if (!saveRequested) return;
+  saveRequested = false;
+  saveSettings();
+}
+
+bool settingsSavePending() {
+  return saveRequested || patternsPending;
+}
+
+void settingsStoreInit() {
+  schedEvery(SCHED_COMMS, "nvs", SETTINGS_FLUSH_MS, flushSettings, SCHED_SHEDDABLE);
+}
+
 void loadSettings() {
   preferences.begin(NAMESPACE, true);
   settings.handlebarConfig  = static_cast<HandlebarConfig>(
@@ -42,6 +116,22 @@ void loadSettings() {
   settings.parkingLightMode = preferences.getUChar ("park",  settings.parkingLightMode);
   settings.turnDistancePulsesTarget =
       preferences.getUShort("tdist", settings.turnDistancePulsesTarget);
+  if (preferences.getBytesLength("debounce") == sizeof(settings.debounceMs)) {
+    preferences.getBytes("debounce", settings.debounceMs, sizeof(settings.debounceMs));
+  }
+  settings.polePairs        = preferences.getUChar ("poles", settings.polePairs);
+  settings.aux1Power        = preferences.getUChar ("aux1pw", settings.aux1Power);
+  settings.aux2Power        = preferences.getUChar ("aux2pw", settings.aux2Power);
+  if (preferences.getBytesLength("shed") == sizeof(settings.shedTier)) {
+    preferences.getBytes("shed", settings.shedTier, sizeof(settings.shedTier));
+  }
+  if (preferences.getBytesLength("watts") == sizeof(settings.outputWatts)) {
+    preferences.getBytes("watts", settings.outputWatts, sizeof(settings.outputWatts));
+  }
+  settings.batteryAh        = preferences.getUChar ("battAh", settings.batteryAh);
+  settings.parkFloorPct     = preferences.getUChar ("parkFlr", settings.parkFloorPct);
+  settings.parkSleepMin     = preferences.getUChar ("pSleep", settings.parkSleepMin);
+  loadCustomPatterns();
   preferences.end();
 
   // Validate / clamp loaded values
@@ -50,11 +140,20 @@ void loadSettings() {
   settings.turnSignalMode = static_cast<TurnSignalMode>(
       constrain(settings.turnSignalMode, TURN_OFF, TURN_30S));
   settings.brakeLightMode = static_cast<BrakeLightMode>(
-      constrain(settings.brakeLightMode, BRAKE_CONTINUOUS, BRAKE_EMERGENCY));
+      constrain(settings.brakeLightMode, BRAKE_CONTINUOUS, BRAKE_CUSTOM));
   settings.positionLight = constrain(settings.positionLight, 0, 9);
   settings.turnDistancePulsesTarget = constrain(
       settings.turnDistancePulsesTarget,
       TURN_DISTANCE_MIN_PULSES, TURN_DISTANCE_MAX_PULSES);
+  settings.polePairs = constrain(settings.polePairs, 1, RPM_POLE_PAIRS_MAX);
+  settings.aux1Power = auxPowerClamp(settings.aux1Power);
+  settings.aux2Power = auxPowerClamp(settings.aux2Power);
+  for (int i = 0; i < OUTPUT_PIN_COUNT; i++) {
+    settings.shedTier[i] = loadShedTierClamp(i, settings.shedTier[i]);
+  }
+  settings.batteryAh    = constrain(settings.batteryAh, 1, 100);
+  settings.parkFloorPct = constrain(settings.parkFloorPct, 0, 90);
+  settings.parkSleepMin = constrain(settings.parkSleepMin, 0, 120);
 
   LOG_I("Settings loaded");
 }
@@ -1,12 +1,15 @@
 #include "setup_mode.h"
 #include "outputs.h"
 #include "inputs.h"
+#include "control_loop.h"
+#include "scheduler.h"
+#include "lamp_monitor.h"
 
 void setupModeCheck() {
   refreshInputEvents();
   if (hornEvent.state) {
     bike.inSetupMode   = true;
-    bike.setupEnterTime = millis();
+    bike.setupEnterTime = schedNow(SCHED_CONTROL);
     LOG_I("Entering SETUP mode");
   }
 }
@@ -14,40 +17,46 @@ void setupModeCheck() {
 void startCalibrationSequence() {
   bike.calibrationState       = CALIB_RUNNING;
   bike.calibrationStepIndex   = 0;
-  bike.calibrationStepStart   = millis();
+  bike.calibrationStepStart   = schedNow(SCHED_CONTROL);
   bike.calibrationStepOutputOn = true;
+  lampMonitorLearn(true);
   LOG_I("Calibration started");
-  outputOn(CALIBRATION_PINS[0]);
 }
 
+// Advances the step timer, then claims the current pin on the service
+// layer for this tick (the arbiter drops unclaimed pins back to user logic)
 void processCalibrationSequence() {
   if (bike.calibrationState != CALIB_RUNNING) return;
 
-  unsigned long now = millis();
-  if (now - bike.calibrationStepStart < CALIBRATION_STEP_MS) return;
-
-  if (bike.calibrationStepOutputOn) {
-    outputOff(CALIBRATION_PINS[bike.calibrationStepIndex]);
-    bike.calibrationStepOutputOn = false;
+  TimeUs now = schedNow(SCHED_CONTROL);
+  if (now - bike.calibrationStepStart >= usFromMs(CALIBRATION_STEP_MS)) {
+    if (bike.calibrationStepOutputOn) {
+      bike.calibrationStepOutputOn = false;
+    } else {
+      bike.calibrationStepIndex++;
+      if (bike.calibrationStepIndex >= CALIBRATION_PIN_COUNT) {
+        bike.calibrationState = CALIB_DONE;
+        lampMonitorLearn(false);
+        LOG_I("Calibration completed");
+        return;
+      }
+      bike.calibrationStepOutputOn = true;
+    }
     bike.calibrationStepStart = now;
-    return;
-  }
-
-  bike.calibrationStepIndex++;
-  if (bike.calibrationStepIndex >= CALIBRATION_PIN_COUNT) {
-    bike.calibrationState = CALIB_DONE;
-    LOG_I("Calibration completed");
-    return;
   }
+  controlWakeAt(bike.calibrationStepStart + usFromMs(CALIBRATION_STEP_MS));
 
-  outputOn(CALIBRATION_PINS[bike.calibrationStepIndex]);
-  bike.calibrationStepOutputOn = true;
-  bike.calibrationStepStart = now;
+  int pin = CALIBRATION_PINS[bike.calibrationStepIndex];
+  if (bike.calibrationStepOutputOn) outputRequestOn(LAYER_SERVICE, pin);
+  else                              outputRequestOff(LAYER_SERVICE, pin);
 }
 
 bool setupModeHandleExit() {
+  if (bike.inSetupMode && hornEvent.state) {
+    controlWakeAt(bike.setupEnterTime + usFromMs(LONG_PRESS_THRESHOLD_MS + 1));
+  }
   if (bike.inSetupMode && hornEvent.state
-      && millis() - bike.setupEnterTime > LONG_PRESS_THRESHOLD_MS) {
+      && schedNow(SCHED_CONTROL) - bike.setupEnterTime > usFromMs(LONG_PRESS_THRESHOLD_MS)) {
     bike.inSetupMode = false;
     LOG_I("Exiting SETUP mode – calibration starting");
     startCalibrationSequence();
@@ -0,0 +1,12 @@
+#include "time_base.h"
+#include <esp_timer.h>
+
+static TimeSource timeSource = nullptr;
+
+TimeUs timeNow() {
+  return timeSource ? timeSource() : esp_timer_get_time();
+}
+
+void timeSetSource(TimeSource source) {
+  timeSource = source;
+}
@@ -3,6 +3,17 @@
 #include "settings_store.h"
 #include "outputs.h"
 #include "ble_interface.h"
+#include "control_loop.h"
+#include "scheduler.h"
+#include "battery_adc.h"
+#include "ripple_analysis.h"
+#include "crank_monitor.h"
+#include "battery_health.h"
+#include "lamp_monitor.h"
+#include "dimming.h"
+#include "load_shed.h"
+#include "energy.h"
+#include "power_mode.h"
 
 #include <WiFi.h>
 #include <ESPmDNS.h>
@@ -13,13 +24,18 @@
 
 static AsyncWebServer  server(80);
 static AsyncWebSocket  ws("/ws");
-static unsigned long   lastBroadcast = 0;
 static const unsigned long BROADCAST_INTERVAL_MS = 150;
+static const unsigned long KEYLESS_BROADCAST_MS  = 500;
 
 // WiFi AP credentials
 static const char* AP_SSID = "Moto32";
 static const char* AP_PASS = "moto3232";  // min 8 chars
 
+// Settings from the dashboard, handed to the control tick (async_tcp task)
+static portMUX_TYPE settingsMux = portMUX_INITIALIZER_UNLOCKED;
+static bool     newSettingsAvailable = false;
+static Settings pendingSettings;
+
 // ============================================================================
 // JSON STATE BUILDER
 // ============================================================================
@@ -27,11 +43,30 @@ static const char* AP_PASS = "moto3232";  // min 8 chars
 static void buildStateJson(JsonDocument& doc) {
   doc["type"] = "state";
   doc["voltage"] = round(bike.batteryVoltage * 10.0f) / 10.0f;
+  doc["vMin"]    = round(bike.batteryMin * 100.0f) / 100.0f;
+  doc["vMax"]    = round(bike.batteryMax * 100.0f) / 100.0f;
+  doc["ripple"]  = round(bike.batteryRipple * 100.0f) / 100.0f;
+  const RippleResult& rr = rippleAnalysisResult();
+  doc["rippleHz"]  = (int)rr.fundamentalHz;
+  doc["rippleThd"] = round(rr.thd * 100.0f) / 100.0f;
+  doc["rippleAvailable"] = rippleAnalysisAvailable();
+  doc["rint"]      = round(bike.batteryRint * 10.0f) / 10.0f;
+  if (bike.batterySoh != BATT_SOH_UNKNOWN) doc["soh"] = bike.batterySoh;
+  doc["battWarn"]  = bike.batteryWorn;
+  doc["dimPct"]    = dimmingFactorQ12() * 100 / 4096;
   doc["errorFlags"] = bike.errorFlags;
+  doc["shed"]       = bike.shedMask;
+  doc["shedLevel"]  = bike.shedLevel;
+  doc["parkMah"]    = round(energyParkedMah());
+  doc["parkCut"]    = bike.parkCutoff;
+  doc["lampFaults"] = bike.lampFaults;
   doc["ignitionOn"] = bike.ignitionOn;
   doc["engineRunning"] = bike.engineRunning;
+  if (bike.engineRpm != RPM_UNKNOWN) doc["rpm"] = bike.engineRpm;
   doc["starterEngaged"] = bike.starterEngaged;
   doc["killActive"] = bike.killActive;
+  doc["speedKmh"] = round(bike.speedKmh * 10.0f) / 10.0f;
+  doc["speedHz"] = bike.speedPulseHz;
 
   // Inputs
   JsonObject ins = doc["inputs"].to<JsonObject>();
@@ -44,48 +79,86 @@ static void buildStateJson(JsonDocument& doc) {
   ins["brake"] = bike.brakePressed;
   ins["kill"]  = bike.killActive;
   ins["stand"] = bike.standDown;
-  ins["aux1"]  = inputActive(PIN_AUX1);
-  ins["aux2"]  = inputActive(PIN_AUX2);
-  ins["speed"] = false;
-  ins["speed_info"] = String(bike.speedPulseCount) + " Pulse";
+  ins["aux1"]  = inputBit(IN_AUX1);
+  ins["aux2"]  = inputBit(IN_AUX2);
+  ins["speed"] = inputBit(IN_SPEED);
+  ins["speed_info"] = String(bike.speedPulseCount) + " Pulse / "
+                    + String(bike.speedKmh, 1) + " km/h";
 
   // Outputs
   JsonObject outs = doc["outputs"].to<JsonObject>();
-  outs["turnLOut"] = bike.leftTurnOn && bike.flasherState;
-  outs["turnROut"] = bike.rightTurnOn && bike.flasherState;
-  outs["lightOut"] = bike.lowBeamOn;
-  outs["hibeam"]   = bike.highBeamOn;
-  outs["brakeOut"] = bike.brakePressed;
-  outs["hornOut"]  = bike.hornPressed && bike.ignitionOn;
-  outs["start1"]   = bike.starterEngaged;
-  outs["start2"]   = bike.starterEngaged;
-  outs["ignOut"]   = bike.ignitionOn && !bike.killActive;
-  // AUX outputs reflect actual state based on current mode
-  outs["aux1Out"]  = digitalRead(PIN_AUX1_OUT) == HIGH;
-  outs["aux2Out"]  = digitalRead(PIN_AUX2_OUT) == HIGH;
-
-  // Hazard override
-  if (bike.hazardLightsOn && bike.flasherState) {
-    outs["turnLOut"] = true;
-    outs["turnROut"] = true;
+  // Resolved by the arbiter: level, PWM duty and the winning layer
+  static const char* const OUT_KEYS[OUTPUT_PIN_COUNT] = {
+    "turnLOut", "turnROut", "lightOut", "hibeam", "brakeOut", "hornOut",
+    "start1", "start2", "ignOut", "aux1Out", "aux2Out"
+  };
+  for (int i = 0; i < OUTPUT_PIN_COUNT; i++) {
+    int pin = OUTPUT_PINS[i];
+    uint8_t duty = outputDuty(pin);
+    outs[OUT_KEYS[i]] = duty > 0;
+    if (duty > 0 && duty < DUTY_ON) {
+      outs[String(OUT_KEYS[i]) + "_pwm"] = duty;
+    }
+    outs[String(OUT_KEYS[i]) + "_layer"] = outputLayerName(outputWinner(pin));
   }
 }
 
-static void buildSettingsJson(JsonDocument& doc) {
+// A dashboard change the control tick has not taken yet, else the live set
+static Settings webPendingOrCurrent() {
+  portENTER_CRITICAL(&settingsMux);
+  Settings s = newSettingsAvailable ? pendingSettings : settings;
+  portEXIT_CRITICAL(&settingsMux);
+  return s;
+}
+
+static void webPublishSettings(const Settings& s) {
+  portENTER_CRITICAL(&settingsMux);
+  pendingSettings      = s;
+  newSettingsAvailable = true;
+  portEXIT_CRITICAL(&settingsMux);
+}
+
+static void buildSettingsJson(JsonDocument& doc, const Settings& s) {
   doc["type"]      = "settings";
-  doc["handlebar"] = settings.handlebarConfig;
-  doc["rear"]      = settings.rearLightMode;
-  doc["turn"]      = settings.turnSignalMode;
-  doc["brake"]     = settings.brakeLightMode;
-  doc["alarm"]     = settings.alarmMode;
-  doc["pos"]       = settings.positionLight;
-  doc["wave"]      = settings.moWaveEnabled ? 1 : 0;
-  doc["low"]       = settings.lowBeamMode;
-  doc["aux1"]      = settings.aux1Mode;
-  doc["aux2"]      = settings.aux2Mode;
-  doc["stand"]     = settings.standKillMode;
-  doc["park"]      = settings.parkingLightMode;
-  doc["tdist"]     = settings.turnDistancePulsesTarget;
+  doc["handlebar"] = s.handlebarConfig;
+  doc["rear"]      = s.rearLightMode;
+  doc["turn"]      = s.turnSignalMode;
+  doc["brake"]     = s.brakeLightMode;
+  doc["alarm"]     = s.alarmMode;
+  doc["pos"]       = s.positionLight;
+  doc["wave"]      = s.moWaveEnabled ? 1 : 0;
+  doc["low"]       = s.lowBeamMode;
+  doc["aux1"]      = s.aux1Mode;
+  doc["aux2"]      = s.aux2Mode;
+  doc["stand"]     = s.standKillMode;
+  doc["park"]      = s.parkingLightMode;
+  doc["tdist"]     = s.turnDistancePulsesTarget;
+  doc["poles"]     = s.polePairs;
+  doc["aux1Pw"]    = s.aux1Power;
+  doc["aux2Pw"]    = s.aux2Power;
+  JsonArray shed = doc["shedTiers"].to<JsonArray>();
+  for (int i = 0; i < OUTPUT_PIN_COUNT; i++) shed.add(s.shedTier[i]);
+  JsonArray watts = doc["watts"].to<JsonArray>();
+  for (int i = 0; i < OUTPUT_PIN_COUNT; i++) watts.add(s.outputWatts[i]);
+  doc["battAh"]    = s.batteryAh;
+  doc["parkFloor"] = s.parkFloorPct;
+  doc["parkSleep"] = s.parkSleepMin;
+  JsonArray db = doc["debounce"].to<JsonArray>();
+  for (int i = 0; i < INPUT_COUNT; i++) db.add(s.debounceMs[i]);
+
+  // Custom light patterns: slot → [[ms, duty, repeat], …] (empty = built-in)
+  JsonObject pats = doc["patterns"].to<JsonObject>();
+  for (uint8_t i = 0; i < PATTERN_SLOT_COUNT; i++) {
+    JsonArray arr = pats[patternSlotName((PatternSlot)i)].to<JsonArray>();
+    PatternSeg segs[PATTERN_MAX_SEGS];
+    uint8_t n = patternCopyCustom((PatternSlot)i, segs);
+    for (uint8_t k = 0; k < n; k++) {
+      JsonArray seg = arr.add<JsonArray>();
+      seg.add(segs[k].ms);
+      seg.add(segs[k].duty);
+      seg.add(segs[k].repeat);
+    }
+  }
 }
 
 // ============================================================================
@@ -103,10 +176,13 @@ static void handleWsMessage(AsyncWebSocketClient* client, const char* data, size
   const char* cmd = doc["cmd"];
   if (!cmd) return;
 
+  // State may change below → let the control loop react immediately
+  controlWake();
+
   // ---- Get Settings ----
   if (strcmp(cmd, "getSettings") == 0) {
     JsonDocument resp;
-    buildSettingsJson(resp);
+    buildSettingsJson(resp, webPendingOrCurrent());
     String out;
     serializeJson(resp, out);
     client->text(out);
@@ -116,24 +192,46 @@ static void handleWsMessage(AsyncWebSocketClient* client, const char* data, size
   else if (strcmp(cmd, "setSettings") == 0) {
     JsonObject d = doc["data"];
     if (d.isNull()) return;
-    settings.handlebarConfig  = static_cast<HandlebarConfig>(
+    // Edit a copy: the control task reads settings every tick
+    Settings s = webPendingOrCurrent();
+    s.handlebarConfig  = static_cast<HandlebarConfig>(
         constrain((int)d["handlebar"], CONFIG_A, CONFIG_E));
-    settings.rearLightMode    = d["rear"] | 0;
-    settings.turnSignalMode   = static_cast<TurnSignalMode>(
+    s.rearLightMode    = d["rear"] | 0;
+    s.turnSignalMode   = static_cast<TurnSignalMode>(
         constrain((int)d["turn"], TURN_OFF, TURN_30S));
-    settings.brakeLightMode   = static_cast<BrakeLightMode>(
-        constrain((int)d["brake"], BRAKE_CONTINUOUS, BRAKE_EMERGENCY));
-    settings.alarmMode        = d["alarm"] | 0;
-    settings.positionLight    = constrain((int)d["pos"], 0, 9);
-    settings.moWaveEnabled    = (int)d["wave"] != 0;
-    settings.lowBeamMode      = d["low"] | 0;
-    settings.aux1Mode         = d["aux1"] | 0;
-    settings.aux2Mode         = d["aux2"] | 0;
-    settings.standKillMode    = d["stand"] | 0;
-    settings.parkingLightMode = d["park"] | 0;
-    settings.turnDistancePulsesTarget = constrain(
+    s.brakeLightMode   = static_cast<BrakeLightMode>(
+        constrain((int)d["brake"], BRAKE_CONTINUOUS, BRAKE_CUSTOM));
+    s.alarmMode        = d["alarm"] | 0;
+    s.positionLight    = constrain((int)d["pos"], 0, 9);
+    s.moWaveEnabled    = (int)d["wave"] != 0;
+    s.lowBeamMode      = d["low"] | 0;
+    s.aux1Mode         = d["aux1"] | 0;
+    s.aux2Mode         = d["aux2"] | 0;
+    s.standKillMode    = d["stand"] | 0;
+    s.parkingLightMode = d["park"] | 0;
+    s.turnDistancePulsesTarget = constrain(
         (int)d["tdist"], TURN_DISTANCE_MIN_PULSES, TURN_DISTANCE_MAX_PULSES);
-    saveSettings();
+    s.polePairs = constrain((int)(d["poles"] | RPM_POLE_PAIRS_DEFAULT), 1, RPM_POLE_PAIRS_MAX);
+    s.aux1Power = auxPowerClamp(d["aux1Pw"] | 0);
+    s.aux2Power = auxPowerClamp(d["aux2Pw"] | 0);
+    JsonArray shed = d["shedTiers"];
+    if (shed.size() == OUTPUT_PIN_COUNT) {
+      for (int i = 0; i < OUTPUT_PIN_COUNT; i++) s.shedTier[i] = loadShedTierClamp(i, shed[i]);
+    }
+    JsonArray watts = d["watts"];
+    if (watts.size() == OUTPUT_PIN_COUNT) {
+      for (int i = 0; i < OUTPUT_PIN_COUNT; i++) s.outputWatts[i] = constrain((int)watts[i], 0, 2000);
+    }
+    s.batteryAh    = constrain((int)(d["battAh"] | BATTERY_AH_DEFAULT), 1, 100);
+    s.parkFloorPct = constrain((int)(d["parkFloor"] | PARK_FLOOR_PCT_DEFAULT), 0, 90);
+    s.parkSleepMin = constrain((int)(d["parkSleep"] | PARK_SLEEP_MIN_DEFAULT), 0, 120);
+    JsonArray db = d["debounce"];
+    if (db.size() == INPUT_COUNT) {
+      for (int i = 0; i < INPUT_COUNT; i++) {
+        s.debounceMs[i] = constrain((int)db[i], 0, DEBOUNCE_MAX_MS);
+      }
+    }
+    webPublishSettings(s);
     LOG_I("Settings updated via Web");
 
     // Send confirmation
@@ -146,13 +244,44 @@ static void handleWsMessage(AsyncWebSocketClient* client, const char* data, size
     client->text(out);
   }
 
+  // ---- Custom light pattern upload ----
+  // {"cmd":"setPattern","slot":"brake","seg":[[ms,duty,repeat],…]}
+  else if (strcmp(cmd, "setPattern") == 0) {
+    PatternSlot slot;
+    JsonArray arr = doc["seg"];
+    bool ok = patternSlotFromName(doc["slot"], slot) && arr.size() <= PATTERN_MAX_SEGS;
+    if (ok) {
+      PatternSeg seg[PATTERN_MAX_SEGS];
+      uint8_t n = 0;
+      for (JsonArray s : arr) {
+        seg[n].ms     = constrain((int)s[0], 0, 65535);
+        seg[n].duty   = constrain((int)s[1], 0, 255);
+        seg[n].repeat = constrain((int)s[2], 0, PATTERN_FOREVER);
+        n++;
+      }
+      ok = patternSetCustom(slot, seg, n);
+      if (ok) requestSaveCustomPattern(slot);
+    }
+    JsonDocument resp;
+    resp["type"]  = "toast";
+    resp["text"]  = ok ? "pattern_saved" : "pattern_invalid";
+    resp["level"] = ok ? "success" : "error";
+    String out;
+    serializeJson(resp, out);
+    client->text(out);
+  }
+
   // ---- Factory Reset ----
   else if (strcmp(cmd, "factoryReset") == 0) {
-    settings = Settings{};  // Reset to defaults
-    saveSettings();
+    Settings s;  // Defaults
+    webPublishSettings(s);
+    for (uint8_t i = 0; i < PATTERN_SLOT_COUNT; i++) {
+      patternSetCustom((PatternSlot)i, nullptr, 0);
+      requestSaveCustomPattern((PatternSlot)i);
+    }
     LOG_I("Factory reset via Web");
     JsonDocument resp;
-    buildSettingsJson(resp);
+    buildSettingsJson(resp, s);
     String out;
     serializeJson(resp, out);
     client->text(out);
@@ -205,6 +334,11 @@ static void handleWsMessage(AsyncWebSocketClient* client, const char* data, size
     LOG_D("AUX2 manual: %s", bike.aux2ManualOn ? "ON" : "OFF");
   }
 
+  // ---- New battery fitted: relearn health baseline ----
+  else if (strcmp(cmd, "resetBattery") == 0) {
+    batteryHealthReset();
+  }
+
   // ---- Restart ----
   else if (strcmp(cmd, "restart") == 0) {
     LOG_I("Restart requested via Web");
@@ -236,18 +370,38 @@ static void onWsEvent(AsyncWebSocket* server, AsyncWebSocketClient* client,
 }
 
 // ============================================================================
-// PUBLIC API
+// BROADCAST JOBS (comms task)
 // ============================================================================
 
-void webInit() {
-  // Start LittleFS
-  if (!LittleFS.begin(true)) {
-    LOG_E("LittleFS mount failed!");
-    return;
-  }
-  LOG_I("LittleFS mounted");
+static void broadcastState(TimeUs) {
+  // Cleanup dead connections
+  ws.cleanupClients();
+
+  if (ws.count() == 0) return;
+
+  // Build and broadcast state
+  JsonDocument doc;
+  buildStateJson(doc);
+  String out;
+  serializeJson(doc, out);
+  ws.textAll(out);
+}
 
-  // WiFi Access Point
+static void broadcastKeyless(TimeUs) {
+  if (ws.count() == 0) return;
+  JsonDocument kdoc;
+  bleKeylessBuildJson(kdoc);
+  String kout;
+  serializeJson(kdoc, kout);
+  ws.textAll(kout);
+}
+
+// ============================================================================
+// PUBLIC API
+// ============================================================================
+
+void webApStart() {
+  if (webApActive()) return;
   WiFi.mode(WIFI_AP);
   WiFi.softAP(AP_SSID, AP_PASS);
   LOG_I("WiFi AP started: %s (IP: %s)",
@@ -260,6 +414,27 @@ void webInit() {
   } else {
     LOG_W("mDNS failed to start");
   }
+}
+
+void webApStop() {
+  if (!webApActive()) return;
+  ws.closeAll();
+  MDNS.end();
+  WiFi.softAPdisconnect(true);
+  WiFi.mode(WIFI_OFF);
+  LOG_I("WiFi AP stopped");
+}
+
+void webInit() {
+  // Start LittleFS
+  if (!LittleFS.begin(true)) {
+    LOG_E("LittleFS mount failed!");
+    return;
+  }
+  LOG_I("LittleFS mounted");
+
+  // WiFi Access Point + mDNS
+  webApStart();
 
   // WebSocket
   ws.onEvent(onWsEvent);
@@ -277,9 +452,41 @@ void webInit() {
     req->send(200, "application/json", out);
   });
 
+  server.on("/api/metrics", HTTP_GET, [](AsyncWebServerRequest* req) {
+    JsonDocument doc;
+    controlBuildMetricsJson(doc);
+    schedBuildMetricsJson(doc);
+    batteryAdcBuildMetricsJson(doc);
+    rippleAnalysisBuildMetricsJson(doc);
+    crankMonitorBuildMetricsJson(doc);
+    lampMonitorBuildMetricsJson(doc);
+    loadShedBuildMetricsJson(doc);
+    powerBuildMetricsJson(doc);
+    String out;
+    serializeJson(doc, out);
+    req->send(200, "application/json", out);
+  });
+
+  server.on("/api/battery", HTTP_GET, [](AsyncWebServerRequest* req) {
+    JsonDocument doc;
+    batteryHealthBuildJson(doc);
+    doc["rippleAvailable"] = rippleAnalysisAvailable();
+    String out;
+    serializeJson(doc, out);
+    req->send(200, "application/json", out);
+  });
+
+  server.on("/api/energy", HTTP_GET, [](AsyncWebServerRequest* req) {
+    JsonDocument doc;
+    energyBuildJson(doc);
+    String out;
+    serializeJson(doc, out);
+    req->send(200, "application/json", out);
+  });
+
   server.on("/api/settings", HTTP_GET, [](AsyncWebServerRequest* req) {
     JsonDocument doc;
-    buildSettingsJson(doc);
+    buildSettingsJson(doc, webPendingOrCurrent());
     String out;
     serializeJson(doc, out);
     req->send(200, "application/json", out);
@@ -354,35 +561,9 @@ void webInit() {
 
   server.begin();
   LOG_I("HTTP server started on port 80");
-}
 
-void webUpdate() {
-  unsigned long now = millis();
-  if (now - lastBroadcast < BROADCAST_INTERVAL_MS) return;
-  lastBroadcast = now;
-
-  // Cleanup dead connections
-  ws.cleanupClients();
-
-  if (ws.count() == 0) return;
-
-  // Build and broadcast state
-  JsonDocument doc;
-  buildStateJson(doc);
-  String out;
-  serializeJson(doc, out);
-  ws.textAll(out);
-
-  // Also send keyless status periodically
-  static unsigned long lastKeyless = 0;
-  if (now - lastKeyless > 500) {
-    lastKeyless = now;
-    JsonDocument kdoc;
-    bleKeylessBuildJson(kdoc);
-    String kout;
-    serializeJson(kdoc, kout);
-    ws.textAll(kout);
-  }
+  schedEvery(SCHED_COMMS, "ws_state", BROADCAST_INTERVAL_MS, broadcastState, SCHED_SHEDDABLE);
+  schedEvery(SCHED_COMMS, "ws_keyless", KEYLESS_BROADCAST_MS, broadcastKeyless, SCHED_SHEDDABLE);
 }
 
 void webLog(const char* text) {
@@ -394,3 +575,21 @@ void webLog(const char* text) {
   serializeJson(doc, out);
   ws.textAll(out);
 }
+
+bool webHasNewSettings() { return newSettingsAvailable; }
+
+Settings webGetNewSettings() {
+  portENTER_CRITICAL(&settingsMux);
+  Settings s = pendingSettings;
+  newSettingsAvailable = false;
+  portEXIT_CRITICAL(&settingsMux);
+  return s;
+}
+
+bool webApActive() {
+  return WiFi.getMode() & WIFI_AP;
+}
+
+size_t webClientCount() {
+  return ws.count();
+}
@@ -1,8 +1,14 @@
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <iostream>
+#include <chrono>
 #include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "../include/time_base.h"
 
 // ============================================================================
 // Simulated types from the firmware (standalone test, no Arduino deps)
@@ -70,6 +76,8 @@ struct StarterSim {
   bool starterEngaged = false;
   bool engineRunning = false;
   bool killActive = false;
+  bool tracking = false;   // crankMonitorTracking(): signature seen on DMA blocks
+  bool caught = false;     // crankMonitorCaught()
   unsigned long starterStartTime = 0;
   static constexpr unsigned long ENGAGE_DELAY = 1500;
   static constexpr unsigned long MAX_DURATION = 5000;
@@ -84,7 +92,13 @@ struct StarterSim {
   void holdStart(unsigned long now) {
     if (!starterEngaged) return;
     unsigned long elapsed = now - starterStartTime;
-    if (elapsed >= ENGAGE_DELAY && !engineRunning) {
+    if (caught) {
+      caught = false;
+      starterEngaged = false;
+      engineRunning = true;
+      return;
+    }
+    if (!tracking && elapsed >= ENGAGE_DELAY && !engineRunning) {
       engineRunning = true;
       killActive = false;
     }
@@ -129,6 +143,941 @@ struct VoltageSim {
   }
 };
 
+// ============================================================================
+// Vertical-counter debounce simulation (packed input word)
+// ============================================================================
+
+struct VerticalDebounceSim {
+  uint16_t state = 0;
+  uint16_t cnt0 = 0, cnt1 = 0, cnt2 = 0;
+  // clk: bits due for a sample this pass (per-input sample period)
+  void sample(uint16_t raw, uint16_t clk = 0xFFFF) {
+    uint16_t delta = raw ^ state;
+    uint16_t inc = delta & clk;
+    uint16_t rst = ~delta & clk;
+    cnt2 = (cnt2 ^ (cnt1 & cnt0 & inc)) & ~rst;
+    cnt1 = (cnt1 ^ (cnt0 & inc)) & ~rst;
+    cnt0 = (cnt0 ^ inc) & ~rst;
+    state ^= inc & ~(cnt0 | cnt1 | cnt2);
+  }
+};
+
+// Per-input sample clock: idle bits sampled every pass, counting bits on
+// their own period from the first sample, counter preloaded so the last
+// sample lands debounceMs later (mirrors inputsApplyDebounceProfile() and
+// inputsSample())
+struct DebounceClockSim {
+  VerticalDebounceSim v;
+  uint32_t periodUs[16] = {};
+  int64_t  next[16] = {};
+  uint16_t pre0 = 0, pre1 = 0, pre2 = 0;
+  void profile(int bit, uint8_t ms) {
+    int n = std::min(std::max(ms + 1, 2), 8);
+    int pre = 8 + 1 - n;
+    uint16_t b = (uint16_t)(1u << bit);
+    periodUs[bit] = (uint32_t)ms * 1000 / (n - 1);
+    pre0 = (pre0 & ~b) | ((pre & 1) ? b : 0);
+    pre1 = (pre1 & ~b) | ((pre & 2) ? b : 0);
+    pre2 = (pre2 & ~b) | ((pre & 4) ? b : 0);
+  }
+  void sample(uint16_t raw, int64_t nowUs) {
+    uint16_t idle = ~(v.cnt0 | v.cnt1 | v.cnt2), clk = idle;
+    for (int i = 0; i < 16; i++) {
+      if (!((idle >> i) & 1) && nowUs >= next[i]) { clk |= 1u << i; next[i] += periodUs[i]; }
+    }
+    uint16_t start = (raw ^ v.state) & clk & idle;
+    v.sample(raw, clk);
+    v.cnt0 = (v.cnt0 & ~start) | (pre0 & start);
+    v.cnt1 = (v.cnt1 & ~start) | (pre1 & start);
+    v.cnt2 = (v.cnt2 & ~start) | (pre2 & start);
+    for (int i = 0; i < 16; i++) if ((start >> i) & 1) next[i] = nowUs + periodUs[i];
+  }
+};
+
+// ============================================================================
+// Speed sensor edge capture simulation (ISR + period timestamping)
+// ============================================================================
+
+struct SpeedCaptureSim {
+  static constexpr int64_t MIN_PERIOD_US = 100;
+  uint32_t pulseCount = 0;
+  int64_t  lastEdgeUs = 0;
+  uint32_t periodUs = 0;
+  void edge(int64_t nowUs) {          // Mirrors speedEdgeISR()
+    if (lastEdgeUs != 0) {
+      int64_t dt = nowUs - lastEdgeUs;
+      if (dt < MIN_PERIOD_US) return;
+      periodUs = (uint32_t)dt;
+    }
+    lastEdgeUs = nowUs;
+    pulseCount++;
+  }
+  float hz() const { return periodUs ? 1000000.0f / periodUs : 0.0f; }
+};
+
+// Host pulse generator: square wave at hz with a deterministic ±2% period jitter
+// and an optional bounce edge 20µs after each real edge.
+template <typename Fn>
+static uint32_t generatePulses(double hz, double seconds, bool bounce, Fn edge) {
+  uint32_t n = (uint32_t)(hz * seconds);
+  double period = 1000000.0 / hz;
+  double t = 1000.0;
+  for (uint32_t i = 0; i < n; i++) {
+    double jitter = ((int)(i * 7919 % 41) - 20) * 0.001 * period;
+    int64_t us = (int64_t)(t + jitter);
+    edge(us);
+    if (bounce) edge(us + 20);
+    t += period;
+  }
+  return n;
+}
+
+// ============================================================================
+// Brake safety fast path simulation (asserting edge bypasses debounce)
+// ============================================================================
+
+struct BrakeFastPathSim {
+  static constexpr uint16_t BRAKE = 1u << 6;
+  VerticalDebounceSim db;
+  bool output = false;
+  void isrEdge(bool pressed) { if (pressed) output = true; }   // Mirrors brakeEdgeISR()
+  void sample(uint16_t raw) {                                  // Mirrors inputsSample()
+    uint16_t asserted = raw & BRAKE;
+    db.state |= asserted;
+    db.cnt0 &= ~asserted; db.cnt1 &= ~asserted; db.cnt2 &= ~asserted;
+    db.sample(raw);
+    output = (db.state & BRAKE) != 0;                          // updateBrakeLight()
+  }
+};
+
+// ============================================================================
+// Output word commit simulation (W1TS / W1TC per bank)
+// ============================================================================
+
+struct OutputBankSim {
+  uint32_t target = 0, applied = 0, dirty = 0, pwm = 0, fastOn = 0, fastOff = 0;
+  uint32_t lastSet = 0, lastClr = 0;
+  int      writes = 0;
+  void fastWrite(uint32_t bit, bool level) {        // Mirrors gpioFastWrite()
+    if (level) { applied |= bit;  target |= bit;  fastOn |= bit;  fastOff &= ~bit; }
+    else       { applied &= ~bit; target &= ~bit; fastOff |= bit; fastOn &= ~bit;  }
+  }
+  void attach(uint32_t bit) { pwm |= bit; target &= ~bit; }   // Mirrors channelAttach()
+  void release(uint32_t bit, bool on) {             // Mirrors releasePwm()
+    if (on) target |= bit; else target &= ~bit;
+    pwm &= ~bit; dirty |= bit;
+  }
+  void commit() {                                   // Mirrors outputsCommit()
+    lastSet = lastClr = 0;
+    target = (target | fastOn) & ~fastOff;
+    uint32_t changed = ((target ^ applied) | dirty) & ~pwm;
+    if (!changed) return;
+    lastSet = changed & target;
+    lastClr = changed & ~target;
+    writes += (lastSet != 0) + (lastClr != 0);
+    applied = (applied & ~changed) | lastSet;
+    dirty = 0;
+  }
+};
+
+// ============================================================================
+// Output arbiter simulation (highest-priority layer with a request wins)
+// ============================================================================
+
+struct ArbiterSim {
+  enum { SAFETY, SERVICE, ALARM, HAZARD, USER, PARKING, LAYERS };
+  uint16_t mask[LAYERS] = {};
+  uint8_t  duty[LAYERS][16] = {};
+  uint8_t  outDuty[16] = {};
+  int      outLayer[16] = {};
+  void request(int layer, int out, uint8_t d) { mask[layer] |= 1u << out; duty[layer][out] = d; }
+  void arbitrate() {                                // Mirrors outputsArbitrate()
+    for (int i = 0; i < 16; i++) {
+      outLayer[i] = -1; outDuty[i] = 0;
+      for (int l = 0; l < LAYERS; l++)
+        if (mask[l] & (1u << i)) { outLayer[i] = l; outDuty[i] = duty[l][i]; break; }
+    }
+    for (int l = 0; l < LAYERS; l++) mask[l] = 0;
+  }
+};
+
+// ============================================================================
+// Light pattern player simulation ({ms, duty, repeat} evaluated by time)
+// ============================================================================
+
+struct PatternSeg { uint16_t ms; uint8_t duty; uint8_t repeat; };
+struct LightPattern { const PatternSeg* seg; uint8_t count; };
+static const uint8_t  PATTERN_FOREVER = 0xFF;
+static const uint32_t PATTERN_NEVER   = 0xFFFFFFFFu;
+
+static uint32_t patternCycleMs(const LightPattern& p) {
+  uint32_t total = 0, group = 0;
+  for (uint8_t i = 0; i < p.count; i++) {
+    const PatternSeg& s = p.seg[i];
+    if (s.ms == 0 || s.repeat == PATTERN_FOREVER) return 0;
+    group += s.ms;
+    if (s.repeat != 0 || i + 1 == p.count) { total += group * (s.repeat ? s.repeat : 1); group = 0; }
+  }
+  return total;
+}
+
+static uint8_t patternEval(const LightPattern& p, uint32_t elapsedMs, uint32_t* msToNext) {
+  uint32_t cycle = patternCycleMs(p);             // Mirrors light_patterns.cpp
+  uint32_t t = cycle ? elapsedMs % cycle : elapsedMs;
+  uint8_t first = 0;
+  uint32_t groupMs = 0;
+  for (uint8_t i = 0; i < p.count; i++) {
+    const PatternSeg& s = p.seg[i];
+    if (s.ms == 0) { *msToNext = PATTERN_NEVER; return s.duty; }
+    groupMs += s.ms;
+    bool groupEnd = s.repeat != 0 || i + 1 == p.count || p.seg[i + 1].ms == 0;
+    if (!groupEnd) continue;
+    bool forever = s.repeat == PATTERN_FOREVER;
+    uint32_t plays = forever ? 1 : (s.repeat ? s.repeat : 1);
+    if (forever || t < groupMs * plays) {
+      t %= groupMs;
+      for (uint8_t k = first; k <= i; k++) {
+        if (t < p.seg[k].ms) { *msToNext = p.seg[k].ms - t; return p.seg[k].duty; }
+        t -= p.seg[k].ms;
+      }
+    }
+    t -= groupMs * plays;
+    first = i + 1;
+    groupMs = 0;
+  }
+  *msToNext = PATTERN_NEVER;
+  return 0;
+}
+
+// Custom brake upload check (mirrors brakePatternSafe(): min duty 80, 500 ms dark)
+static bool brakePatternSafe(const PatternSeg* seg, uint8_t count) {
+  const uint8_t MIN_DUTY = 80;
+  const uint32_t MAX_DARK = 500;
+  if (count == 0) return true;
+  if (seg[0].duty < MIN_DUTY) return false;
+  uint32_t dark = 0;
+  uint8_t first = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    const PatternSeg& s = seg[i];
+    if (s.ms == 0) return s.duty >= MIN_DUTY;
+    bool groupEnd = s.repeat != 0 || i + 1 == count || seg[i + 1].ms == 0;
+    if (!groupEnd) continue;
+    bool forever = s.repeat == PATTERN_FOREVER;
+    uint32_t plays = forever ? 2 : (s.repeat ? s.repeat : 1);
+    bool lit = false;
+    uint32_t groupMs = 0;
+    for (uint8_t k = first; k <= i; k++) { lit |= seg[k].duty >= MIN_DUTY; groupMs += seg[k].ms; }
+    if (!lit) {
+      if (forever) return false;
+      dark += groupMs * plays;
+      if (dark > MAX_DARK) return false;
+    } else {
+      for (uint32_t n = 0; n < plays && n < 2; n++)
+        for (uint8_t k = first; k <= i; k++) {
+          if (seg[k].duty >= MIN_DUTY) dark = 0;
+          else if ((dark += seg[k].ms) > MAX_DARK) return false;
+        }
+    }
+    if (forever) return true;
+    first = i + 1;
+  }
+  return true;
+}
+
+// Old hand-coded brake flash: toggle every 200ms from a lit start
+static bool oldBrakeFlash(uint32_t elapsed, uint32_t flashUntil, uint32_t flashFrom = 0) {
+  if (elapsed < flashFrom) return true;
+  if (elapsed >= flashUntil) return true;
+  return ((elapsed - flashFrom) / 200 + (flashFrom ? 1 : 0)) % 2 == 0;
+}
+
+// ============================================================================
+// LEDC channel pool simulation (pairs share a timer)
+// ============================================================================
+
+struct ChannelPoolSim {
+  struct Ch { int pin = -1; uint32_t freq = 0; int allocs = 0; } ch[8];
+  int setups = 0;
+  bool compatible(int c, uint32_t f) const { return ch[c ^ 1].pin < 0 || ch[c ^ 1].freq == f; }
+  int find(int pin) const { for (int c = 0; c < 8; c++) if (ch[c].pin == pin) return c; return -1; }
+  int use(int pin, uint32_t f) {                    // Mirrors outputPWM() → channelAlloc()
+    int c = find(pin);
+    if (c >= 0) return c;                           // Sticky: no re-attach
+    for (c = 0; c < 8; c++) {
+      if (ch[c].pin < 0 && compatible(c, f)) { ch[c].pin = pin; ch[c].freq = f; setups++; return c; }
+    }
+    return -1;
+  }
+};
+
+// ============================================================================
+// Fixed-rate control tick statistics
+// ============================================================================
+
+struct TickStatsSim {
+  int64_t scheduledUs = 0;
+  uint32_t ticks = 0, overruns = 0, jitterMaxUs = 0, execMaxUs = 0;
+  // Mirrors controlTaskMain(): tick starts at startUs and runs execUs, then
+  // the task is released at wakeUs
+  void tick(int64_t startUs, uint32_t execUs, int64_t wakeUs) {
+    if (execUs > execMaxUs) execMaxUs = execUs;
+    ticks++;
+    int64_t d = startUs - scheduledUs;
+    uint32_t j = (uint32_t)(d < 0 ? -d : d);
+    if (j > jitterMaxUs) jitterMaxUs = j;
+    scheduledUs += 1000;
+    if (wakeUs - scheduledUs >= 1000) { overruns++; scheduledUs = wakeUs; }
+  }
+};
+
+// ============================================================================
+// Hierarchical timer wheel (3 × 64 slots) simulation
+// ============================================================================
+
+struct WheelSim {
+  struct J { uint32_t expiry = 0, period = 0, runs = 0, late = 0; int8_t next = -1; uint8_t level = 0, slot = 0; };
+  J jobs[8];
+  int8_t head[3][64];
+  uint32_t now, tick;
+  explicit WheelSim(uint32_t start) : now(start), tick(start) {
+    for (auto& l : head) for (auto& h : l) h = -1;
+  }
+  void insert(int8_t i) {                           // Mirrors scheduler.cpp insert()
+    uint32_t delta = jobs[i].expiry - now;
+    if (delta >= (1u << 18)) delta = (1u << 18) - 1;
+    uint32_t at = now + delta;
+    uint8_t lv = delta < 64 ? 0 : delta < 4096 ? 1 : 2;
+    jobs[i].level = lv; jobs[i].slot = (at >> (6 * lv)) & 63;
+    jobs[i].next = head[lv][jobs[i].slot]; head[lv][jobs[i].slot] = i;
+  }
+  void cascade(uint8_t lv, uint8_t slot) {
+    int8_t i = head[lv][slot]; head[lv][slot] = -1;
+    while (i >= 0) { int8_t n = jobs[i].next; insert(i); i = n; }
+  }
+  void arm(int8_t i, uint32_t delay, uint32_t period) {
+    jobs[i].period = period;
+    jobs[i].expiry = tick + delay;
+    if ((int32_t)(jobs[i].expiry - now) <= 0) jobs[i].expiry = now + 1;
+    insert(i);
+  }
+  void run(uint32_t target) {                       // Mirrors advance() + runJob()
+    tick = target;
+    while ((int32_t)(target - now) > 0) {
+      uint32_t t = ++now;
+      if ((t & 63) == 0) {
+        if (((t >> 6) & 63) == 0) cascade(2, (t >> 12) & 63);
+        cascade(1, (t >> 6) & 63);
+      }
+      int8_t i;
+      while ((i = head[0][t & 63]) >= 0) {
+        head[0][t & 63] = jobs[i].next;
+        J& j = jobs[i];
+        assert(j.expiry == t);                      // Never early, never skipped
+        j.runs++;
+        j.late += tick - j.expiry;
+        if (j.period) {
+          uint32_t next = j.expiry + j.period;
+          if ((int32_t)(next - tick) <= 0) next = tick + j.period;
+          j.expiry = next; insert(i);
+        }
+      }
+    }
+  }
+};
+
+// ============================================================================
+// Per-iteration budget: sheddable jobs skipped once the budget is spent
+// ============================================================================
+
+struct BudgetSim {
+  struct J { bool sheddable; uint32_t costUs, period, expiry, runs = 0, shed = 0; };
+  uint32_t budgetUs = 5000, overIterations = 0;
+  // Mirrors runJob() + budgetSpent() for the jobs due in one iteration
+  void iteration(J* jobs, int n, uint32_t nowMs) {
+    uint32_t usedUs = 0;
+    bool over = false;
+    for (int i = 0; i < n; i++) {
+      J& j = jobs[i];
+      if (j.expiry != nowMs) continue;
+      if (j.sheddable && (over || usedUs >= budgetUs)) {
+        if (!over) overIterations++;
+        over = true;
+        j.shed++;
+      } else {
+        usedUs += j.costUs;
+        j.runs++;
+      }
+      j.expiry += j.period;
+    }
+  }
+};
+
+// ============================================================================
+// Battery ADC: integer calibration + decimation + IIR
+// ============================================================================
+
+struct BatteryFilterSim {
+  int32_t knot[17];
+  int32_t filtQ8 = -1, rippleQ8 = 0;
+  BatteryFilterSim() { for (int k = 0; k < 17; k++) knot[k] = k * 256 * 3100 / 4095; }
+  int32_t caliToMv(uint32_t rawQ8) const {          // Mirrors battery_adc.cpp
+    uint32_t idx = rawQ8 >> 16, frac = rawQ8 & 0xFFFF;
+    if (idx >= 16) return knot[16];
+    return knot[idx] + (int32_t)(((int64_t)(knot[idx + 1] - knot[idx]) * frac) >> 16);
+  }
+  static int32_t toBattery(int32_t mv) { return mv * 57 / 10; }
+  void block(uint32_t sum, uint16_t count, uint16_t mn, uint16_t mx) {
+    int32_t mean = toBattery(caliToMv((sum << 8) / count));
+    int32_t p2p  = toBattery(caliToMv((uint32_t)mx << 8)) - toBattery(caliToMv((uint32_t)mn << 8));
+    if (filtQ8 < 0) { filtQ8 = mean << 8; rippleQ8 = p2p << 8; return; }
+    filtQ8   += ((mean << 8) - filtQ8) >> 3;
+    rippleQ8 += ((p2p << 8) - rippleQ8) >> 3;
+  }
+};
+
+// ============================================================================
+// Alarm auto-arm / trigger on the 64-bit time base (host clock injected)
+// ============================================================================
+
+static TimeUs hostClockUs = 0;
+static TimeUs hostNow() { return hostClockUs; }
+
+struct AlarmTimingSim {
+  TimeSource clock = hostNow;
+  bool armed = false, triggered = false;
+  TimeUs armStart = TIME_NONE, triggerTime = TIME_NONE;
+  void update(bool ignition, bool hit) {           // Mirrors updateAlarm()
+    TimeUs now = clock();
+    if (ignition) { armed = triggered = false; armStart = TIME_NONE; return; }
+    if (triggered) {
+      if (now >= triggerTime + usFromMs(30000)) triggered = false;
+      return;
+    }
+    if (!armed) {
+      if (!timeIsSet(armStart)) armStart = now;
+      if (timeElapsed(armStart, usFromMs(30000), now)) { armed = true; armStart = TIME_NONE; }
+      return;
+    }
+    if (hit) { triggered = true; triggerTime = now; }
+  }
+};
+
+// ============================================================================
+// Charging ripple: portable radix-2 FFT + rectifier classifier
+// ============================================================================
+
+struct RippleSim {
+  static constexpr int N = 1024;
+  static constexpr float BIN_HZ = 20000.0f / N;
+  static constexpr int BIN_MIN = (50 * N + 20000 - 1) / 20000;
+  enum { DIODE = 0x20, OPEN = 0x40, OVER = 0x80 };
+  float buf[2 * N], window[N], mag[N / 2], twRe[N / 2], twIm[N / 2];
+  float p2p = 0, hz = 0, thd = 0, rpm = 0, rpmPrev = 0;
+  int polePairs = 6;
+  uint16_t tracked = 0;
+  RippleSim() {
+    for (int i = 0; i < N; i++) window[i] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / N);
+    for (int k = 0; k < N / 2; k++) {
+      twRe[k] = cosf(2.0f * (float)M_PI * k / N);
+      twIm[k] = -sinf(2.0f * (float)M_PI * k / N);
+    }
+  }
+  void fft(float* x) {                                 // Mirrors fftRun() (portable)
+    for (int i = 1, j = 0; i < N; i++) {
+      int bit = N >> 1;
+      for (; j & bit; bit >>= 1) j ^= bit;
+      j ^= bit;
+      if (i < j) { std::swap(x[2 * i], x[2 * j]); std::swap(x[2 * i + 1], x[2 * j + 1]); }
+    }
+    for (int len = 2; len <= N; len <<= 1) {
+      int half = len >> 1, step = N / len;
+      for (int i = 0; i < N; i += len) {
+        for (int k = 0; k < half; k++) {
+          float wr = twRe[k * step], wi = twIm[k * step];
+          float* a = &x[2 * (i + k)];
+          float* b = &x[2 * (i + k + half)];
+          float tr = b[0] * wr - b[1] * wi, ti = b[0] * wi + b[1] * wr;
+          b[0] = a[0] - tr; b[1] = a[1] - ti; a[0] += tr; a[1] += ti;
+        }
+      }
+    }
+  }
+  float lineAt(int k) const {
+    float a = mag[k];
+    if (k > 1 && mag[k - 1] > a) a = mag[k - 1];
+    if (k + 1 < N / 2 && mag[k + 1] > a) a = mag[k + 1];
+    return a;
+  }
+  uint8_t analyse(const float* mv) {                   // Mirrors analyse()
+    float sum = 0, mn = mv[0], mx = mv[0];
+    for (int i = 0; i < N; i++) { sum += mv[i]; mn = std::min(mn, mv[i]); mx = std::max(mx, mv[i]); }
+    float mean = sum / N;
+    p2p = mx - mn; hz = 0; thd = 0; rpm = 0;
+    uint8_t v = mean / 1000.0f > 14.8f ? OVER : 0;
+    for (int i = 0; i < N; i++) { buf[2 * i] = (mv[i] - mean) * window[i]; buf[2 * i + 1] = 0; }
+    fft(buf);
+    float peak = 0, total = 0;
+    for (int k = 1; k < N / 2; k++) {
+      mag[k] = sqrtf(buf[2 * k] * buf[2 * k] + buf[2 * k + 1] * buf[2 * k + 1]);
+      if (k < BIN_MIN) continue;
+      total += mag[k];
+      peak = std::max(peak, mag[k]);
+    }
+    if (peak < 10.0f * total / (N / 2 - BIN_MIN)) return v;
+    int k0 = 0;
+    for (int k = BIN_MIN; k < N / 2 - 1 && !k0; k++)
+      if (mag[k] >= 0.5f * peak && mag[k] >= mag[k - 1] && mag[k] >= mag[k + 1]) k0 = k;
+    if (!k0) return v;
+    float h2 = 0;
+    for (int h = 2; h <= 6 && k0 * h < N / 2; h++) { float a = lineAt(k0 * h); h2 += a * a; }
+    float a = mag[k0 - 1], b = mag[k0], c = mag[k0 + 1];
+    float d = a - 2 * b + c < 0 ? 0.5f * (a - c) / (a - 2 * b + c) : 0;
+    hz = (k0 + d) * BIN_HZ;
+    thd = sqrtf(h2) / mag[k0];
+    if (p2p >= 100) {
+      if (thd >= 0.6f) v |= DIODE;
+      else if (p2p >= 250) v |= OPEN;
+    }
+    float pulses = (v & DIODE) ? 1 : (v & OPEN) ? 2 : 6;
+    rpm = hz / pulses * 60.0f / polePairs;
+    return v;
+  }
+  void track() {                                       // Mirrors trackRpm()
+    bool agree = rpm > 0 && rpmPrev > 0 && std::fabs(rpm - rpmPrev) <= 0.2f * rpmPrev;
+    rpmPrev = rpm;
+    if (rpm <= 0) tracked = 0;
+    else if (agree) tracked = (uint16_t)(rpm + 0.5f);
+  }
+  uint16_t published(bool available) const {          // Mirrors rippleAnalysisRpm()
+    return available ? tracked : 0xFFFF;
+  }
+  static bool runningAt(uint16_t rpm) {               // Mirrors handleStart()
+    return rpm != 0xFFFF && rpm >= 600;
+  }
+};
+
+// Battery rail (mV) behind a 3-phase bridge: charge current flows while the
+// rectified line-line voltage exceeds the battery, through its internal R.
+// fault: 0 = healthy, 1 = one high-side diode open, 2 = one phase open
+static void rippleWaveform(float* mv, int n, double fe, double vpk, int fault,
+                           double vbat = 13.6, uint32_t seed = 1) {
+  for (int i = 0; i < n; i++) {
+    double t = i / 20000.0, hi = -1e9, lo = 1e9;
+    for (int p = 0; p < (fault == 2 ? 2 : 3); p++) {
+      double v = vpk / std::sqrt(3.0) * std::sin(2 * M_PI * fe * t + p * 2 * M_PI / 3);
+      if (!(fault == 1 && p == 0)) hi = std::max(hi, v);
+      lo = std::min(lo, v);
+    }
+    double amps = std::min(20.0, std::max(0.0, hi - lo - 0.8 - vbat) / 0.5);
+    seed = seed * 1664525u + 1013904223u;
+    double noise = (int)((seed >> 16) % 41) - 20;                // ±20 mV ADC noise
+    mv[i] = (float)((vbat + 0.03 * amps) * 1000.0 + noise);
+  }
+}
+
+// ============================================================================
+// Crank monitor: inrush sag → plateau → recovery on 12.8 ms ADC blocks
+// ============================================================================
+
+struct CrankSim {
+  enum { IDLE, INRUSH, CRANKING, DONE } phase = IDLE;
+  int32_t rest = 0, dip = 0, plateau = 0;
+  int64_t sum = 0;
+  int n = 0, recovered = 0;
+  long firstRecovered = 0, catchMs = 0;
+  bool signature = false, caught = false;
+  void block(bool starter, long tMs, int32_t mv) {  // Mirrors onBlock()
+    if (!starter) { phase = IDLE; rest = rest ? rest + ((mv - rest) >> 2) : mv; return; }
+    switch (phase) {
+      case IDLE:
+        dip = mv; sum = 0; n = 0; recovered = 0; catchMs = 0; caught = signature = false;
+        phase = INRUSH;
+        // fall through
+      case INRUSH:
+        dip = std::min(dip, mv);
+        if (tMs < 150) break;
+        if (rest - dip < 1000) { phase = DONE; break; }
+        signature = true;
+        phase = CRANKING;
+        // fall through
+      case CRANKING: {
+        int32_t p = n ? (int32_t)(sum / n) : mv;
+        int32_t target = p + (rest - p) * 60 / 100;
+        if (tMs >= 300 && n && mv >= target) {
+          if (recovered++ == 0) firstRecovered = tMs;
+          if (recovered >= 3) { plateau = p; catchMs = firstRecovered; caught = true; phase = DONE; }
+        } else {
+          recovered = 0; sum += mv; n++;
+        }
+        break;
+      }
+      case DONE: break;
+    }
+  }
+};
+
+// Block-mean battery voltage around a start: rest, inrush dip, cranking
+// plateau with compression pulses, then recovery once the engine fires
+static int32_t crankProfileMv(long tMs, long catchAt, int32_t rest, int32_t crank) {
+  if (tMs < 0) return rest;
+  if (tMs < 40) return rest - (rest - crank) * 2;                 // Inrush
+  double comp = 250.0 * std::sin(2 * M_PI * tMs / 180.0);          // Compression strokes
+  if (catchAt < 0 || tMs < catchAt) return crank + (int32_t)comp;
+  double k = std::min(1.0, (tMs - catchAt) / 60.0);                // Starter overruns
+  return crank + (int32_t)((rest - 200 - crank) * k);
+}
+
+// ============================================================================
+// Battery health: crank sag → internal resistance → SoH, rotating NVS keys
+// ============================================================================
+
+struct BatteryHealthSim {
+  static constexpr int HISTORY = 16, MEDIAN = 5, BASELINE = 5;
+  struct Rec { uint32_t crank; uint16_t rCenti; uint16_t dip10mV; };
+  uint64_t nvs[HISTORY] = {};                       // Key c<i>
+  uint32_t nvsWrites[HISTORY] = {};
+  Rec hist[HISTORY] = {};
+  uint8_t head = 0;
+  uint32_t crankNo = 0, baseStart = 0;
+  uint16_t r0 = 0, rNow = 0;
+  uint8_t soh = 0xFF;
+  void load() {                                     // Mirrors load(): head from newest key
+    crankNo = 0; head = 0;
+    for (int i = 0; i < HISTORY; i++) {
+      uint64_t v = nvs[i];
+      hist[i] = { (uint32_t)(v >> 32), (uint16_t)(v >> 16), (uint16_t)v };
+      if (hist[i].crank > crankNo) { crankNo = hist[i].crank; head = (i + 1) % HISTORY; }
+    }
+  }
+  uint16_t median(int n) const {
+    uint16_t r[HISTORY]; int c = 0;
+    for (int i = 1; i <= HISTORY && c < n; i++) {
+      const Rec& x = hist[(head + HISTORY - i) % HISTORY];
+      if (x.crank == 0 || x.crank <= baseStart) break;
+      r[c++] = x.rCenti;
+    }
+    if (!c) return 0;
+    std::sort(r, r + c);
+    return r[c / 2];
+  }
+  void publish() {
+    rNow = median(MEDIAN);
+    soh = 0xFF;
+    if (r0 && rNow) {
+      float pct = 100.0f * (2.0f * r0 - rNow) / ((2.0f - 1.0f) * r0);
+      soh = (uint8_t)std::min(100.0f, std::max(0.0f, pct));
+    }
+  }
+  void crank(int32_t restMv, int32_t dipMv) {       // Mirrors record()
+    uint32_t r = (uint32_t)80 * 100 * (restMv - dipMv) / dipMv;
+    hist[head] = { ++crankNo, (uint16_t)std::min(r, (uint32_t)UINT16_MAX), (uint16_t)(dipMv / 10) };
+    const Rec& h = hist[head];
+    nvs[head] = (uint64_t)h.crank << 32 | (uint32_t)h.rCenti << 16 | h.dip10mV;
+    nvsWrites[head]++;
+    head = (head + 1) % HISTORY;
+    if (!r0 && crankNo - baseStart >= BASELINE) r0 = median(BASELINE);
+    publish();
+  }
+};
+
+// ============================================================================
+// Lamp monitor: battery voltage step per output edge → current → open bulb
+// ============================================================================
+
+struct LampSim {
+  static constexpr int OUTS = 11, LAMPS = 6, SETTLE_MS = 40, AVG = 2, TIMEOUT_MS = 200;
+  static constexpr int MIN_MA = 500, OPEN_PCT = 30, OK_PCT = 60, CONFIRM = 3;
+  static constexpr int BLOCK_MS = 13;               // ~256 samples at 20 kHz
+  int8_t lampOf[OUTS] = {0, 1, 2, 3, 4, -1, -1, -1, -1, 5, -1};
+  uint8_t prevDuty[OUTS] = {};
+  uint16_t baseMa[LAMPS] = {}, lastMa[LAMPS] = {};
+  uint8_t openStreak[LAMPS] = {}, okStreak[LAMPS] = {};
+  uint32_t calSum[LAMPS] = {}; uint8_t calCount[LAMPS] = {};
+  uint8_t faults = 0;
+  bool calibrating = false, engineRunning = false;
+  float rint = 0.0f;
+  int8_t active = -1; bool activeOn = false; uint8_t activeDuty = 0;
+  int64_t edgeAt = 0;
+  int32_t lastMv = 0, preMv = 0, postSum = 0; uint8_t postBlocks = 0;
+  uint32_t measured = 0, dropped = 0;
+
+  void judge(int i, int32_t stepMv) {               // Mirrors judge()
+    float r = rint > 0.0f ? rint : 25.0f;
+    uint32_t ma = stepMv > 0 ? (uint32_t)(stepMv * 1000.0f / r) * 255 / activeDuty : 0;
+    lastMa[i] = (uint16_t)std::min(ma, (uint32_t)UINT16_MAX);
+    measured++;
+    if (calibrating) { calSum[i] += lastMa[i]; calCount[i]++; return; }
+    if ((uint32_t)baseMa[i] * activeDuty / 255 < MIN_MA) return;
+    uint8_t bit = (uint8_t)(1u << i);
+    uint32_t pct = (uint32_t)lastMa[i] * 100 / baseMa[i];
+    if (pct < OPEN_PCT) {
+      okStreak[i] = 0;
+      if (openStreak[i] < CONFIRM) openStreak[i]++;
+      if (openStreak[i] >= CONFIRM) faults |= bit;
+    } else if (pct >= OK_PCT) {
+      openStreak[i] = 0;
+      if (okStreak[i] < CONFIRM) okStreak[i]++;
+      if (okStreak[i] >= CONFIRM) faults &= ~bit;
+    }
+  }
+  void block(int64_t nowMs, int32_t meanMv) {      // Mirrors onBlock()
+    if (active < 0) { lastMv = meanMv; return; }
+    if (nowMs < edgeAt + SETTLE_MS + BLOCK_MS) return;
+    postSum += meanMv;
+    if (++postBlocks < AVG) return;
+    int32_t postMv = postSum / AVG;
+    judge(active, activeOn ? preMv - postMv : postMv - preMv);
+    active = -1;
+    lastMv = meanMv;
+  }
+  void learn(bool on) {                             // Mirrors lampMonitorLearn()
+    if (on) { calibrating = true; for (int i = 0; i < LAMPS; i++) { calSum[i] = 0; calCount[i] = 0; } return; }
+    if (!calibrating) return;
+    calibrating = false;
+    for (int i = 0; i < LAMPS; i++) {
+      if (!calCount[i]) continue;
+      baseMa[i] = (uint16_t)(calSum[i] / calCount[i]);
+      openStreak[i] = okStreak[i] = 0;
+    }
+    faults = 0;
+  }
+  void update(int64_t nowMs, const uint8_t* duty) { // Mirrors lampMonitorUpdate()
+    int changed = -1; uint8_t changes = 0;
+    for (int i = 0; i < OUTS; i++) if (duty[i] != prevDuty[i]) { changed = i; changes++; }
+    if (active >= 0 && (changes || nowMs - edgeAt > TIMEOUT_MS)) { active = -1; dropped++; }
+    if (active < 0 && changes == 1 && lampOf[changed] >= 0 && lastMv > 0 && !engineRunning) {
+      uint8_t was = prevDuty[changed], is = duty[changed];
+      if ((was == 0) != (is == 0)) {
+        active = lampOf[changed]; activeOn = is != 0; activeDuty = activeOn ? is : was;
+        edgeAt = nowMs; preMv = lastMv; postSum = 0; postBlocks = 0;
+      }
+    }
+    memcpy(prevDuty, duty, sizeof(prevDuty));
+  }
+};
+
+// Bike model: 1 ms ticks, battery = rest − ΣI·R with filament inrush and block noise
+struct LampBench {
+  LampSim m;
+  uint8_t duty[LampSim::OUTS] = {};
+  uint32_t loadMa[LampSim::OUTS] = {};
+  int64_t onSince[LampSim::OUTS] = {};
+  int64_t t = 0;
+  int64_t acc = 0; int n = 0;
+  uint32_t seed = 1;
+  double rMohm = 20.0;
+  void set(int out, uint8_t d) {
+    if ((duty[out] == 0) != (d == 0)) onSince[out] = t;
+    duty[out] = d;
+  }
+  void run(int ms) {
+    for (int k = 0; k < ms; k++, t++) {
+      double ma = 0;
+      for (int i = 0; i < LampSim::OUTS; i++) {
+        if (!duty[i]) continue;
+        double inrush = t - onSince[i] < 20 ? 4.0 : 1.0;
+        ma += loadMa[i] * inrush * duty[i] / 255.0;
+      }
+      acc += 12700 - (int64_t)(ma * rMohm / 1000.0);
+      n++;
+      if ((t + 1) % LampSim::BLOCK_MS == 0) {
+        seed = seed * 1664525u + 1013904223u;
+        m.block(t, (int32_t)(acc / n) + (int32_t)((seed >> 16) % 5) - 2);
+        acc = 0; n = 0;
+      }
+      m.update(t, duty);
+    }
+  }
+};
+
+// ============================================================================
+// Dimming: gamma LUT level → duty, scaled by (12.0 V / battery)²
+// ============================================================================
+
+struct DimmingSim {
+  static constexpr int NOMINAL_MV = 12000, HYST_MV = 100;
+  const uint16_t lut[33] = {
+        0,    32,   148,   362,   681,  1113,  1663,  2334,  3131,  4057,  5115,
+     6309,  7640,  9111, 10724, 12482, 14386, 16439, 18642, 20996, 23504, 26168,
+    28988, 31966, 35103, 38402, 41862, 45487, 49275, 53230, 57352, 61642, 65535,
+  };
+  uint16_t factorQ12 = 4096;
+  int32_t factorMv = 0;
+  void update(float v) {                            // Mirrors dimmingUpdate()
+    int32_t mv = (int32_t)(v * 1000.0f);
+    if (factorMv && std::abs(mv - factorMv) < HYST_MV) return;
+    factorMv = mv;
+    if (mv <= NOMINAL_MV) { factorQ12 = 4096; return; }
+    uint64_t nom = (uint64_t)NOMINAL_MV * NOMINAL_MV;
+    factorQ12 = (uint16_t)((nom << 12) / ((uint64_t)mv * mv));
+  }
+  uint8_t compensate(uint32_t duty256) const {
+    uint32_t d = (duty256 * factorQ12 + (1u << 19)) >> 20;
+    if (d == 0 && duty256) d = 1;
+    return (uint8_t)std::min(d, (uint32_t)255);
+  }
+  uint8_t brightness(uint8_t level) const {
+    if (!level) return 0;
+    uint8_t i = level >> 3, f = level & 7;
+    uint32_t lin = level == 255 ? 65535 : lut[i] + (((uint32_t)(lut[i + 1] - lut[i]) * f) >> 3);
+    return compensate(lin - (lin >> 8));
+  }
+  uint8_t power(uint8_t pct) const {
+    return pct ? compensate((uint32_t)std::min(pct, (uint8_t)100) * 255 * 256 / 100) : 0;
+  }
+};
+
+// ============================================================================
+// Load shedding: tiers with time-at-voltage, hysteresis, progressive restore
+// ============================================================================
+
+struct LoadShedSim {
+  static constexpr int TIERS = 3, HYST_MV = 600, RESTORE_MS = 10000;
+  const int32_t  mvAt[TIERS + 1]   = { 0, 11800, 11000, 10000 };
+  const uint32_t holdMs[TIERS + 1] = { 0, 10000, 5000, 2000 };
+  uint8_t tierOf[11] = { 0, 0, 0, 0, 0, 3, 0, 0, 0, 1, 1 };   // SHED_TIER_DEFAULTS
+  uint8_t level = 0;
+  int64_t belowSince[TIERS + 1] = { -1, -1, -1, -1 };
+  int64_t aboveSince = -1;
+  int sheds = 0, restores = 0;
+  uint16_t mask() const {
+    uint16_t m = 0;
+    for (int i = 0; i < 11; i++) if (tierOf[i] && tierOf[i] <= level) m |= (uint16_t)(1u << i);
+    return m;
+  }
+  void setLevel(uint8_t l) { (l > level ? sheds : restores)++; level = l; aboveSince = -1; }
+  void update(int64_t nowMs, int32_t mv, bool starter) {   // Mirrors loadShedUpdate()
+    if (starter) {
+      for (auto& b : belowSince) b = -1;
+      aboveSince = -1;
+      return;
+    }
+    if (mv <= 1000) return;
+    uint8_t target = level;
+    for (uint8_t t = level + 1; t <= TIERS; t++) {
+      if (mv >= mvAt[t]) { belowSince[t] = -1; continue; }
+      if (belowSince[t] < 0) belowSince[t] = nowMs;
+      if (nowMs - belowSince[t] >= (int64_t)holdMs[t]) target = t;
+    }
+    if (target > level) {
+      setLevel(target);
+    } else if (level && mv >= mvAt[level] + HYST_MV) {
+      if (aboveSince < 0) aboveSince = nowMs;
+      if (nowMs - aboveSince >= RESTORE_MS) { belowSince[level] = -1; setLevel(level - 1); }
+    } else {
+      aboveSince = -1;
+    }
+  }
+};
+
+// ============================================================================
+// Energy accounting: duty × watts integrators, parked budget and cutoff
+// ============================================================================
+
+struct EnergySim {
+  static constexpr int OUTS = 11;
+  static constexpr uint32_t NOMINAL_MV = 12000, BASE_MA = 15, WIFI_MA = 45, BLE_MA = 30, SLEEP_MA = 2;
+  static constexpr uint32_t SETTLE_MS = 60000, FULL_MV = 12700, EMPTY_MV = 11900;
+  struct Account {
+    uint64_t outMaUs[OUTS] = {}; uint32_t outOnMs[OUTS] = {};
+    uint64_t baseMaUs = 0, wifiMaUs = 0, bleMaUs = 0;
+    uint32_t durationMs = 0;
+  };
+  uint16_t watts[OUTS] = { 21, 21, 55, 60, 21, 40, 750, 750, 60, 0, 0 };
+  uint8_t batteryAh = 8, floorPct = 60;
+  Account parked, ride;
+  bool wasOn = false, cutoff = false;
+  int64_t parkStartMs = 0;
+  uint8_t soc0 = 0xFF; float soc0Used = 0;
+  static float mah(uint64_t maUs) { return maUs / 3.6e9f; }
+  static float total(const Account& a) {
+    uint64_t s = a.baseMaUs + a.wifiMaUs + a.bleMaUs;
+    for (int i = 0; i < OUTS; i++) s += a.outMaUs[i];
+    return mah(s);
+  }
+  float remaining() const { return soc0 * batteryAh * 10.0f - (total(parked) - soc0Used); }
+  void add(Account& a, const uint8_t* duty, bool wifi, bool ble, uint32_t dtUs,
+           uint32_t sleepUs = 0) {                                                  // Mirrors add()
+    uint32_t dtMs = dtUs / 1000;
+    for (int i = 0; i < OUTS; i++) {
+      if (!duty[i]) continue;
+      a.outMaUs[i] += (uint64_t)duty[i] * watts[i] * dtUs * 1000000ULL / (255ULL * NOMINAL_MV);
+      a.outOnMs[i] += dtMs;
+    }
+    a.baseMaUs += (uint64_t)BASE_MA * (dtUs - sleepUs) + (uint64_t)SLEEP_MA * sleepUs;
+    if (wifi) a.wifiMaUs += (uint64_t)WIFI_MA * dtUs;
+    if (ble)  a.bleMaUs  += (uint64_t)BLE_MA * dtUs;
+    a.durationMs += dtMs;
+  }
+  void sample(int64_t nowMs, bool on, const uint8_t* duty, bool wifi, bool ble, int32_t mv) {
+    if (on != wasOn) {
+      wasOn = on;
+      if (on) { ride = Account(); cutoff = false; }
+      else    { parked = Account(); parkStartMs = nowMs; soc0 = 0xFF; }
+    }
+    add(on ? ride : parked, duty, wifi, ble, 100000);
+    if (on) return;
+    if (soc0 == 0xFF && nowMs - parkStartMs >= SETTLE_MS) {   // Mirrors checkBudget()
+      soc0 = (uint8_t)std::min(100, std::max(0, (int)((mv - (int)EMPTY_MV) * 100 / (int)(FULL_MV - EMPTY_MV))));
+      soc0Used = total(parked);
+    }
+    if (soc0 == 0xFF || !floorPct || cutoff) return;
+    if (remaining() < floorPct * batteryAh * 10.0f) cutoff = true;
+  }
+};
+
+// ============================================================================
+// Parked power mode: mode / radio window job, light-sleep decision, wakes
+// ============================================================================
+
+struct PowerSim {
+  enum Mode { ACTIVE, PARKED, SLEEP };
+  static constexpr int64_t CYCLE_MS = 10000, WINDOW_MS = 1500, SLEEP_MIN_MS = 20, SCAN_MS = 1000;
+  int parkSleepMin = 5;
+  Mode mode = ACTIVE;
+  int64_t parkSince = 0, windowEnd = 0, windowAt = 0, scanStart = -1;
+  bool windowOpen = false, sleepOk = false;
+  uint32_t windows = 0;
+  bool scanning(int64_t now) const { return scanStart >= 0 && now - scanStart < SCAN_MS; }
+  void enter(Mode m, int64_t now) {                       // Mirrors enterMode()
+    if (m == mode) return;
+    if (mode == SLEEP) { sleepOk = false; windowOpen = false; }
+    if (m == SLEEP) { windowOpen = false; sleepOk = true; windowAt = now + CYCLE_MS; }
+    parkSince = now;
+    mode = m;
+  }
+  void job(int64_t now, bool ign, bool hold) {            // Mirrors powerJob()
+    if (ign) { enter(ACTIVE, now); return; }
+    if (mode == ACTIVE) enter(PARKED, now);
+    if (hold || !parkSleepMin) { enter(PARKED, now); parkSince = now; return; }
+    if (mode == PARKED) {
+      if (now - parkSince >= parkSleepMin * 60000LL) enter(SLEEP, now);
+      return;
+    }
+    if (!windowOpen) {
+      if (now < windowAt) return;
+      sleepOk = false;
+      scanStart = now;                                    // bleParkWindow(true): one burst
+      windowOpen = true;
+      windowEnd = now + WINDOW_MS;
+      windows++;
+    } else if (now >= windowEnd && !scanning(now)) {
+      windowOpen = false;
+      sleepOk = true;
+      windowAt = now + CYCLE_MS - WINDOW_MS;
+    }
+  }
+  int64_t sleepUntil(int64_t now, int64_t deadline) const {   // Mirrors powerSleepUntil()
+    if (!sleepOk) return -1;
+    int64_t until = std::min(deadline, windowAt);
+    return until - now < SLEEP_MIN_MS ? -1 : until;
+  }
+  // Radios as configured per mode: AP up unless asleep; keyless bursts of
+  // 1 s every 2 s while awake (kl_scan job), one per window while asleep
+  bool wifi() const { return mode != SLEEP; }
+  bool ble(int64_t now) const { return mode == SLEEP ? scanning(now) : now % 2000 < SCAN_MS; }
+};
+
 // ============================================================================
 // TESTS
 // ============================================================================
@@ -198,6 +1147,18 @@ int main() {
     s2.pressStart(0);
     s2.holdStart(5000);
     assert(!s2.starterEngaged);  // Timed out
+
+    // Crank followed by its signature: the engage delay does not apply,
+    // only the catch declares the engine running and cuts the starter
+    StarterSim s3;
+    s3.tracking = true;
+    s3.pressStart(0);
+    s3.holdStart(1500);
+    s3.holdStart(2500);
+    assert(s3.starterEngaged && !s3.engineRunning);
+    s3.caught = true;
+    s3.holdStart(2600);
+    assert(!s3.starterEngaged && s3.engineRunning);
     std::cout << "[PASS] Starter logic (FIX #3)" << std::endl;
   }
 
@@ -248,6 +1209,873 @@ int main() {
     std::cout << "[PASS] Voltage monitoring (FIX #10)" << std::endl;
   }
 
+  // --- Vertical-counter debounce: 8 stable samples per bit ---
+  {
+    VerticalDebounceSim d;
+    for (int i = 0; i < 7; i++) { d.sample(0x0041); assert(d.state == 0); }
+    d.sample(0x0041);
+    assert(d.state == 0x0041);  // Both bits switched on the 8th sample
+
+    // A glitch resets that bit's counter, other bits keep counting
+    for (int i = 0; i < 4; i++) d.sample(0x0003);
+    d.sample(0x0001);            // bit 1 glitches back
+    for (int i = 0; i < 3; i++) d.sample(0x0003);
+    assert(d.state == 0x0001);  // bit 6 released after 8, bit 1 still counting
+    for (int i = 0; i < 4; i++) d.sample(0x0003);
+    assert(d.state == 0x0001);
+    d.sample(0x0003);
+    assert(d.state == 0x0003);
+    // Per-input profile: every configured ms is met within one 1 ms tick
+    // of the edge, press and release, at any edge phase
+    long worstUs = 0;
+    for (int ms = 1; ms <= 255; ms++) {
+      for (long edgeUs : {0L, 1L, 300L, 999L}) {
+        DebounceClockSim c;
+        c.profile(3, (uint8_t)ms);
+        long onUs = -1, offUs = -1, releaseUs = edgeUs + 2000000;
+        for (long t = 0; t < 4000000 && offUs < 0; t += 1000) {
+          bool level = t >= edgeUs + 1000000 && t < releaseUs;
+          c.sample(level ? 0x0008 : 0, t);
+          if (onUs < 0 && (c.v.state & 0x0008)) onUs = t;
+          if (onUs >= 0 && !(c.v.state & 0x0008)) offUs = t;
+        }
+        long on = onUs - (edgeUs + 1000000), off = offUs - releaseUs;
+        assert(on >= ms * 1000 && on < ms * 1000 + 1000);
+        assert(off >= ms * 1000 && off < ms * 1000 + 1000);
+        worstUs = std::max(worstUs, std::max(on, off) - ms * 1000);
+      }
+    }
+    // A bounce that lands on a sample restarts the count: accepted 50 ms
+    // after the level settles again
+    DebounceClockSim b;
+    b.profile(3, 50);
+    long acceptUs = -1;
+    for (long t = 0; t < 200000 && acceptUs < 0; t += 1000) {
+      bool level = t >= 10000 && !(t >= 30000 && t < 36000);
+      b.sample(level ? 0x0008 : 0, t);
+      if (b.v.state & 0x0008) acceptUs = t;
+    }
+    assert(acceptUs == 36000 + 50000);
+    std::cout << "  debounce 1-255 ms: worst overshoot " << worstUs << "us" << std::endl;
+    std::cout << "[PASS] Vertical-counter debounce" << std::endl;
+  }
+
+  // --- Speed sensor: no lost pulses at 2 kHz, bounce rejected ---
+  {
+    SpeedCaptureSim sp;
+    uint32_t sent = generatePulses(2000.0, 5.0, true,
+                                   [&](int64_t us) { sp.edge(us); });
+    assert(sp.pulseCount == sent);
+    assert(std::fabs(sp.hz() - 2000.0f) < 2000.0f * 0.05f);
+
+    // Old path: 1ms polling through a 50ms debounce. The same pulse train
+    // as a µs timeline (each pulse high for half a period), sampled at 1 ms:
+    // the samples alias onto the edges and toggle, but never hold long
+    // enough to count
+    std::vector<int64_t> rise;
+    generatePulses(2000.0, 5.0, false, [&](int64_t us) { rise.push_back(us); });
+    uint32_t polled = 0, toggles = 0;
+    bool stable = false, last = false;
+    unsigned long lastChange = 0;
+    size_t next = 0;
+    for (unsigned long ms = 0; ms < 5000; ms++) {
+      int64_t tUs = (int64_t)ms * 1000;
+      while (next < rise.size() && rise[next] <= tUs) next++;
+      bool level = next > 0 && tUs - rise[next - 1] < 250;
+      if (level != last) { last = level; lastChange = ms; toggles++; }
+      if (ms - lastChange >= 50 && stable != level) {
+        if (level) polled++;
+        stable = level;
+      }
+    }
+    std::cout << "  2 kHz for 5s: sent=" << sent << " isr=" << sp.pulseCount
+              << " polled=" << polled << " (" << toggles << " sampled toggles)" << std::endl;
+    assert(toggles > 100);
+    assert(polled < sent / 100);
+    std::cout << "[PASS] Speed sensor edge capture" << std::endl;
+  }
+
+  // --- Brake fast path: edge-to-output latency and release debounce ---
+  {
+    // Simulated µs timeline: brake closes at t=10'300µs, loop ticks every
+    // 1ms, GPIO ISR entry modelled as 3µs.
+    const long edgeUs = 10300, isrUs = 3, tickUs = 1000;
+
+    // Old path: 1ms polling + 50ms time-based debounce
+    long oldOutUs = -1, lastChange = -1;
+    bool lastReading = false, stable = false;
+    for (long t = 0; t < 200000 && oldOutUs < 0; t += tickUs) {
+      bool reading = t >= edgeUs;
+      if (reading != lastReading) { lastReading = reading; lastChange = t; }
+      if (lastChange >= 0 && t - lastChange >= 50000 && stable != reading) stable = reading;
+      if (stable) oldOutUs = t;
+    }
+
+    // New path: ISR drives the output, loop reconciles on the next sample
+    BrakeFastPathSim fp;
+    long newOutUs = -1;
+    fp.isrEdge(true);
+    if (fp.output) newOutUs = edgeUs + isrUs;
+    for (long t = edgeUs + tickUs; t < edgeUs + 20 * tickUs; t += tickUs) {
+      fp.sample(BrakeFastPathSim::BRAKE);
+      assert(fp.output);                            // Never drops after the edge
+    }
+
+    std::cout << "  Brake edge->output latency: old=" << (oldOutUs - edgeUs)
+              << "us new=" << (newOutUs - edgeUs) << "us" << std::endl;
+    assert(newOutUs - edgeUs <= 10);
+    assert(oldOutUs - edgeUs >= 50000);
+
+    // Release stays debounced: a 1-sample bounce does not drop the light
+    fp.sample(0);
+    assert(fp.output);
+    fp.sample(BrakeFastPathSim::BRAKE);
+    for (int i = 0; i < 7; i++) { fp.sample(0); assert(fp.output); }
+    fp.sample(0);
+    assert(!fp.output);
+    std::cout << "[PASS] Brake safety fast path" << std::endl;
+  }
+
+  // --- Output word: only changed pins, starters in one store, PWM excluded ---
+  {
+    const uint32_t START1 = 1u << (44 - 32), START2 = 1u << (45 - 32);
+    const uint32_t IGN = 1u << (42 - 32), AUX2 = 1u << (40 - 32);
+    OutputBankSim b;
+    b.target = IGN | START1 | START2;
+    b.commit();
+    assert(b.lastSet == (IGN | START1 | START2) && b.writes == 1);
+
+    for (int i = 0; i < 1000; i++) b.commit();   // Steady state: no writes
+    assert(b.writes == 1);
+
+    b.target &= ~(START1 | START2);
+    b.commit();
+    assert(b.lastClr == (START1 | START2) && b.writes == 2);
+
+    b.pwm = AUX2;                                 // LEDC-owned pin is never written
+    b.target |= AUX2;
+    b.commit();
+    assert(b.lastSet == 0 && b.writes == 2);
+
+    // Brake ISR between inputsSample() and the commit: the pass arbitrated
+    // on the pre-edge inputs and wants the lamp off, the hold keeps it on
+    const uint32_t BRAKE = 1u << 13;
+    OutputBankSim f;
+    f.fastWrite(BRAKE, true);
+    f.target &= ~BRAKE;                           // outputOff() from this pass
+    f.commit();
+    assert((f.applied & BRAKE) && f.lastClr == 0);
+    f.fastOn &= ~BRAKE;                           // Next inputsSample() took the latch
+    f.target |= BRAKE;                            // Debounced input now asserts
+    f.commit();
+    assert((f.applied & BRAKE) && f.writes == 0);
+    f.target &= ~BRAKE;                           // Release owned by arbitration again
+    f.commit();
+    assert(f.lastClr == BRAKE);
+
+    // Channel evicted from a fully lit pin that this pass has already
+    // arbitrated: the pad goes back to the word still on
+    const uint32_t LIGHT = 1u << 11;
+    OutputBankSim e;
+    e.attach(LIGHT);                              // On LEDC at DUTY_ON
+    e.release(LIGHT, true);                       // Eviction, no further request
+    e.commit();
+    assert(e.lastSet == LIGHT && e.lastClr == 0);
+    e.attach(LIGHT);
+    e.release(LIGHT, false);                      // Dark channel stays dark
+    e.commit();
+    assert(e.lastClr == LIGHT);
+    std::cout << "[PASS] Output word commit" << std::endl;
+  }
+
+  // --- Arbiter: layer priority, release falls through, unclaimed is off ---
+  {
+    const int TURNL = 0, LIGHT = 2, HORN = 5, IGN = 8;
+    ArbiterSim a;
+    a.request(ArbiterSim::PARKING, LIGHT, 64);      // Parking dim light
+    a.request(ArbiterSim::USER, IGN, 255);
+    a.request(ArbiterSim::SAFETY, IGN, 0);          // Kill switch overrides user
+    a.request(ArbiterSim::ALARM, HORN, 255);
+    a.request(ArbiterSim::USER, HORN, 0);
+    a.arbitrate();
+    assert(a.outDuty[LIGHT] == 64 && a.outLayer[LIGHT] == ArbiterSim::PARKING);
+    assert(a.outDuty[IGN] == 0 && a.outLayer[IGN] == ArbiterSim::SAFETY);
+    assert(a.outDuty[HORN] == 255 && a.outLayer[HORN] == ArbiterSim::ALARM);
+    assert(a.outDuty[TURNL] == 0 && a.outLayer[TURNL] == -1);
+
+    a.request(ArbiterSim::HAZARD, TURNL, 0);        // Hazard off-phase beats parking blinker
+    a.request(ArbiterSim::PARKING, TURNL, 255);
+    a.arbitrate();
+    assert(a.outDuty[TURNL] == 0 && a.outLayer[TURNL] == ArbiterSim::HAZARD);
+
+    a.request(ArbiterSim::PARKING, TURNL, 255);     // Hazard released → parking shows
+    a.arbitrate();
+    assert(a.outDuty[TURNL] == 255 && a.outLayer[TURNL] == ArbiterSim::PARKING);
+    std::cout << "[PASS] Output arbiter" << std::endl;
+  }
+
+  // --- Light patterns: built-ins reproduce the old state machines ---
+  {
+    const PatternSeg B8X[] = { {200, 255, 0}, {200, 0, 4}, {0, 255, 0} };
+    const PatternSeg B2X[] = { {200, 255, 0}, {200, 0, 2}, {0, 255, 0} };
+    const PatternSeg B3S[] = { {3000, 255, 1}, {200, 0, 0}, {200, 255, PATTERN_FOREVER} };
+    const PatternSeg MOWAVE[] = { {120, 85, 0}, {120, 170, 0}, {120, 255, 0}, {307, 0, 0} };
+    LightPattern p8 = { B8X, 3 }, p2 = { B2X, 3 }, p3 = { B3S, 3 }, pw = { MOWAVE, 4 };
+    uint32_t next;
+    for (uint32_t t = 0; t < 10000; t += 7) {
+      assert((patternEval(p8, t, &next) != 0) == oldBrakeFlash(t, 1600));
+      assert((patternEval(p2, t, &next) != 0) == oldBrakeFlash(t, 800));
+      assert((patternEval(p3, t, &next) != 0) == oldBrakeFlash(t, UINT32_MAX, 3000));
+      uint32_t phase = t % 667;
+      uint8_t wave = phase < 360 ? (uint8_t)(((phase / 120 + 1) * 255) / 3) : 0;
+      assert(patternEval(pw, t, &next) == wave);
+    }
+    patternEval(p8, 1700, &next);
+    assert(next == PATTERN_NEVER);                  // Holding: timer goes idle
+    patternEval(p3, 3250, &next);
+    assert(next == 150);                            // Next boundary, not next tick
+
+    // Per-evaluation cost, longest built-in (37-segment fade) and a custom one
+    PatternSeg fade[37];
+    for (int k = 0; k < 37; k++) fade[k] = { 9, (uint8_t)(80 + k), 0 };
+    LightPattern pf = { fade, 37 };
+    const int N = 2000000;
+    volatile uint32_t sink = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int n = 0; n < N; n++) sink += patternEval(pf, (uint32_t)n * 3, &next);
+    auto t1 = std::chrono::steady_clock::now();
+    for (int n = 0; n < N; n++) sink += patternEval(p3, (uint32_t)n * 3, &next);
+    auto t2 = std::chrono::steady_clock::now();
+    std::cout << "  Pattern eval (host): fade37="
+              << std::chrono::duration<double, std::nano>(t1 - t0).count() / N << "ns  3s-flash="
+              << std::chrono::duration<double, std::nano>(t2 - t1).count() / N << "ns" << std::endl;
+    std::cout << "[PASS] Light pattern player" << std::endl;
+  }
+
+  // --- Custom brake uploads cannot leave the brake light dark ---
+  {
+    const PatternSeg B8X[] = { {200, 255, 0}, {200, 0, 4}, {0, 255, 0} };
+    const PatternSeg B3S[] = { {3000, 255, 1}, {200, 0, 0}, {200, 255, PATTERN_FOREVER} };
+    const PatternSeg FLASH[] = { {200, 255, 0}, {200, 0, PATTERN_FOREVER} };
+    assert(brakePatternSafe(B8X, 3) && brakePatternSafe(B3S, 3) && brakePatternSafe(FLASH, 2));
+    assert(brakePatternSafe(nullptr, 0));                       // Clear → built-in
+
+    const PatternSeg allOff[] = { {200, 0, 0}, {200, 0, 0} };
+    const PatternSeg darkHold[] = { {0, 0, 0} };
+    const PatternSeg litThenDarkHold[] = { {200, 255, 0}, {0, 0, 0} };
+    const PatternSeg darkStart[] = { {100, 0, 0}, {100, 255, 0} };
+    const PatternSeg longDark[] = { {100, 255, 0}, {600, 0, 0} };
+    const PatternSeg dimOnly[] = { {100, 40, 0}, {100, 79, 0} };
+    const PatternSeg darkRepeats[] = { {100, 255, 1}, {300, 0, 2}, {100, 255, 0} };
+    const PatternSeg darkForever[] = { {100, 255, 1}, {300, 0, PATTERN_FOREVER} };
+    const PatternSeg wrapDark[] = { {100, 255, 1}, {300, 0, 0}, {100, 255, 0}, {300, 0, 3} };
+    const PatternSeg wrapOk[] = { {100, 255, 1}, {200, 0, 0}, {100, 255, 0}, {200, 0, 3} };
+    assert(!brakePatternSafe(allOff, 2));
+    assert(!brakePatternSafe(darkHold, 1));
+    assert(!brakePatternSafe(litThenDarkHold, 2));
+    assert(!brakePatternSafe(darkStart, 2));
+    assert(!brakePatternSafe(longDark, 2));
+    assert(!brakePatternSafe(dimOnly, 2));
+    assert(!brakePatternSafe(darkRepeats, 3));                   // 2 × 300 ms dark
+    assert(!brakePatternSafe(darkForever, 2));
+    assert(!brakePatternSafe(wrapDark, 4));                      // 300 + 300 across a repeat
+    assert(brakePatternSafe(wrapOk, 4));
+
+    // Every accepted pattern really lights within the dark limit
+    const PatternSeg* ok[] = { B8X, B3S, FLASH, wrapOk };
+    const uint8_t okN[] = { 3, 3, 2, 4 };
+    for (int c = 0; c < 4; c++) {
+      LightPattern lp = { ok[c], okN[c] };
+      uint32_t next, darkSince = 0;
+      assert(patternEval(lp, 0, &next) >= 80);
+      for (uint32_t t = 0; t < 20000; t++) {
+        if (patternEval(lp, t, &next) >= 80) darkSince = t + 1;
+        assert(t + 1 - darkSince <= 500);
+      }
+    }
+    std::cout << "[PASS] Custom brake pattern validation" << std::endl;
+  }
+
+  // --- Channel pool: sticky ownership, timer-pair frequency rule ---
+  {
+    ChannelPoolSim pool;
+    const int LIGHT = 11, BRAKE = 13, AUX1 = 43, AUX2 = 40;
+    int cBrake = pool.use(BRAKE, 5000);
+    for (int i = 0; i < 100; i++) {                 // Tail dim ↔ brake full ↔ off
+      assert(pool.use(BRAKE, 5000) == cBrake);
+    }
+    assert(pool.setups == 1);
+
+    pool.use(LIGHT, 5000);                          // Fills pair 0/1
+    int cAux1 = pool.use(AUX1, 200);                // Needs its own timer pair
+    assert(cAux1 == 2);
+    int cAux2 = pool.use(AUX2, 5000);               // Must skip channel 3 (200 Hz sibling)
+    assert(cAux2 == 4);
+    assert(pool.use(12, 200) == 3);                 // High beam at 200 Hz pairs with AUX1
+    std::cout << "[PASS] PWM channel pool" << std::endl;
+  }
+
+  // --- Control tick: jitter, WCET and overrun resync ---
+  {
+    TickStatsSim st;
+    int64_t t = 0;
+    for (int i = 0; i < 10; i++, t += 1000) st.tick(t + (i % 3) * 15, 120, t + 1000);
+    assert(st.jitterMaxUs == 30 && st.overruns == 0 && st.execMaxUs == 120);
+    st.tick(t, 2600, t + 3000);                     // Long tick: 2 periods lost
+    assert(st.overruns == 1 && st.scheduledUs == t + 3000);
+    st.tick(t + 3000, 100, t + 4000);               // Resynced, no catch-up burst
+    assert(st.jitterMaxUs == 30 && st.overruns == 1 && st.execMaxUs == 2600);
+    std::cout << "[PASS] Control tick statistics" << std::endl;
+  }
+
+  // --- Timer wheel: every level, cascades, 32-bit millis wrap ---
+  {
+    const uint32_t starts[] = { 0, 4090, 0xFFFFFFFFu - 5000 };
+    for (uint32_t start : starts) {
+      WheelSim w(start);
+      const uint32_t periods[] = { 1, 63, 64, 150, 1000, 4096, 5000 };
+      for (int i = 0; i < 7; i++) w.arm(i, periods[i], periods[i]);
+      w.arm(7, 300000, 0);                          // Beyond the 262 s horizon
+      for (uint32_t t = start + 1; t != start + 310001; t++) w.run(t);
+      for (int i = 0; i < 7; i++) {
+        assert(w.jobs[i].runs == 310000 / periods[i]);
+        assert(w.jobs[i].late == 0);
+      }
+      assert(w.jobs[7].runs == 1);
+    }
+
+    WheelSim w(0);                                  // Parked: 1 s sleeps
+    w.arm(0, 200, 200);
+    for (uint32_t t = 1000; t <= 10000; t += 1000) w.run(t);
+    assert(w.jobs[0].runs == 10 && w.jobs[0].expiry == 10200);   // Resynced, no burst
+    std::cout << "[PASS] Scheduler timer wheel" << std::endl;
+  }
+
+  // --- Budget: a stalled broadcast sheds the rest, essentials still run ---
+  {
+    BudgetSim b;
+    BudgetSim::J jobs[] = {
+      { true,  8000, 150, 150 },                    // ws_state: textAll() stalls
+      { false,  200, 150, 150 },                    // essential (keyless scan)
+      { true,   300, 150, 150 },                    // ble_state
+      { true,  1000, 150, 150 },                    // nvs flush
+    };
+    for (uint32_t t = 150; t <= 1500; t += 150) b.iteration(jobs, 4, t);
+    assert(jobs[0].runs == 10 && jobs[1].runs == 10);
+    assert(jobs[2].shed == 10 && jobs[3].shed == 10 && jobs[2].runs == 0);
+    assert(jobs[2].expiry == 1650);                 // Phase kept, no burst
+    assert(b.overIterations == 10);
+    jobs[0].costUs = 500;                           // Dashboard idle again
+    b.iteration(jobs, 4, 1650);
+    assert(jobs[2].runs == 1 && jobs[3].runs == 1);
+    std::cout << "[PASS] Tick budget shedding" << std::endl;
+  }
+
+  // --- Battery ADC: fixed-point path matches the float formula ---
+  {
+    BatteryFilterSim f;
+    for (uint32_t raw = 0; raw < 4096; raw += 7) {
+      double ref = raw * 3100.0 / 4095.0;
+      assert(std::fabs(f.caliToMv(raw << 8) - ref) < 2.0);         // Knot rounding
+    }
+    // 256-sample frames of a 13.8 V rail with ±50 mV ripple at the battery
+    double pinMv = 13800.0 / 5.7, rippleMv = 50.0 / 5.7;
+    for (int n = 0; n < 64; n++) {
+      uint32_t sum = 0;
+      uint16_t mn = 0xFFFF, mx = 0;
+      for (int i = 0; i < 256; i++) {
+        double mv = pinMv + rippleMv * std::sin(2 * M_PI * 3000.0 * (n * 256 + i) / 20000.0);
+        uint16_t raw = (uint16_t)std::lround(mv * 4095.0 / 3100.0);
+        sum += raw;
+        if (raw < mn) mn = raw;
+        if (raw > mx) mx = raw;
+      }
+      f.block(sum, 256, mn, mx);
+    }
+    assert(std::abs(f.filtQ8 / 256 - 13800) <= 10);   // Within ~1 LSB × divider
+    assert(std::abs(f.rippleQ8 / 256 - 100) <= 15);   // Peak-to-peak 100 mV
+    std::cout << "[PASS] Battery ADC filter" << std::endl;
+  }
+
+  // --- 64-bit time base: no sentinel collision at 0, no 49-day wrap ---
+  {
+    const TimeUs starts[] = { 0, usFromMs(0xFFFFFFFFLL) - usFromMs(10000) };
+    for (TimeUs start : starts) {
+      hostClockUs = start;
+      AlarmTimingSim a;
+      a.update(false, false);
+      assert(a.armStart == start && !a.armed);     // Boot at t = 0 is a valid start
+      hostClockUs += usFromMs(29999);
+      a.update(false, false);
+      assert(!a.armed);
+      hostClockUs += usFromMs(1);                 // Crosses 2^32 ms for the 2nd start
+      a.update(false, false);
+      assert(a.armed && !timeIsSet(a.armStart));
+      a.update(false, true);
+      assert(a.triggered);
+      hostClockUs += usFromMs(30000) - 1;          // Sub-millisecond resolution
+      a.update(false, false);
+      assert(a.triggered);
+      hostClockUs += 1;
+      a.update(false, false);
+      assert(!a.triggered && a.armed);
+    }
+    std::cout << "[PASS] 64-bit time base" << std::endl;
+  }
+
+  // --- Charging ripple: FFT kernel benchmark + rectifier fault classifier ---
+  {
+    static RippleSim r;
+    static float mv[RippleSim::N];
+
+    // Kernel vs direct DFT on one bin
+    rippleWaveform(mv, RippleSim::N, 300, 22.0, 1);
+    for (int i = 0; i < RippleSim::N; i++) { r.buf[2 * i] = mv[i]; r.buf[2 * i + 1] = 0; }
+    r.fft(r.buf);
+    for (int k : { 15, 92 }) {
+      double re = 0, im = 0;
+      for (int i = 0; i < RippleSim::N; i++) {
+        re += mv[i] * std::cos(2 * M_PI * k * i / RippleSim::N);
+        im -= mv[i] * std::sin(2 * M_PI * k * i / RippleSim::N);
+      }
+      assert(std::fabs(r.buf[2 * k] - re) < 1e-4 * RippleSim::N * 14000);
+      assert(std::fabs(r.buf[2 * k + 1] - im) < 1e-4 * RippleSim::N * 14000);
+    }
+
+    // Healthy / open diode / open phase over idle..redline and stator voltage
+    int cases = 0;
+    for (double fe : { 100.0, 300.0, 800.0 }) {
+      for (double vpk : { 19.5, 24.0, 30.0 }) {
+        rippleWaveform(mv, RippleSim::N, fe, vpk, 0, 13.6, (uint32_t)fe);
+        assert(r.analyse(mv) == 0);
+        assert(r.hz == 0 || std::fabs(r.hz - 6 * fe) <= RippleSim::BIN_HZ);   // 0: smooth
+        rippleWaveform(mv, RippleSim::N, fe, vpk, 1, 13.6, (uint32_t)fe);
+        assert(r.analyse(mv) == RippleSim::DIODE);
+        assert(std::fabs(r.hz - fe) <= RippleSim::BIN_HZ);
+        rippleWaveform(mv, RippleSim::N, fe, vpk, 2, 13.6, (uint32_t)fe);
+        assert(r.analyse(mv) == RippleSim::OPEN);
+        cases += 3;
+      }
+    }
+    rippleWaveform(mv, RippleSim::N, 300, 24.0, 0, 15.0);       // Regulator not limiting
+    assert(r.analyse(mv) == RippleSim::OVER);
+    rippleWaveform(mv, RippleSim::N, 300, 12.0, 1);             // Not charging: not judged
+    assert(r.analyse(mv) == 0 && r.hz == 0);
+
+    const int RUNS = 2000;
+    rippleWaveform(mv, RippleSim::N, 300, 24.0, 1);
+    auto t0 = std::chrono::steady_clock::now();
+    volatile uint8_t sink = 0;
+    for (int i = 0; i < RUNS; i++) sink = sink + r.analyse(mv);
+    auto t1 = std::chrono::steady_clock::now();
+    std::cout << "  " << cases << " synthetic captures classified, 1024-point analyse: "
+              << std::chrono::duration<double, std::micro>(t1 - t0).count() / RUNS
+              << "us (host)" << std::endl;
+    std::cout << "[PASS] Charging ripple analysis" << std::endl;
+  }
+
+  // --- Engine RPM from the ripple line (pole pairs, fault-aware, tracked) ---
+  {
+    static RippleSim r;
+    static float mv[RippleSim::N];
+    double worst = 0;
+    for (int poles : { 4, 6, 8 }) {
+      r.polePairs = poles;
+      for (double rpm : { 1200.0, 3500.0, 9000.0 }) {
+        double fe = rpm / 60.0 * poles;
+        if (6 * fe >= 10000 - RippleSim::BIN_HZ) continue;        // Above Nyquist
+        for (int fault : { 0, 1, 2 }) {
+          rippleWaveform(mv, RippleSim::N, fe, 22.0, fault, 13.6, (uint32_t)rpm);
+          r.analyse(mv);
+          worst = std::max(worst, std::fabs(r.rpm - rpm) / rpm);
+          // ±half a bin of the line the estimate is read from
+          double lineHz = fault == 0 ? 6 * fe : fault == 2 ? 2 * fe : fe;
+          assert(std::fabs(r.rpm - rpm) <= 0.5 * RippleSim::BIN_HZ / lineHz * rpm + 1);
+        }
+      }
+    }
+
+    // Tracker: one capture never publishes, a stray line is held off, noise → 0
+    r.polePairs = 6;
+    r.rpmPrev = 0; r.tracked = 0;
+    rippleWaveform(mv, RippleSim::N, 3000 / 60.0 * 6, 22.0, 0);
+    r.analyse(mv); r.track();
+    assert(r.tracked == 0);
+    r.analyse(mv); r.track();
+    assert(std::abs(r.tracked - 3000) < 60);
+    rippleWaveform(mv, RippleSim::N, 6000 / 60.0 * 6, 22.0, 0);
+    r.analyse(mv); r.track();
+    assert(std::abs(r.tracked - 3000) < 60);                    // Held for one capture
+    r.analyse(mv); r.track();
+    assert(std::abs(r.tracked - 6000) < 60);
+    assert(RippleSim::runningAt(r.published(true)));
+    assert(r.published(false) == 0xFFFF);                      // No captures: unknown, not 0
+    assert(!RippleSim::runningAt(r.published(false)));
+    rippleWaveform(mv, RippleSim::N, 300, 12.0, 0);             // Not charging: ADC noise only
+    r.analyse(mv); r.track();
+    assert(r.tracked == 0);
+    assert(!RippleSim::runningAt(r.published(true)));
+    std::cout << "  worst RPM error " << worst * 100 << "%" << std::endl;
+    std::cout << "[PASS] Engine RPM from ripple" << std::endl;
+  }
+
+  // --- Crank monitor: cut on recovery, never on compression ripple ---
+  {
+    const long BLOCK = 13;                                          // ~12.8 ms
+    struct Case { long catchAt; int32_t rest, crank; bool dip; };
+    const Case cases[] = {
+      {  700, 12700, 10400, true  },                               // Healthy battery
+      { 1800, 12300,  9300, true  },                               // Weak battery, slow catch
+      {   -1, 12600, 10200, true  },                               // Does not start
+      {  700, 12700, 12500, false },                               // No sag (open starter circuit)
+    };
+    for (const Case& c : cases) {
+      CrankSim m;
+      for (long t = -500; t < 0; t += BLOCK) m.block(false, t, c.rest);
+      long cutAt = -1;
+      for (long t = 0; t < 5000 && cutAt < 0; t += BLOCK) {
+        m.block(true, t, c.dip ? crankProfileMv(t, c.catchAt, c.rest, c.crank) : c.crank);
+        if (m.caught) cutAt = t;
+      }
+      assert(m.signature == c.dip);
+      if (c.catchAt < 0 || !c.dip) {
+        assert(cutAt < 0);
+      } else {
+        std::cout << "  catch at " << c.catchAt << " ms: detected " << m.catchMs
+                  << " ms, starter cut " << cutAt << " ms" << std::endl;
+        assert(m.catchMs >= c.catchAt && m.catchMs <= c.catchAt + 60);
+        assert(cutAt - c.catchAt <= 100);
+        assert(std::abs(m.plateau - c.crank) < 150);
+      }
+    }
+    std::cout << "[PASS] Crank monitor starter cutoff" << std::endl;
+  }
+
+  // --- Battery health: resistance from the sag, baseline, ageing, reboot ---
+  {
+    BatteryHealthSim h;
+    // 12.7 V rest, 80 mΩ starter: dip = rest × Rs / (Rs + Rint)
+    auto dipFor = [](double rintMohm) { return (int32_t)(12700 * 80.0 / (80.0 + rintMohm)); };
+    uint32_t seed = 7;
+    auto jitter = [&]() { seed = seed * 1664525u + 1013904223u; return (int32_t)((seed >> 16) % 121) - 60; };
+
+    for (int i = 0; i < 4; i++) h.crank(12700, dipFor(15.0) + jitter());
+    assert(h.soh == 0xFF && h.r0 == 0);             // Still learning
+    h.crank(12700, dipFor(15.0) + jitter());
+    assert(std::abs(h.r0 - 1500) < 100);            // Baseline ≈ 15 mΩ
+    assert(h.soh >= 90);
+
+    h.crank(12700, 6000);                           // One bad crank (cold, flat) …
+    assert(h.soh >= 90);                            // … does not move the median
+
+    double rint = 15.0;                             // Ageing: +0.5 mΩ per start
+    int warnedAt = -1;
+    for (int n = 0; n < 40; n++) {
+      rint += 0.5;
+      h.crank(12700, dipFor(rint) + jitter());
+      if (warnedAt < 0 && h.soh < 30) warnedAt = n;
+    }
+    assert(warnedAt > 0 && rint > 25.0);           // Warned at ~1.7× new, not at 2×
+    assert(h.soh < 30);
+
+    uint8_t sohBefore = h.soh;
+    uint32_t crankBefore = h.crankNo;
+    h.load();                                       // Reboot: history from NVS
+    h.publish();
+    assert(h.crankNo == crankBefore && h.soh == sohBefore);
+
+    for (uint32_t w : h.nvsWrites) assert(w <= (crankBefore + 15) / 16);   // Even wear
+
+    h.baseStart = h.crankNo; h.r0 = 0; h.publish(); // New battery
+    assert(h.soh == 0xFF);
+    for (int i = 0; i < 5; i++) h.crank(12700, dipFor(12.0) + jitter());
+    assert(h.soh >= 90 && std::abs(h.r0 - 1200) < 100);
+    std::cout << "  warned after " << warnedAt + 1 << " aged starts (Rint "
+              << h.rNow / 100.0 << " mOhm new battery)" << std::endl;
+    std::cout << "[PASS] Battery health from cranking" << std::endl;
+  }
+
+  // --- Lamp monitor: baselines in calibration, open bulb, overlap, PWM ---
+  {
+    LampBench b;
+    b.m.rint = 20.0f;
+    // turnL/R, brake 21 W, low 55 W, high 60 W, aux1 LED strip (too small)
+    uint32_t loads[LampSim::OUTS] = {1750, 1750, 4600, 5000, 1750, 0, 0, 0, 0, 200, 0};
+    memcpy(b.loadMa, loads, sizeof(loads));
+    const int calOut[LampSim::LAMPS] = {0, 1, 2, 3, 4, 9};
+    b.run(100);
+    b.m.learn(true);                                // Calibration: each lamp alone, 500 ms on / off
+    for (int out : calOut) { b.set(out, 255); b.run(500); b.set(out, 0); b.run(500); }
+    b.m.learn(false);
+    for (int i = 0; i < LampSim::LAMPS; i++) {
+      uint32_t want = loads[calOut[i]];
+      std::cout << "  lamp " << i << " baseline " << b.m.baseMa[i] << " mA (load " << want << ")" << std::endl;
+      assert(std::abs((int)b.m.baseMa[i] - (int)want) < (int)(want / 10 + 150));
+    }
+    assert(b.m.baseMa[5] < LampSim::MIN_MA);        // LED strip: not judged
+
+    auto flash = [&](int out, int times) {          // Turn signal, 333 ms on / off
+      for (int k = 0; k < times; k++) { b.set(out, 255); b.run(333); b.set(out, 0); b.run(334); }
+    };
+    flash(0, 5);
+    assert(b.m.faults == 0);
+    b.loadMa[0] = 0;                                // Left bulb blows
+    flash(0, 1);
+    assert(b.m.faults == 0);                        // Not on the first verdict
+    flash(0, 1);
+    assert(b.m.faults == 0x01);                     // On/off edges: 2 per flash
+    b.loadMa[0] = 1750;                             // Replaced
+    flash(0, 2);
+    assert(b.m.faults == 0);
+
+    uint32_t before = b.m.measured;                 // Hazard: both sides switch together
+    for (int k = 0; k < 3; k++) {
+      b.set(0, 255); b.set(1, 255); b.run(333);
+      b.set(0, 0);   b.set(1, 0);   b.run(334);
+    }
+    assert(b.m.measured == before);
+
+    b.loadMa[1] = 0;                                // Horn mid-window drops the measurement
+    uint32_t dropped = b.m.dropped;
+    b.set(1, 255); b.run(20); b.set(5, 255); b.run(300); b.set(5, 0); b.run(100);
+    assert(b.m.dropped > dropped && b.m.openStreak[1] == 0);
+    b.set(1, 0); b.run(300);
+    b.loadMa[1] = 1750;
+
+    b.m.engineRunning = true;                       // Regulator absorbs the step: not judged
+    b.loadMa[4] = 0;
+    before = b.m.measured;
+    for (int k = 0; k < 5; k++) { b.set(4, 255); b.run(200); b.set(4, 0); b.run(200); }
+    assert(b.m.measured == before && b.m.faults == 0);
+    b.m.engineRunning = false;
+    b.loadMa[4] = 1750;
+
+    b.set(2, 128); b.run(300);                      // PWM low beam scales to full duty
+    assert(std::abs((int)b.m.lastMa[2] - 4600) < 600);
+    b.set(2, 0); b.run(300);
+    std::cout << "  " << b.m.measured << " steps measured, " << b.m.dropped << " dropped" << std::endl;
+    std::cout << "[PASS] Lamp failure from voltage steps" << std::endl;
+  }
+
+  // --- Dimming: legacy duties at 12 V, constant power while charging ---
+  {
+    DimmingSim d;
+    d.update(12.0f);
+    assert(d.brightness(66) == 13 && d.brightness(148) == 77 && d.brightness(136) == 64);
+    assert(std::abs(d.brightness(186) - 128) <= 1 && d.brightness(255) == 255);
+    for (int l = 1; l < 255; l++) assert(d.brightness(l) <= d.brightness(l + 1));   // Monotonic
+    d.update(11.2f);
+    assert(d.factorQ12 == 4096 && d.power(100) == 255);   // Never boosted on a weak battery
+
+    // Delivered power ∝ duty × V² stays at the 12 V value
+    for (float v : {12.6f, 13.2f, 13.8f, 14.4f, 14.8f}) {
+      d.update(v);
+      for (uint8_t pct : {20, 50, 80}) {
+        double p12 = pct / 100.0 * 255 * 144.0;
+        double pv  = d.power(pct) * (double)v * v;
+        assert(std::abs(pv - p12) / p12 < 0.03);
+      }
+      double b12 = 77.0 * 144.0, bv = d.brightness(148) * (double)v * v;
+      assert(std::abs(bv - b12) / b12 < 0.05);
+    }
+    d.update(14.4f);
+    uint8_t tail = d.brightness(148);
+    d.update(14.45f);                                // Ripple-sized move: duty holds
+    assert(d.brightness(148) == tail);
+    assert(d.brightness(1) == 1);                    // Dim, never dark
+    std::cout << "  tail duty 77 @12.0V → " << (int)tail << " @14.4V (power held, duty −"
+              << 100 - d.factorQ12 * 100 / 4096 << "%)" << std::endl;
+    std::cout << "[PASS] Voltage-compensated dimming" << std::endl;
+  }
+
+  // --- Load shedding: holds, hysteresis, progressive restore, logged once ---
+  {
+    LoadShedSim ls;
+    int64_t t = 0;
+    auto run = [&](int ms, int32_t mv, bool starter = false) {
+      for (int k = 0; k < ms; k++, t++) ls.update(t, mv, starter);
+    };
+    const uint16_t AUX = (1u << 9) | (1u << 10), HORN = 1u << 5;
+
+    run(1000, 12500);
+    run(5000, 11600);                               // Short sag: held, not shed
+    run(1000, 12300);
+    assert(ls.level == 0 && ls.sheds == 0);
+    run(3000, 9500, true);                          // Cranking dip ignored
+    assert(ls.level == 0);
+    run(9000, 11600);                               // Sag before and after a crank:
+    run(2000, 9500, true);                          // the crank resets the hold …
+    run(9000, 11600);
+    assert(ls.level == 0);
+    run(1001, 11600);                               // … which then runs its full 10 s
+    assert(ls.level == 1 && ls.sheds == 1);
+    run(10500, 13800);
+    assert(ls.level == 0 && ls.restores == 1);
+    ls.sheds = ls.restores = 0;
+
+    run(10500, 11600);                              // Parked with grips: tier 1 after 10 s
+    assert(ls.level == 1 && ls.mask() == AUX && ls.sheds == 1);
+    run(60000, 12200);                              // Load gone, rest 12.2 V: inside hysteresis
+    assert(ls.level == 1 && ls.restores == 0);
+
+    run(2500, 9800);                                // Deep sag: tier 3 takes 1 and 2 with it
+    assert(ls.level == 3 && ls.mask() == (AUX | HORN) && ls.sheds == 2);
+
+    run(9000, 13800);                               // Engine charging: not yet
+    assert(ls.level == 3);
+    run(1500, 13800);                               // Horn back first …
+    assert(ls.level == 2 && ls.mask() == AUX);
+    run(5000, 13800);
+    assert(ls.level == 2);                          // … each tier gets its own window
+    run(5500, 13800);
+    assert(ls.level == 1);
+    run(10500, 13800);
+    assert(ls.level == 0 && ls.mask() == 0);
+    assert(ls.sheds == 2 && ls.restores == 3);      // One log line per transition
+    std::cout << "[PASS] Tiered load shedding" << std::endl;
+  }
+
+  // --- Energy accounting: ride vs parked, radios, parking light cutoff ---
+  {
+    EnergySim e;
+    uint8_t duty[EnergySim::OUTS] = {};
+    int64_t t = 0;
+    auto run = [&](int64_t ms, bool on, bool wifi, int scanEveryMs, int32_t mv) {
+      for (int64_t k = 0; k < ms; k += 100, t += 100) {
+        if (on) duty[0] = (t / 333) % 2 ? 0 : 255;   // Left flasher
+        bool ble = scanEveryMs && t % scanEveryMs < 1000;
+        e.sample(t, on, duty, wifi, ble, mv);
+      }
+    };
+
+    duty[2] = 255; duty[8] = 255;                   // Ride: low beam + ignition, 30 min
+    run(1800000, true, true, 0, 13800);
+    double lowMah = 55.0 / 12.0 * 1000 * 0.5;       // 55 W for half an hour
+    assert(std::abs(EnergySim::mah(e.ride.outMaUs[2]) - lowMah) < 5);
+    assert(std::abs((int)e.ride.outOnMs[0] - 900000) < 20000);   // Flasher ~50 %
+    assert(e.total(e.parked) == 0.0f);
+
+    duty[0] = 0; duty[2] = 64; duty[8] = 0;         // Parked: dim position light, AP up, keyless scans
+    run(30 * 60000, false, true, 10000, 12600);
+    assert(e.soc0 == 87 && !e.cutoff);              // 12.6 V at rest
+    double drainMa = 64 / 255.0 * 55 / 12.0 * 1000 + 15 + 45 + 30 * 0.1;
+    assert(std::abs(e.total(e.parked) - drainMa * 0.5) < 10);
+    assert(std::abs(EnergySim::mah(e.parked.wifiMaUs) - 22.5) < 0.5);
+    assert(std::abs(EnergySim::mah(e.parked.bleMaUs) - 1.5) < 0.1);
+    assert(e.total(e.ride) > 2000);                 // Ride account kept while parked
+
+    int64_t cutAt = -1;                             // Budget: 87 % → 60 % of 8 Ah
+    for (int m = 0; m < 6 * 60 && cutAt < 0; m++) {
+      run(60000, false, true, 10000, 12600);
+      if (e.cutoff) cutAt = t - e.parkStartMs;
+      if (e.cutoff) duty[2] = 0;                    // Parking light released
+    }
+    double expectMin = 1 + (0.27 * 8000) / drainMa * 60;   // Rest read at 1 min
+    std::cout << "  parking light cut after " << cutAt / 60000 << " min (expected ~"
+              << (int)expectMin << "), " << (int)e.total(e.parked) << " mAh" << std::endl;
+    assert(cutAt > 0 && std::abs(cutAt / 60000.0 - expectMin) < 3);
+
+    run(100, true, true, 0, 12400);                 // Next ride clears the cutoff
+    assert(!e.cutoff && e.total(e.ride) < 1);
+    std::cout << "[PASS] Energy accounting and parked cutoff" << std::endl;
+  }
+
+  // --- Parked power mode: schedule, wake sources and average current per mode ---
+  {
+    // Controller current at the battery (outputs excluded): awake base,
+    // AP and scan radio as in energy accounting, light sleep ENERGY_SLEEP_MA
+    const double BASE_MA = 15, WIFI_MA = 45, SCAN_MA = 30, SLEEP_MA = 2;
+    const int64_t IGN_OFF = 10 * 60000, VIB_AT = IGN_OFF + 40 * 60000,
+                  LOCK_AT = IGN_OFF + 70 * 60000, END = LOCK_AT + 60000;
+    auto vibration = [&](int64_t t) {                     // 4 knocks, 150 ms each
+      return t >= VIB_AT && t < VIB_AT + 1600 && (t - VIB_AT) % 400 < 150;
+    };
+    auto nextEdge = [&](int64_t t) {                      // Next lock / vibration change
+      for (int64_t e = VIB_AT; e < VIB_AT + 1600; e += 400) {
+        if (e > t) return e;
+        if (e + 150 > t) return e + 150;
+      }
+      return LOCK_AT > t ? LOCK_AT : END;
+    };
+
+    PowerSim p;
+    double mams[3] = {}, ms[3] = {};
+    uint32_t timerWakes = 0, lockWakes = 0, vibWakes = 0;
+    int64_t nextJob = 0, t = 0, lastCheck = -1, firstHit = 0, trigAt = -1, activeAt = -1, parkedAt = -1;
+    int hits = 0;
+    bool triggered = false;
+    auto acc = [&](int64_t dt, bool asleep) {
+      double ma = asleep ? SLEEP_MA
+                         : BASE_MA + (p.wifi() ? WIFI_MA : 0) + (p.ble(t) ? SCAN_MA : 0);
+      mams[p.mode] += ma * dt;
+      ms[p.mode]   += dt;
+    };
+
+    while (t < END) {
+      bool ign = t < IGN_OFF || t >= LOCK_AT;
+      bool vib = vibration(t);
+      if (t >= nextJob) {                                 // Comms: only runs while awake
+        p.job(t, ign, triggered);
+        nextJob = t + 100;
+        if (ign && t >= LOCK_AT && activeAt < 0 && p.mode == PowerSim::ACTIVE) activeAt = t;
+        if (triggered && parkedAt < 0 && p.mode == PowerSim::PARKED) parkedAt = t;
+      }
+
+      // Control tick: alarm arming / vibration hits (mirrors updateAlarm())
+      int64_t deadline = t + 1000;                        // CONTROL_MAX_SLEEP_MS
+      bool armed = !ign && t - IGN_OFF >= 30000;
+      if (!ign && !armed) deadline = std::min(deadline, IGN_OFF + 30000);
+      if (triggered && t - trigAt >= 30000) triggered = false;
+      if (armed && !triggered) {
+        if (vib && lastCheck >= 0) deadline = std::min(deadline, lastCheck + 100);
+        if (lastCheck < 0 || t - lastCheck >= 100) {
+          lastCheck = t;
+          if (vib) {
+            if (hits == 0 || t - firstHit > 2000) { hits = 0; firstHit = t; }
+            if (++hits >= 3) { triggered = true; trigAt = t; hits = 0; }
+          }
+        }
+      }
+
+      if (ign || triggered) { acc(1, false); t += 1; continue; }   // Fixed rate
+
+      int64_t until = p.sleepUntil(t, deadline);
+      int64_t edge  = nextEdge(t);
+      if (until > 0) {                                    // Light sleep: timer or GPIO
+        int64_t w = std::min(until, edge);
+        if (w == until) timerWakes++;
+        else if (w == LOCK_AT) lockWakes++;
+        else vibWakes++;
+        acc(w - t, true);
+        t = w;
+        acc(1, false);                                    // Wake-up + one tick
+        t += 1;
+      } else {                                            // RTOS wait, chip idle
+        int64_t w = std::max(t + 1, std::min({ deadline, nextJob, edge }));
+        acc(w - t, false);
+        t = w;
+      }
+    }
+
+    const char* names[3] = { "active", "parked", "sleep" };
+    for (int m = 0; m < 3; m++) {
+      std::cout << "  " << names[m] << ": " << (int)(ms[m] / 60000) << " min, avg "
+                << mams[m] / ms[m] << " mA" << std::endl;
+    }
+    double avgActive = mams[0] / ms[0], avgParked = mams[1] / ms[1], avgSleep = mams[2] / ms[2];
+    assert(std::abs(avgActive - 75) < 1 && std::abs(avgParked - 75) < 1);
+    // Per cycle: 1.5 s window (1 s scan) + ~8.5 s asleep with 1 Hz timer wakes
+    double expectSleep = (1.5 * BASE_MA + 1.0 * SCAN_MA + 8.5 * SLEEP_MA + 8 * 0.001 * BASE_MA) / 10;
+    assert(std::abs(avgSleep - expectSleep) < 0.5 && avgSleep < avgParked / 8);
+    assert(std::abs((double)p.windows - ms[2] / 10000) < 3);
+    assert(lockWakes == 1 && timerWakes > 1000);
+    assert(vibWakes == 2);                                // Knocks 1 and 2 (hits 1-2, 3)
+    assert(trigAt > VIB_AT && trigAt < VIB_AT + 600);     // Armed state kept through sleep
+    assert(parkedAt >= trigAt && parkedAt - trigAt <= 100);   // Alarm sounding: radios up
+    assert(activeAt >= LOCK_AT && activeAt - LOCK_AT <= 1);   // Lock wakes straight away
+    std::cout << "[PASS] Parked power mode" << std::endl;
+  }
+
   std::cout << "\n=== All tests passed ===" << std::endl;
   return 0;
 }